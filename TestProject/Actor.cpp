@@ -1,40 +1,83 @@
+#include <algorithm>
+#include <iterator>
 #include "Actor.h"
 
 
 unsigned long Actor::idSeed = 0;
+std::unordered_map<unsigned long, std::weak_ptr<Actor>> Actor::registry;
 
 
-void Actor::updateSprite()
+// Recomputes the global transform if the actor was modified or its
+// parent's global transform changed since the last recomputation.
+// Ancestors are brought up to date first.
+void Actor::updateTransform() const
 {
 	auto parentShared = parent.lock();
+	if (parentShared)
+		parentShared->updateTransform();
+
+	if (transformDirty == false && (!parentShared || parentTransformVersion == parentShared->transformVersion))
+		return;
+
 	if (!parentShared)
 	{
 		sprite.setPosition(localPosition);
 		sprite.setScale(localScale);
 		sprite.setRotation(localRotation);
-		return;
 	}
+	else
+	{
+		sprite.setPosition(
+			parentShared->sprite.getPosition() +
+			Tools::ScaleVector(
+				Tools::rotate(
+					localPosition,
+					parentShared->sprite.getRotation()),
+				parentShared->sprite.getScale()));
+
+		sprite.setScale(Tools::ScaleVector(parentShared->sprite.getScale(), localScale));
+		sprite.setRotation(parentShared->sprite.getRotation() + localRotation);
+		parentTransformVersion = parentShared->transformVersion;
+	}
+
+	transformVersion++;
+	transformDirty = false;
+}
 
-	sprite.setPosition(
-		parentShared->sprite.getPosition() +
-		Tools::ScaleVector(
-			Tools::rotate(
-				localPosition,
-				parentShared->sprite.getRotation()),
-			parentShared->sprite.getScale()));
 
-	sprite.setScale(Tools::ScaleVector(parentShared->sprite.getScale(), localScale));
-	sprite.setRotation(parentShared->sprite.getRotation() + localRotation);
+// Puts the component into the type index and helper lists
+void Actor::registerComponent(Component *component)
+{
+	componentIndex[component->getTypeId()].push_back(component);
+
+	BehaviourScript *beh = dynamic_cast<BehaviourScript*>(component);
+	if (beh)
+		scriptList.push_back(beh);
+
+	Collider *col = dynamic_cast<Collider*>(component);
+	if (col)
+		colliderList.push_back(col);
 }
 
 
-void Actor::updateChildren()
+void Actor::unregisterComponent(Component *component)
 {
-	for (auto &i : childrenList)
+	auto eraseFrom = [](auto &list, auto *element)
 	{
-		i->updateSprite();
-		i->updateChildren();
-	}
+		list.erase(std::remove(list.begin(), list.end(), element), list.end());
+	};
+
+	auto components = componentIndex.find(component->getTypeId());
+	if (components != componentIndex.end())
+		eraseFrom(components->second, component);
+
+	BehaviourScript *beh = dynamic_cast<BehaviourScript*>(component);
+	if (beh)
+		eraseFrom(scriptList, beh);
+
+	Collider *col = dynamic_cast<Collider*>(component);
+	if (col)
+		eraseFrom(colliderList, col);
 }
 
 
@@ -44,11 +87,8 @@ void Actor::removeDestroyedComponents()
 	{
 		if ((*i)->isDestroyed())
 		{
-			Collider *col = dynamic_cast<Collider*>(i->get());
-			if (col)
-				colliderList.remove(col);
-
-			componentList.erase(i++);
+			unregisterComponent(i->get());
+			i = componentList.erase(i);
 		}
 		else
 			i++;
@@ -56,10 +96,71 @@ void Actor::removeDestroyedComponents()
 }
 
 
+// Queue of the tree the actor belongs to, nullptr while its root is destroyed
+RenderQueue* Actor::findRenderQueue() const
+{
+	if (isRoot())
+		return renderQueue.get();
+
+	auto rootShared = root.lock();
+	return rootShared ? rootShared->renderQueue.get() : nullptr;
+}
+
+
+// Static actors are indexed by their current bounds
+void Actor::enqueue(RenderQueue &queue)
+{
+	if (staticActor)
+		queue.addStatic(this, depth, getGlobalBounds());
+	else
+		queue.add(this, depth);
+	queued = true;
+}
+
+
+void Actor::dequeue(RenderQueue &queue)
+{
+	queue.remove(this, depth);
+	queued = false;
+}
+
+
+// Puts the actor and all its children into the queue
+void Actor::enqueueTree(RenderQueue &queue)
+{
+	if (queued == false)
+		enqueue(queue);
+
+	for (auto &i : childrenList)
+		i->enqueueTree(queue);
+}
+
+
+void Actor::dequeueTree(RenderQueue &queue)
+{
+	if (queued == true)
+		dequeue(queue);
+
+	for (auto &i : childrenList)
+		i->dequeueTree(queue);
+}
+
+
+// Recomputes whether the actor and its children are displayed
+void Actor::updateActiveInHierarchy()
+{
+	auto parentShared = parent.lock();
+	activeInHierarchy = enabled && (!parentShared || parentShared->activeInHierarchy);
+
+	for (auto &i : childrenList)
+		i->updateActiveInHierarchy();
+}
+
+
 Actor::Actor(std::weak_ptr<Actor> root, const std::string &name)
 	: root(root)
-	, name(name)
 	, id(idSeed++)
+	, name(name)
 {}
 
 
@@ -75,6 +176,19 @@ Actor::Actor(const Actor &actor)
 }
 
 
+Actor::~Actor()
+{
+	registry.erase(id);
+
+	if (queued)
+	{
+		RenderQueue *queue = findRenderQueue();
+		if (queue)
+			queue->remove(this, depth);
+	}
+}
+
+
 Actor& Actor::operator=(const Actor &actor)
 {
 	if (this == &actor)
@@ -87,28 +201,25 @@ Actor& Actor::operator=(const Actor &actor)
 	setOpacity(actor.getOpacity());
 	setDepth(actor.getDepth());
 	setEnabled(actor.getEnabled());
+	setStatic(actor.getStatic());
 	tags = actor.tags;
 
 	// Copy components
 	colliderList.clear();
+	scriptList.clear();
+	componentIndex.clear();
 	componentList.clear();
 
 	for (auto &i : actor.componentList)
 	{
-		componentList.push_back(i->clone().lock());
-
-		Collider *coll = dynamic_cast<Collider*>(i.get());
-		if (coll)
-			colliderList.push_back(coll);
+		componentList.push_back(i->clone());
+		componentList.back()->ownerActor = handle;
+		registerComponent(componentList.back().get());
 	}
 
 	// Execute awake() method on cloned actor scripts
-	for (auto &i : componentList)
-	{
-		BehaviourScript *beh = dynamic_cast<BehaviourScript*>(i.get());
-		if (beh)
-			beh->awake();
-	}
+	for (std::size_t i = 0; i < scriptList.size(); i++)
+		scriptList[i]->awake();
 
 	return *this;
 }
@@ -129,20 +240,39 @@ void Actor::setParent(std::weak_ptr<Actor> actor)
 		if (parentShared == actorShared || actorShared.get() == this)
 			return;
 
-		// If parent exists
+		// Detach from the current parent (keeping the actor alive meanwhile)
+		auto selfShared = handle.lock();
 		if (parentShared)
-			actorShared->childrenList.splice(actorShared->childrenList.begin(), parentShared->childrenList, self);
-		else
-			actorShared->childrenList.push_front(handle.lock());
+		{
+			// Searched from the back - actors are usually re-parented right
+			// after createActor() appended them to the children of the root
+			auto &siblings = parentShared->childrenList;
+			auto self = std::find(siblings.rbegin(), siblings.rend(), selfShared);
+			if (self != siblings.rend())
+				siblings.erase(std::next(self).base());
+		}
+
+		// The newest child goes last, so it is updated after its siblings and
+		// drawn over those of the same depth
+		actorShared->childrenList.push_back(selfShared);
 
-		self = actorShared->childrenList.begin();
 		parent = actor;
+
+		// Actors attached to the tree of the root are drawn through its queue
+		bool attached = actorShared->isRoot() || actorShared->queued;
+		RenderQueue *queue = findRenderQueue();
+		if (queue && attached && queued == false)
+			enqueueTree(*queue);
+		else if (queue && attached == false && queued == true)
+			dequeueTree(*queue);
+
+		updateActiveInHierarchy();
 	}
 	// If actor doesn't exist
 	else
 		setParent(root);
 
-	updateSprite();
+	transformDirty = true;
 }
 
 
@@ -157,6 +287,9 @@ void Actor::setRoot(std::weak_ptr<Actor> root)
 
 	if (rootShared != newRootShared)
 	{
+		if (queued && rootShared)
+			dequeueTree(*rootShared->renderQueue);
+
 		this->root = root;
 		setParent(std::weak_ptr<Actor>());
 	}
@@ -184,68 +317,73 @@ void Actor::setOpacity(int val)
 void Actor::setLocalPosition(const sf::Vector2f &position)
 {
 	localPosition = position;
-	if (parent.expired() == false)
-		updateSprite();
-	else
-		sprite.setPosition(position);
-	updateChildren();
+	transformDirty = true;
 }
 
 
 void Actor::setLocalPosition(float x, float y)
 {
 	localPosition = sf::Vector2f(x, y);
-	if (parent.expired() == false)
-		updateSprite();
-	else
-		sprite.setPosition(sf::Vector2f(x, y));
-	updateChildren();
+	transformDirty = true;
 }
 
 
 void Actor::setLocalScale(const sf::Vector2f &scale)
 {
 	localScale = scale;
-	if (parent.expired() == false)
-		updateSprite();
-	else
-		sprite.setScale(scale);
-	updateChildren();
+	transformDirty = true;
 }
 
 
 void Actor::setLocalScale(float scale)
 {
 	localScale = sf::Vector2f(scale, scale);
-	if (parent.expired() == false)
-		updateSprite();
-	else
-		sprite.setScale(localScale);
-	updateChildren();
+	transformDirty = true;
 }
 
 
 void Actor::setLocalRotation(float rotation)
 {
 	localRotation = rotation;
-	if (parent.expired() == false)
-		updateSprite();
-	else
-		sprite.setRotation(rotation);
-	updateChildren();
+	transformDirty = true;
 }
 
 
 void Actor::setEnabled(bool enabled)
 {
 	this->enabled = enabled;
+	updateActiveInHierarchy();
 }
 
 
 
 void Actor::setDepth(int depth)
 {
+	RenderQueue *queue = queued && this->depth != depth ? findRenderQueue() : nullptr;
+	if (queue)
+		dequeue(*queue);
+
 	this->depth = depth;
+
+	if (queue)
+		enqueue(*queue);
+}
+
+
+
+// Static actors are drawn only when their bounds at the time of this call
+// (or of attaching them to the tree) are visible. They must not be moved,
+// rotated, scaled or given another texture while static.
+void Actor::setStatic(bool staticActor)
+{
+	RenderQueue *queue = queued ? findRenderQueue() : nullptr;
+	if (queue)
+		dequeue(*queue);
+
+	this->staticActor = staticActor;
+
+	if (queue)
+		enqueue(*queue);
 }
 
 
@@ -336,6 +474,7 @@ float Actor::getLocalRotation() const
 
 const sf::Vector2f& Actor::getGlobalPosition() const
 {
+	updateTransform();
 	return sprite.getPosition();
 }
 
@@ -343,6 +482,7 @@ const sf::Vector2f& Actor::getGlobalPosition() const
 
 const sf::Vector2f& Actor::getGlobalScale() const
 {
+	updateTransform();
 	return sprite.getScale();
 }
 
@@ -350,11 +490,21 @@ const sf::Vector2f& Actor::getGlobalScale() const
 
 float Actor::getGlobalRotation() const
 {
+	updateTransform();
 	return sprite.getRotation();
 }
 
 
 
+// Bounding rectangle of the sprite in the world
+sf::FloatRect Actor::getGlobalBounds() const
+{
+	updateTransform();
+	return sprite.getGlobalBounds();
+}
+
+
+
 bool Actor::getEnabled() const
 {
 	return enabled;
@@ -362,6 +512,13 @@ bool Actor::getEnabled() const
 
 
 
+bool Actor::isActiveInHierarchy() const
+{
+	return activeInHierarchy;
+}
+
+
+
 int Actor::getDepth() const
 {
 	return depth;
@@ -369,6 +526,13 @@ int Actor::getDepth() const
 
 
 
+bool Actor::getStatic() const
+{
+	return staticActor;
+}
+
+
+
 const std::string& Actor::getName() const
 {
 	return name;
@@ -389,23 +553,29 @@ void Actor::addTag(const std::string &tag)
 
 void Actor::removeTag(const std::string &tag)
 {
-	tags.remove(tag);
+	tags.erase(std::remove(tags.begin(), tags.end(), tag), tags.end());
 }
 
 
 
-const std::list<std::string>& Actor::getTags() const
+const std::vector<std::string>& Actor::getTags() const
 {
 	return tags;
 }
 
 
-const std::list<Collider*>& Actor::getColliderList() const
+const std::vector<Collider*>& Actor::getColliderList() const
 {
 	return colliderList;
 }
 
 
+const std::vector<BehaviourScript*>& Actor::getScriptList() const
+{
+	return scriptList;
+}
+
+
 
 bool Actor::isRoot() const
 {
@@ -415,28 +585,52 @@ bool Actor::isRoot() const
 
 sf::Vector2f Actor::forward() const
 {
-	return Tools::rotate(sf::Vector2f(1.0f, 0.0f), sprite.getRotation());
+	return Tools::rotate(sf::Vector2f(1.0f, 0.0f), getGlobalRotation());
 }
 
 
 sf::Vector2f Actor::right() const
 {
-	return Tools::rotate(sf::Vector2f(0.0f, 1.0f), sprite.getRotation());
+	return Tools::rotate(sf::Vector2f(0.0f, 1.0f), getGlobalRotation());
+}
+
+
+// Makes the actor reachable through findActor()
+void Actor::registerActor(const std::shared_ptr<Actor> &actor)
+{
+	registry[actor->id] = actor;
 }
 
 
 std::shared_ptr<Actor> Actor::createActor(std::weak_ptr<Actor> root, const std::string &name)
 {
-	std::shared_ptr<Actor> newActor = std::shared_ptr<Actor>(new Actor{ root, name });
+	std::shared_ptr<Actor> newActor = adoptPooled(new (allocatePooled<Actor>()) Actor{ root, name });
 	newActor->handle = newActor;
+	registerActor(newActor);
 
 	if (root.expired() == false)
 		newActor->setParent(root);
+	else
+		newActor->renderQueue = std::make_unique<RenderQueue>();
 
 	return newActor;
 }
 
 
+// Returns an empty handle if there is no living actor with the given id.
+// The registry changes whenever an actor is created or destroyed, which
+// happens on the main thread only. Jobs of the job system may use getters
+// of actors, but must not create, destroy or look up actors.
+std::weak_ptr<Actor> Actor::findActor(unsigned long id)
+{
+	auto actor = registry.find(id);
+	if (actor == registry.end())
+		return std::weak_ptr<Actor>();
+
+	return actor->second;
+}
+
+
 std::weak_ptr<Actor> Actor::getChild(const std::string &name)
 {
 	for (auto &i : childrenList)
@@ -465,72 +659,61 @@ std::weak_ptr<Actor> Actor::getChildRecursive(const std::string &name)
 }
 
 
-const std::list<std::shared_ptr<Actor>>& Actor::getChildren() const
+const std::vector<std::shared_ptr<Actor>>& Actor::getChildren() const
 {
 	return childrenList;
 }
 
 
 
-const std::list<std::shared_ptr<Component>>& Actor::getComponents() const
+const RenderQueue* Actor::getRenderQueue() const
 {
-	return componentList;
+	return findRenderQueue();
 }
 
 
 
-void Actor::draw(sf::RenderWindow &window, bool drawColliders) const
+const std::vector<std::shared_ptr<Component>>& Actor::getComponents() const
 {
-	if (!enabled)
-		return;
+	return componentList;
+}
 
-	// Lists of drawable actors and colliders
-	std::list<const Actor*> drawList;
-	std::list<const Collider*> collList;
 
-	// Pushes all children colliders of an actor (including the parent) to the collList
-	std::function<void(const Actor*)> getColliders = [&](const Actor* parent)
-	{
-		// Stop if the actor is not enabled
-		if (parent->enabled == false)
-			return;
 
-		for (auto &i : parent->colliderList)
-			collList.push_back(i);
+// Brings global transforms of the actor and all its children up to date.
+// Each modified actor is recomputed once, no matter how many of its
+// setters were called.
+void Actor::updateTransforms() const
+{
+	updateTransform();
+	for (auto &i : childrenList)
+		i->updateTransforms();
+}
 
-		for (auto &i : parent->childrenList)
-			getColliders(i.get());
-	};
 
+// Adds only the sprite of the actor to the batch, the whole tree is drawn
+// in the order of the root's render queue. Returns false if the sprite
+// wasn't added, also when its bounds are outside of the visible area.
+bool Actor::draw(SpriteBatch &batch, const sf::FloatRect &visibleArea) const
+{
+	if (activeInHierarchy == false || sprite.getTexture() == nullptr)
+		return false;
 
-	// Pushes all children of an actor (including the parent) to the drawList
-	std::function<void(const Actor*)> getDrawables = [&](const Actor* parent)
-	{
-		// Stop if the actor is not enabled
-		if (parent->enabled == false)
-			return;
+	if (getGlobalBounds().intersects(visibleArea) == false)
+		return false;
 
-		drawList.push_back(parent);
-		for (auto &i : parent->childrenList)
-			getDrawables(i.get());
-	};
+	batch.draw(sprite);
+	return true;
+}
 
-	// Fill the draw list and sort it by depth
-	getDrawables(this);
-	drawList.sort([](auto &a, auto &b) { return a->depth < b->depth; });
 
-	// If actor has texture and is enabled, draw it
-	for (auto &i : drawList)
-		if (i->sprite.getTexture() != nullptr && i->enabled)
-			window.draw(i->sprite);
+void Actor::drawColliders(sf::RenderTarget &target) const
+{
+	if (activeInHierarchy == false)
+		return;
 
-	// Draw all colliders of the actor tree
-	if (drawColliders == true)
-	{
-		getColliders(this);
-		for (auto &i : collList)
-			i->draw(window);
-	}
+	for (auto &i : colliderList)
+		i->draw(target);
 }
 
 
@@ -543,25 +726,23 @@ void Actor::update()
 
 		// Call start method on all scripts that are enabled and
 		// and for which the method hasn't been called yet.
-		// Call update method on all scripts.
-		for (auto &i : actor->getComponents())
+		// Call update method on all scripts. Indices are used since
+		// scripts may add components and actors while being updated.
+		for (std::size_t i = 0; i < actor->scriptList.size(); i++)
 		{
-			BehaviourScript *beh = dynamic_cast<BehaviourScript*>(i.get());
-			if (beh)
+			BehaviourScript *beh = actor->scriptList[i];
+			if (beh->started == false)
 			{
-				if (beh->started == false)
-				{
-					beh->started = true;
-					beh->start();
-				}
-
-				beh->update();
+				beh->started = true;
+				beh->start();
 			}
+
+			beh->update();
 		}
 
 		// Perform the update for the children
-		for (auto &i : actor->getChildren())
-			updateRecursive(i.get());
+		for (std::size_t i = 0; i < actor->childrenList.size(); i++)
+			updateRecursive(actor->childrenList[i].get());
 	};
 
 	updateRecursive(this);
@@ -577,32 +758,64 @@ void Actor::notifyScripts(void(BehaviourScript::*notifyMethod)(sf::Event event),
 
 		// Call the input device handler method for
 		// behaviour scripts
-		for (auto &i : actor->getComponents())
+		for (std::size_t i = 0; i < actor->scriptList.size(); i++)
+			(actor->scriptList[i]->*notifyMethod)(event);
+
+		for (std::size_t i = 0; i < actor->childrenList.size(); i++)
+			updateRecursive(actor->childrenList[i].get());
+	};
+
+	updateRecursive(this);
+}
+
+
+// Calls a notification without arguments, scripts are notified only after
+// their start method has been called in an update
+void Actor::notifyScripts(void(BehaviourScript::*notifyMethod)())
+{
+	std::function<void(Actor*)> notifyRecursive = [&](Actor *actor)
+	{
+		if (actor->enabled == false)
+			return;
+
+		for (std::size_t i = 0; i < actor->scriptList.size(); i++)
 		{
-			BehaviourScript *beh = dynamic_cast<BehaviourScript*>(i.get());
-			if (beh)
-				(beh->*notifyMethod)(event);
+			if (actor->scriptList[i]->started == true)
+				(actor->scriptList[i]->*notifyMethod)();
 		}
 
-		for (auto &i : actor->getChildren())
-			updateRecursive(i.get());
+		for (std::size_t i = 0; i < actor->childrenList.size(); i++)
+			notifyRecursive(actor->childrenList[i].get());
 	};
 
-	updateRecursive(this);
+	notifyRecursive(this);
 }
 
 
 void Actor::executeCoroutines()
 {
-	for (auto &i : componentList)
-	{
-		BehaviourScript *beh = dynamic_cast<BehaviourScript*>(i.get());
-		if (beh)
-			beh->executeCoroutines();
-	}
+	for (std::size_t i = 0; i < scriptList.size(); i++)
+		scriptList[i]->executeCoroutines();
 
-	for (auto &i : childrenList)
-		i->executeCoroutines();
+	for (std::size_t i = 0; i < childrenList.size(); i++)
+		childrenList[i]->executeCoroutines();
+}
+
+
+void Actor::saveTickTransform()
+{
+	tickTransformSaved = true;
+	tickPosition = localPosition;
+	tickRotation = localRotation;
+}
+
+
+// Returns false for actors created after the beginning of the last tick
+bool Actor::getTickTransform(sf::Vector2f &position, float &rotation) const
+{
+	position = tickPosition;
+	rotation = tickRotation;
+	return tickTransformSaved;
 }
 
 
@@ -611,8 +824,9 @@ std::shared_ptr<Actor> Actor::clone(const std::string &newActorName) const
 	if (isRoot())
 		return nullptr;
 
-	std::shared_ptr<Actor> newActor = std::shared_ptr<Actor>(new Actor{ root });
+	std::shared_ptr<Actor> newActor = adoptPooled(new (allocatePooled<Actor>()) Actor{ root });
 	newActor->handle = newActor;
+	registerActor(newActor);
 	*newActor = *this;
 	newActor->name = newActorName;
 
@@ -626,8 +840,9 @@ std::shared_ptr<Actor> Actor::cloneWithChildren(const std::string &newActorName)
 		return nullptr;
 
 	// Clone yourself
-	std::shared_ptr<Actor> newActor = std::shared_ptr<Actor>(new Actor{ root });
+	std::shared_ptr<Actor> newActor = adoptPooled(new (allocatePooled<Actor>()) Actor{ root });
 	newActor->handle = newActor;
+	registerActor(newActor);
 	*newActor = *this;
 	newActor->name = newActorName;
 	
@@ -645,21 +860,25 @@ std::shared_ptr<Actor> Actor::cloneWithChildren(const std::string &newActorName)
 
 void Actor::removeDestroyedChildren()
 {
+	RenderQueue *queue = findRenderQueue();
+
 	std::function<void(Actor*)> destroyRecursive = [&](Actor *actor)
 	{
-		// Physically destroy all actors marked as destroyed
-		for (auto i = actor->childrenList.begin(); i != actor->childrenList.end();)
+		// Physically destroy all actors marked as destroyed, otherwise
+		// check whether they have any components to be destroyed
+		auto removed = std::remove_if(actor->childrenList.begin(), actor->childrenList.end(), [&](std::shared_ptr<Actor> &child)
 		{
-			// If marked, destroy actor, otherwise check
-			// whether has any components to be destroyed
-			if ((*i)->toBeDestroyed)
-				actor->childrenList.erase(i++);
-			else
+			if (child->toBeDestroyed)
 			{
-				(*i)->removeDestroyedComponents();
-				i++;
+				if (queue && child->queued)
+					child->dequeueTree(*queue);
+				return true;
 			}
-		}
+
+			child->removeDestroyedComponents();
+			return false;
+		});
+		actor->childrenList.erase(removed, actor->childrenList.end());
 
 		for (auto &i : actor->childrenList)
 			destroyRecursive(i.get());
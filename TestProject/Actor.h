@@ -2,9 +2,14 @@
 #define ACTOR_H_
 #include <SFML/Graphics.hpp>
 #include <type_traits>
+#include <unordered_map>
+#include <vector>
 #include "IDestructible.h"
+#include "MemoryPool.h"
 #include "BehaviourScript.h"
 #include "Collider.h"
+#include "RenderQueue.h"
+#include "SpriteBatch.h"
 #include "Tools.h"
 
 
@@ -17,38 +22,66 @@ class Actor : public IDestructible
 		std::weak_ptr<Actor> root;
 		std::weak_ptr<Actor> parent;
 		std::weak_ptr<Actor> handle;
-		std::list<std::shared_ptr<Actor>> childrenList;
-		std::list<std::shared_ptr<Actor>>::iterator self;		// points self in parent's children list
-		std::list<std::shared_ptr<Component>> componentList;
-		std::list<Collider*> colliderList;						// helper list for faster access to colliders
+		std::vector<std::shared_ptr<Actor>> childrenList;		// in the order of attaching, the newest last
+		std::vector<std::shared_ptr<Component>> componentList;
+		std::vector<Collider*> colliderList;					// helper list for faster access to colliders
+		std::vector<BehaviourScript*> scriptList;				// helper list for faster access to scripts
+		std::unordered_map<ComponentTypeId, std::vector<Component*>> componentIndex;	// components by their exact type, used for final classes
 
 		bool toBeDestroyed = false;
 		static unsigned long idSeed;
 		unsigned long id;
+		static std::unordered_map<unsigned long, std::weak_ptr<Actor>> registry;	// all living actors by id, main thread only
 
 		//===== Variables for the sprite and orientation management
-		sf::Sprite sprite;
+		mutable sf::Sprite sprite;								// holds the cached global transform
 		float opacity = 255.0f;
 
+		// Global transform is recomputed lazily - setters only mark it dirty
+		mutable bool transformDirty = true;
+		mutable unsigned long transformVersion = 0;			// incremented on every recomputation
+		mutable unsigned long parentTransformVersion = 0;	// parent's version the transform was computed from
+
 		sf::Vector2f localPosition = sf::Vector2f();
 		sf::Vector2f localScale = sf::Vector2f(1.0f, 1.0f);
 		float localRotation = 0.0f;
 
+		// Local transform at the beginning of the last simulation tick,
+		// drawing interpolates between it and the current one
+		bool tickTransformSaved = false;
+		sf::Vector2f tickPosition = sf::Vector2f();
+		float tickRotation = 0.0f;
+
 		//===== Variables for drawing order and actor identification
 		bool enabled = true;	// not displayed when not enabled (coroutines not executed as well)
+		bool activeInHierarchy = true;	// enabled together with all its ancestors
 		int depth = 0;			// determines the order of drawing
 
-		std::list<std::string> tags;
+		// Only roots own a render queue, it holds the actors attached to their tree
+		std::unique_ptr<RenderQueue> renderQueue;
+		bool queued = false;
+		bool staticActor = false;	// indexed by its bounds in the queue, must not move
+
+		std::vector<std::string> tags;
 		std::string name;
 
 		//===== Helper private methods
-		void updateSprite();
-		void updateChildren();
+		void updateTransform() const;
+		void registerComponent(Component *component);
+		void unregisterComponent(Component *component);
 		void removeDestroyedComponents();
+		RenderQueue* findRenderQueue() const;
+		void enqueue(RenderQueue &queue);
+		void dequeue(RenderQueue &queue);
+		void enqueueTree(RenderQueue &queue);
+		void dequeueTree(RenderQueue &queue);
+		void updateActiveInHierarchy();
+		static void registerActor(const std::shared_ptr<Actor> &actor);
 
 	public:
 		Actor();
 		Actor(const Actor &actor);
+		~Actor();
 		Actor& operator=(const Actor &actor);
 
 		//===== Setter methods
@@ -67,6 +100,7 @@ class Actor : public IDestructible
 
 		void setEnabled(bool enabled);
 		void setDepth(int depth);
+		void setStatic(bool staticActor);
 		void setName(const std::string &name);
 
 		//===== GetterMethods
@@ -88,41 +122,53 @@ class Actor : public IDestructible
 		const sf::Vector2f& getGlobalPosition() const;
 		const sf::Vector2f& getGlobalScale() const;
 		float getGlobalRotation() const;
+		sf::FloatRect getGlobalBounds() const;
 
 		bool getEnabled() const;
+		bool isActiveInHierarchy() const;
 		int getDepth() const;
+		bool getStatic() const;
 		const std::string& getName() const;
 		unsigned long getId() const;
 		
 		//===== Other methods
 		void addTag(const std::string &tag);
 		void removeTag(const std::string &tag);
-		const std::list<std::string>& getTags() const;
+		const std::vector<std::string>& getTags() const;
 
-		const std::list<Collider*>& getColliderList() const;
+		const std::vector<Collider*>& getColliderList() const;
+		const std::vector<BehaviourScript*>& getScriptList() const;
 		bool isRoot() const;
 
 		sf::Vector2f forward() const;
 		sf::Vector2f right() const;
 
 		static std::shared_ptr<Actor> createActor(std::weak_ptr<Actor> root, const std::string &name = "");
+		static std::weak_ptr<Actor> findActor(unsigned long id);		// not synchronized, main thread only
 		std::weak_ptr<Actor> getChild(const std::string &name);
 		std::weak_ptr<Actor> getChildRecursive(const std::string &name);
-		const std::list<std::shared_ptr<Actor>>& getChildren() const;
+		const std::vector<std::shared_ptr<Actor>>& getChildren() const;
+		const RenderQueue* getRenderQueue() const;
 
 		template <typename T>
 		std::weak_ptr<Component> addComponent(std::weak_ptr<Component> component = std::weak_ptr<Component>());
 		template <typename T>
 		std::weak_ptr<Component> getComponent() const;
 		template <typename T>
-		std::list<std::weak_ptr<Component>> getComponents() const;
-		const std::list<std::shared_ptr<Component>>& getComponents() const;
+		std::vector<std::weak_ptr<Component>> getComponents() const;
+		const std::vector<std::shared_ptr<Component>>& getComponents() const;
 
-		void draw(sf::RenderWindow &window, bool drawColliders = false) const;
+		void updateTransforms() const;
+		bool draw(SpriteBatch &batch, const sf::FloatRect &visibleArea) const;
+		void drawColliders(sf::RenderTarget &target) const;
 		void update();
 		void notifyScripts(void(BehaviourScript::*notifyMethod)(sf::Event event), sf::Event event);
+		void notifyScripts(void(BehaviourScript::*notifyMethod)());
 		void executeCoroutines();
 
+		void saveTickTransform();
+		bool getTickTransform(sf::Vector2f &position, float &rotation) const;
+
 		std::shared_ptr<Actor> clone(const std::string &newActorName = "") const;
 		std::shared_ptr<Actor> cloneWithChildren(const std::string &newActorName = "") const;
 
@@ -143,44 +189,81 @@ std::weak_ptr<Component> Actor::addComponent(std::weak_ptr<Component> component)
 	else
 		componentList.push_back(Component::createComponent<T>());
 	componentList.back()->ownerActor = handle;
+	registerComponent(componentList.back().get());
 
 	if (std::is_base_of<BehaviourScript, T>::value)
 		static_cast<BehaviourScript*>(componentList.back().get())->awake();
-	else if (std::is_base_of<Collider, T>::value)
-		colliderList.push_back(static_cast<Collider*>(componentList.back().get()));
 
 	return componentList.back()->handle;
 }
 
 
+// Scripts and colliders are found through their helper lists and components
+// of final classes through the index of exact types. Components of other
+// classes may be instances of subclasses, so every component is checked.
 template <typename T>
 std::weak_ptr<Component> Actor::getComponent() const
 {
 	static_assert(std::is_base_of<Component, T>::value, "Actor::getComponent<T>() template T parameter must derive from Component class.");
 
-	for (auto &i : componentList)
+	if (std::is_same<T, BehaviourScript>::value)
+		return scriptList.empty() ? std::weak_ptr<Component>() : scriptList.front()->getHandle();
+	else if (std::is_same<T, Collider>::value)
+		return colliderList.empty() ? std::weak_ptr<Component>() : colliderList.front()->getHandle();
+	else if (std::is_same<T, Component>::value)
+		return componentList.empty() ? std::weak_ptr<Component>() : componentList.front()->getHandle();
+	else if (std::is_final<T>::value == false)
 	{
-		T *component = dynamic_cast<T*>(i.get());
-		if (component)
-			return component->getHandle();
+		for (auto &i : componentList)
+		{
+			T *component = dynamic_cast<T*>(i.get());
+			if (component)
+				return component->getHandle();
+		}
+		return std::weak_ptr<Component>();
 	}
 
-	return std::weak_ptr<Component>();
+	auto components = componentIndex.find(Component::typeIdOf<T>());
+	if (components == componentIndex.end() || components->second.empty())
+		return std::weak_ptr<Component>();
+
+	return components->second.front()->getHandle();
 }
 
 
 template <typename T>
-std::list<std::weak_ptr<Component>> Actor::getComponents() const
+std::vector<std::weak_ptr<Component>> Actor::getComponents() const
 {
 	static_assert(std::is_base_of<Component, T>::value, "Actor::getComponent<T>() template T parameter must derive from Component class.");
 
-	std::list<std::weak_ptr<Component>> result;
-	for (auto &i : componentList)
+	std::vector<std::weak_ptr<Component>> result;
+	if (std::is_same<T, BehaviourScript>::value)
 	{
-		T *component = dynamic_cast<T*>(i.get());
-		if (component)
+		for (auto &i : scriptList)
 			result.push_back(i->getHandle());
 	}
+	else if (std::is_same<T, Collider>::value)
+	{
+		for (auto &i : colliderList)
+			result.push_back(i->getHandle());
+	}
+	else if (std::is_final<T>::value == false)
+	{
+		for (auto &i : componentList)
+		{
+			if (dynamic_cast<T*>(i.get()))
+				result.push_back(i->getHandle());
+		}
+	}
+	else
+	{
+		auto components = componentIndex.find(Component::typeIdOf<T>());
+		if (components != componentIndex.end())
+		{
+			for (auto &i : components->second)
+				result.push_back(i->getHandle());
+		}
+	}
 
 	return result;
 }
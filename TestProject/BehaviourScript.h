@@ -18,7 +18,7 @@ class BehaviourScript : public Component
 	public:
 		BehaviourScript() = default;
 		BehaviourScript(const BehaviourScript &beh) {}
-		virtual ~BehaviourScript() = 0 {}
+		virtual ~BehaviourScript() = 0;
 
 		virtual void awake() {}
 		virtual void start() {}
@@ -26,9 +26,14 @@ class BehaviourScript : public Component
 		virtual void onKeyboardEvent(sf::Event event) {}
 		virtual void onMouseEvent(sf::Event event) {}
 		virtual void onCollision(std::weak_ptr<Actor> other) {}
+		virtual void onPreRender() {}		// after interpolated transforms are set, before drawing
+		virtual void onPostRender() {}		// after the actors have been drawn
 
 		void executeCoroutines();
 };
 
 
+inline BehaviourScript::~BehaviourScript() {}
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,441 @@
+#include "Benchmark.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include "Game.h"
+#include "GameController.h"
+#include "ProjectileController.h"
+#include "NetworkManager.h"
+#include "MessageQueue.h"
+
+
+namespace
+{
+	// Turns its actor, so that the transforms of the whole tree are propagated every tick
+	class BenchmarkSpinner final : public BehaviourScript
+	{
+		CLONEABLE_COMPONENT();
+
+		void update() override
+		{
+			auto ownerActor = getOwnerActor().lock();
+			ownerActor->setLocalRotation(ownerActor->getLocalRotation() + 1.0f);
+		}
+	};
+
+
+	// Nearest rank percentile, sorts the values
+	double percentile(std::vector<double> &values, double fraction)
+	{
+		if (values.empty())
+			return 0.0;
+
+		std::sort(values.begin(), values.end());
+		std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * values.size()));
+		return values[std::max<std::size_t>(rank, 1) - 1];
+	}
+}
+
+
+Benchmark::Benchmark(const LaunchOptions &options)
+	: options(options)
+{
+}
+
+
+// Returns the exit code of the program
+int Benchmark::run()
+{
+	if (options.benchmark == "collisions")
+		return runCollisions();
+	if (options.benchmark == "actors")
+		return runActors();
+	if (options.benchmark == "network")
+		return runNetwork();
+	if (options.benchmark == "draw")
+		return runDraw();
+
+	fprintf(stderr, "Nieznany test wydajnosci %s\n", options.benchmark.c_str());
+	return 1;
+}
+
+
+// Projectiles are scripted by ProjectileController, which looks for the game controller
+void Benchmark::createController()
+{
+	auto gameActor = Actor::createActor(Game::get().getRootActor(), "gameActor");
+	auto component = gameActor->addComponent<GameController>().lock();
+	controller = static_cast<GameController*>(component.get());
+}
+
+
+// Adds projectiles flying in random directions from random places of the
+// map until there are @count of them. Those which leave the map are
+// destroyed by their scripts, so this is called after every tick.
+void Benchmark::spawnProjectiles(std::size_t count)
+{
+	// Returns random float from @a to @b
+	auto random = [](float a, float b) { return (static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX) * (b - a) + a); };
+
+	projectiles.remove_if([](std::weak_ptr<Actor> &actor) { return actor.expired(); });
+	float halfWidth = GameController::defaultMapWidth / 2;
+	float halfHeight = GameController::defaultMapHeight / 2;
+	while (projectiles.size() < count)
+	{
+		float rotation = random(0.0f, 360.0f);
+		auto projectile = controller->createProjectile(random(-halfWidth, halfWidth), random(-halfHeight, halfHeight), rotation, 0, "projectile");
+
+		auto component = projectile->getComponent<ProjectileController>().lock();
+		static_cast<ProjectileController*>(component.get())->velocity = Tools::rotate(sf::Vector2f(750.0f, 0.0f), rotation);
+		projectiles.push_back(projectile);
+	}
+}
+
+
+void Benchmark::destroyProjectiles()
+{
+	for (auto &i : projectiles)
+	{
+		if (auto projectile = i.lock())
+			projectile->destroy();
+	}
+	projectiles.clear();
+	Game::get().removeDestroyedActors();
+}
+
+
+// Ticks the game with @projectileCount projectiles, the first @warmUpTicks aren't measured
+Benchmark::TickStats Benchmark::measureTicks(unsigned int warmUpTicks, unsigned int ticks, std::size_t projectileCount)
+{
+	Game &game = Game::get();
+	TickStats stats;
+	for (unsigned int i = 0; i < warmUpTicks + ticks; i++)
+	{
+		spawnProjectiles(projectileCount);
+
+		clock::time_point tickStart = clock::now();
+		game.tick();
+		double tickTime = std::chrono::duration<double>(clock::now() - tickStart).count();
+
+		if (i < warmUpTicks)
+			continue;
+
+		stats.mean += tickTime / ticks;
+		stats.max = std::max(stats.max, tickTime);
+		stats.pairs += static_cast<double>(game.collisionPairs) / ticks;
+	}
+	return stats;
+}
+
+
+// Tick time with and without the broad phase. Testing all pairs of 10000
+// projectiles would take too much memory for the candidate pairs, so it is
+// measured only up to maxAllPairsCount.
+int Benchmark::runCollisions()
+{
+	const std::size_t projectileCounts[] = { 100, 1000, 10000 };
+	const std::size_t maxAllPairsCount = 2000;
+	const unsigned int ticks = 300;
+
+	Game &game = Game::get();
+	createController();
+	std::srand(2701);
+
+	printf("Tick symulacji z pociskami na mapie %.0fx%.0f, pomiar %u tickow\n", GameController::defaultMapWidth, GameController::defaultMapHeight, ticks);
+	for (std::size_t count : projectileCounts)
+	{
+		for (bool broadPhase : { true, false })
+		{
+			if (broadPhase == false && count > maxAllPairsCount)
+			{
+				printf("  %5zu pociskow, wszystkie pary:  pominiete (%zu par na tick)\n", count, count * (count - 1) / 2);
+				continue;
+			}
+
+			game.collisionBroadPhase = broadPhase;
+			TickStats stats = measureTicks(30, ticks, count);
+			printf("  %5zu pociskow, %s tick sr %7.2f ms maks %7.2f ms, testowanych par %.0f\n", count,
+				broadPhase ? "siatka kolizji:" : "wszystkie pary:", stats.mean * 1000.0, stats.max * 1000.0, stats.pairs);
+		}
+		destroyProjectiles();
+	}
+
+	game.collisionBroadPhase = true;
+	return 0;
+}
+
+
+// Times of the tick phases which traverse the actor trees, without collisions.
+// Every tree is a parent with 3 children having 2 children each, like a ship
+// with engines and their jets.
+int Benchmark::runActors()
+{
+	const int treeCount = 1000;
+	const int childCount = 3;
+	const int grandchildCount = 2;
+	const unsigned int warmUpTicks = 30;
+	const unsigned int ticks = 300;
+
+	Game &game = Game::get();
+	std::weak_ptr<Actor> root = game.getRootActor();
+
+	clock::time_point start = clock::now();
+	std::vector<std::shared_ptr<Actor>> trees;
+	std::size_t actorCount = 0;
+	for (int i = 0; i < treeCount; i++)
+	{
+		auto tree = Actor::createActor(root, "tree" + std::to_string(i));
+		tree->setLocalPosition(static_cast<float>(i % 100) * 100.0f, static_cast<float>(i / 100) * 100.0f);
+		tree->addComponent<BenchmarkSpinner>();
+		trees.push_back(tree);
+
+		for (int j = 0; j < childCount; j++)
+		{
+			auto child = Actor::createActor(root, "child");
+			child->setParent(tree);
+			child->setLocalPosition(10.0f, static_cast<float>(j) * 10.0f);
+
+			for (int k = 0; k < grandchildCount; k++)
+			{
+				auto grandchild = Actor::createActor(root, "grandchild");
+				grandchild->setParent(child);
+				grandchild->setLocalPosition(5.0f, static_cast<float>(k) * 5.0f);
+			}
+		}
+		actorCount += 1 + childCount * (1 + grandchildCount);
+	}
+	double createTime = std::chrono::duration<double>(clock::now() - start).count();
+
+	// Seconds per tick of each phase
+	double updateTime = 0.0;
+	double transformsTime = 0.0;
+	double coroutinesTime = 0.0;
+	double removalTime = 0.0;
+	auto measure = [&](double &phaseTime, bool measured, void (Game::*phase)())
+	{
+		clock::time_point phaseStart = clock::now();
+		(game.*phase)();
+		if (measured)
+			phaseTime += std::chrono::duration<double>(clock::now() - phaseStart).count() / ticks;
+	};
+
+	for (unsigned int i = 0; i < warmUpTicks + ticks; i++)
+	{
+		bool measured = i >= warmUpTicks;
+		game.deltaTime = game.fixedDeltaTime;
+		measure(transformsTime, measured, &Game::updateTransforms);
+		measure(updateTime, measured, &Game::update);
+		measure(coroutinesTime, measured, &Game::executeActorCoroutines);
+		measure(removalTime, measured, &Game::removeDestroyedActors);
+	}
+
+	start = clock::now();
+	for (auto &tree : trees)
+		tree->destroy();
+	trees.clear();
+	game.removeDestroyedActors();
+	double destroyTime = std::chrono::duration<double>(clock::now() - start).count();
+
+	printf("Przejscia po %zu aktorach w %d drzewach, pomiar %u tickow\n", actorCount, treeCount, ticks);
+	printf("  update                 %7.3f ms na tick\n", updateTime * 1000.0);
+	printf("  updateTransforms       %7.3f ms na tick\n", transformsTime * 1000.0);
+	printf("  executeActorCoroutines %7.3f ms na tick\n", coroutinesTime * 1000.0);
+	printf("  removeDestroyedActors  %7.3f ms na tick\n", removalTime * 1000.0);
+	printf("  razem                  %7.3f ms na tick\n", (updateTime + transformsTime + coroutinesTime + removalTime) * 1000.0);
+	printf("  utworzenie drzew       %7.3f ms\n", createTime * 1000.0);
+	printf("  usuniecie drzew        %7.3f ms\n", destroyTime * 1000.0);
+	return 0;
+}
+
+
+// Messages go from a client to the host on options.port through TCP, and
+// from the host's network thread through a MessageQueue to this thread, like
+// in the game. Every message carries its number and send time, so lost,
+// reordered or damaged messages and the latency are measured. Each rate is
+// sent for 3 seconds, then the queue is drained.
+int Benchmark::runNetwork()
+{
+	const unsigned int rates[] = { 10000, 50000, 100000, 200000 };
+	const double sendingTime = 3.0;
+	const std::size_t messageSize = 16;
+
+	Network::NetworkManager host;
+	MessageQueue receivedMessages;
+	MessageQueue::Batch batch;
+	host.setOnReceive([&receivedMessages](unsigned long connectionId, const char *data, int dataSize)
+	{
+		receivedMessages.push(connectionId, data, dataSize);
+	});
+
+	Network::NetworkManager client;
+	try
+	{
+		host.startListening(options.port);
+		client.connectAsClient("127.0.0.1", options.port);
+	}
+	catch (std::exception &e)
+	{
+		fprintf(stderr, "Nie udalo sie polaczyc przez port %s: %s\n", options.port.c_str(), e.what());
+		return 1;
+	}
+
+	clock::time_point connectStart = clock::now();
+	while (host.getConnectionsCount() == 0 && clock::now() - connectStart < std::chrono::seconds(2))
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+	auto connections = client.getConnections();
+	if (connections.empty() || host.getConnectionsCount() == 0)
+	{
+		fprintf(stderr, "Nie udalo sie polaczyc przez port %s\n", options.port.c_str());
+		return 1;
+	}
+	unsigned long connectionId = connections.front();
+
+	printf("Wiadomosci po %zu B przez localhost, %.0f s na kazda czestotliwosc\n", messageSize, sendingTime);
+	std::uint64_t nextSent = 0;
+	std::uint64_t nextExpected = 0;
+	for (unsigned int rate : rates)
+	{
+		std::uint64_t firstSent = nextSent;
+		unsigned long received = 0;
+		unsigned long damaged = 0;
+		std::vector<double> latencies;
+		char message[messageSize];
+
+		clock::time_point start = clock::now();
+		clock::time_point sendingEnd = start + std::chrono::duration_cast<clock::duration>(std::chrono::duration<double>(sendingTime));
+		clock::time_point drainEnd = sendingEnd + std::chrono::seconds(1);
+		while (true)
+		{
+			clock::time_point now = clock::now();
+			if (now < sendingEnd)
+			{
+				std::uint64_t due = firstSent + static_cast<std::uint64_t>(std::chrono::duration<double>(now - start).count() * rate);
+				for (; nextSent < due; nextSent++)
+				{
+					std::int64_t sendTime = now.time_since_epoch().count();
+					std::memcpy(message, &nextSent, sizeof(nextSent));
+					std::memcpy(message + sizeof(nextSent), &sendTime, sizeof(sendTime));
+					client.send(connectionId, message, messageSize);
+				}
+			}
+
+			receivedMessages.takeAll(batch);
+			batch.forEach([&](unsigned long, const char *data, std::size_t dataSize)
+			{
+				std::uint64_t number;
+				std::int64_t sendTime;
+				if (dataSize != messageSize)
+				{
+					damaged++;
+					return;
+				}
+				std::memcpy(&number, data, sizeof(number));
+				std::memcpy(&sendTime, data + sizeof(number), sizeof(sendTime));
+				if (number != nextExpected)
+					damaged++;
+
+				nextExpected = number + 1;
+				received++;
+				latencies.push_back(std::chrono::duration<double>(now - clock::time_point(clock::duration(sendTime))).count());
+			});
+
+			bool drained = now >= sendingEnd && nextExpected == nextSent;
+			if (drained || now >= drainEnd || host.getConnectionsCount() == 0)
+				break;
+
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+
+		unsigned long sent = static_cast<unsigned long>(nextSent - firstSent);
+		printf("  %6u/s: wyslane %lu, odebrane %lu (%.0f/s), utracone %lu, bledne %lu | opoznienie p50 %.2f ms p99 %.2f ms maks %.2f ms\n",
+			rate, sent, received, received / sendingTime, sent - std::min(sent, received), damaged,
+			percentile(latencies, 0.50) * 1000.0, percentile(latencies, 0.99) * 1000.0, percentile(latencies, 1.0) * 1000.0);
+
+		if (host.getConnectionsCount() == 0)
+		{
+			printf("  polaczenie zostalo zerwane\n");
+			return 1;
+		}
+		nextExpected = nextSent;
+	}
+
+	return 0;
+}
+
+
+// Frames of the game following a ship over the map with decorations, 16 ships
+// and 1000 projectiles. The view is the part the culling applies to, the frame
+// adds the minimap, which shows the whole map either way. Sprites are the
+// draw calls there would be without batching.
+int Benchmark::runDraw()
+{
+	const unsigned long shipCount = 16;
+	const std::size_t projectileCount = 1000;
+	const unsigned int warmUpFrames = 30;
+	const unsigned int frames = 300;
+
+	// Returns random float from @a to @b
+	auto random = [](float a, float b) { return (static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX) * (b - a) + a); };
+
+	Game &game = Game::get();
+	createController();
+	game.tick();		// starts the controller
+	std::srand(2701);
+	controller->createMap(GameController::defaultMapWidth, GameController::defaultMapHeight, 2701);
+
+	float halfWidth = GameController::defaultMapWidth / 2;
+	float halfHeight = GameController::defaultMapHeight / 2;
+	for (unsigned long i = 0; i < shipCount; i++)
+		controller->createPlayerShip(random(-halfWidth, halfWidth), random(-halfHeight, halfHeight), random(0.0f, 360.0f), i, "playerShip" + std::to_string(i));
+
+	printf("Rysowanie mapy %.0fx%.0f z %lu statkami i %zu pociskami, widok %ux%u, pomiar %u klatek\n",
+		GameController::defaultMapWidth, GameController::defaultMapHeight, shipCount, projectileCount,
+		game.initialGameViewWidth, game.initialGameViewHeight, frames);
+	for (bool culling : { true, false })
+	{
+		game.viewCulling = culling;
+
+		// Per frame averages
+		double viewSprites = 0.0, viewDrawCalls = 0.0, frameSprites = 0.0, frameDrawCalls = 0.0, queued = 0.0;
+		double renderTime = 0.0, renderMax = 0.0;
+		for (unsigned int i = 0; i < warmUpFrames + frames; i++)
+		{
+			spawnProjectiles(projectileCount);
+			game.tick();
+
+			clock::time_point renderStart = clock::now();
+			game.window.clear();
+			game.render();
+			game.window.display();
+			double frameTime = std::chrono::duration<double>(clock::now() - renderStart).count();
+
+			if (i < warmUpFrames)
+				continue;
+
+			frameSprites += static_cast<double>(game.drawnSprites) / frames;
+			frameDrawCalls += static_cast<double>(game.drawCalls) / frames;
+			renderTime += frameTime / frames;
+			renderMax = std::max(renderMax, frameTime);
+
+			// The view alone, as left by the ship's camera
+			game.drawnSprites = 0;
+			game.queuedActors = 0;
+			game.drawCalls = 0;
+			game.drawActors();
+			viewSprites += static_cast<double>(game.drawnSprites) / frames;
+			viewDrawCalls += static_cast<double>(game.drawCalls) / frames;
+			queued += static_cast<double>(game.queuedActors) / frames;
+		}
+
+		printf("  %s widok: sprite'ow %6.1f, wywolan rysowania %4.1f | klatka: sprite'ow %6.1f, wywolan rysowania %4.1f, render sr %6.3f ms maks %6.3f ms (aktorow w kolejce %.0f)\n",
+			culling ? "z odrzucaniem: " : "bez odrzucania:", viewSprites, viewDrawCalls, frameSprites, frameDrawCalls, renderTime * 1000.0, renderMax * 1000.0, queued);
+	}
+
+	game.viewCulling = true;
+	destroyProjectiles();
+	return 0;
+}
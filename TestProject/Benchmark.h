@@ -0,0 +1,61 @@
+#ifndef BENCHMARK_H_
+#define BENCHMARK_H_
+#include <chrono>
+#include <list>
+#include <memory>
+#include <string>
+#include "Actor.h"
+#include "LaunchOptions.h"
+
+
+class GameController;
+
+
+// Measurements of the engine run instead of the game, without players and
+// without a window unless drawing is measured. The scene is built by the
+// benchmark itself and simulated tick after tick as fast as possible:
+//   collisions - projectiles flying over the map, 100, 1000 and 10000 of
+//                them, ticked with the broad phase and with all pairs tested
+//   actors     - traversals of 10000 actors in 1000 trees, one script per
+//                tree, creation and removal of the trees
+//   network    - small messages sent through localhost at 10000 and more
+//                per second, from a client to the host's message queue
+//   draw       - frames of the map with ships and projectiles drawn with
+//                culling against the view and without it, in a window
+class Benchmark
+{
+	private:
+		using clock = std::chrono::steady_clock;
+
+		// Tick times in seconds
+		struct TickStats
+		{
+			double mean = 0.0;
+			double max = 0.0;
+			double pairs = 0.0;		// actor pairs tested for collision per tick
+		};
+
+		LaunchOptions options;
+		GameController *controller = nullptr;
+		std::list<std::weak_ptr<Actor>> projectiles;
+
+		void createController();
+		void spawnProjectiles(std::size_t count);
+		void destroyProjectiles();
+		TickStats measureTicks(unsigned int warmUpTicks, unsigned int ticks, std::size_t projectileCount);
+
+		int runCollisions();
+		int runActors();
+		int runNetwork();
+		int runDraw();
+
+	public:
+		Benchmark(const LaunchOptions &options);
+		Benchmark(const Benchmark&) = delete;
+		Benchmark& operator=(const Benchmark&) = delete;
+
+		int run();
+};
+
+
+#endif
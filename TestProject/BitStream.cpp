@@ -0,0 +1,196 @@
+#include "BitStream.h"
+#include <algorithm>
+#include <cmath>
+
+
+std::uint32_t QuantizedRange::quantize(float value) const
+{
+	double steps = static_cast<double>((1ull << bits) - 1);
+	double normalized = (static_cast<double>(value) - min) / (static_cast<double>(max) - min);
+	normalized = std::min(std::max(normalized, 0.0), 1.0);
+
+	return static_cast<std::uint32_t>(std::lround(normalized * steps));
+}
+
+
+float QuantizedRange::dequantize(std::uint32_t value) const
+{
+	double steps = static_cast<double>((1ull << bits) - 1);
+	return static_cast<float>(min + value / steps * (static_cast<double>(max) - min));
+}
+
+
+BitWriter::BitWriter(std::vector<char> &buffer)
+	: buffer(buffer)
+{}
+
+
+void BitWriter::writeBits(std::uint32_t value, int bits)
+{
+	if (bits < 32)
+		value &= (1u << bits) - 1;
+
+	scratch |= static_cast<std::uint64_t>(value) << scratchBits;
+	scratchBits += bits;
+
+	while (scratchBits >= 8)
+	{
+		buffer.push_back(static_cast<char>(scratch & 0xFF));
+		scratch >>= 8;
+		scratchBits -= 8;
+	}
+}
+
+
+void BitWriter::writeBool(bool value)
+{
+	writeBits(value ? 1 : 0, 1);
+}
+
+
+// Small numbers take fewer bytes - 7 bits of the value per group, the 8th bit marks continuation
+void BitWriter::writeVarint(std::uint64_t value)
+{
+	do
+	{
+		std::uint32_t group = value & 0x7F;
+		value >>= 7;
+		writeBits(group | (value != 0 ? 0x80 : 0), 8);
+	} while (value != 0);
+}
+
+
+void BitWriter::writeQuantized(float value, const QuantizedRange &range)
+{
+	writeBits(range.quantize(value), range.bits);
+}
+
+
+// Any angle, also a negative one, wrapped into [0, 360) and
+// rounded to one of 2^@bits steps, the last one wrapping to 0
+std::uint32_t BitWriter::quantizeAngle(float degrees, int bits)
+{
+	float normalized = std::fmod(degrees, 360.0f);
+	if (normalized < 0.0f)
+		normalized += 360.0f;
+
+	std::uint32_t steps = 1u << bits;
+	return static_cast<std::uint32_t>(std::lround(normalized / 360.0f * steps)) % steps;
+}
+
+
+void BitWriter::writeAngle(float degrees, int bits)
+{
+	writeBits(quantizeAngle(degrees, bits), bits);
+}
+
+
+void BitWriter::writeString(const std::string &value)
+{
+	writeVarint(value.size());
+	for (char c : value)
+		writeBits(static_cast<unsigned char>(c), 8);
+}
+
+
+// Writes out the remaining bits padded with zeros
+void BitWriter::flush()
+{
+	if (scratchBits > 0)
+		buffer.push_back(static_cast<char>(scratch & 0xFF));
+
+	scratch = 0;
+	scratchBits = 0;
+}
+
+
+BitReader::BitReader(const char *data, std::size_t dataSize)
+	: data(reinterpret_cast<const unsigned char*>(data))
+	, dataSize(dataSize)
+{}
+
+
+std::uint32_t BitReader::readBits(int bits)
+{
+	if (failed || bitPosition + bits > dataSize * 8)
+	{
+		failed = true;
+		return 0;
+	}
+
+	std::uint32_t value = 0;
+	for (int read = 0; read < bits;)
+	{
+		std::size_t byte = bitPosition / 8;
+		int offset = bitPosition % 8;
+		int count = std::min(8 - offset, bits - read);
+
+		std::uint32_t part = (data[byte] >> offset) & ((1u << count) - 1);
+		value |= part << read;
+
+		read += count;
+		bitPosition += count;
+	}
+
+	return value;
+}
+
+
+bool BitReader::readBool()
+{
+	return readBits(1) != 0;
+}
+
+
+std::uint64_t BitReader::readVarint()
+{
+	std::uint64_t value = 0;
+	for (int shift = 0; shift < 64; shift += 7)
+	{
+		std::uint32_t group = readBits(8);
+		if (failed)
+			return 0;
+		value |= static_cast<std::uint64_t>(group & 0x7F) << shift;
+
+		if ((group & 0x80) == 0)
+			return value;
+	}
+
+	failed = true;
+	return 0;
+}
+
+
+float BitReader::readQuantized(const QuantizedRange &range)
+{
+	return range.dequantize(readBits(range.bits));
+}
+
+
+float BitReader::readAngle(int bits)
+{
+	return readBits(bits) * 360.0f / (1u << bits);
+}
+
+
+std::string BitReader::readString()
+{
+	std::uint64_t length = readVarint();
+	if (failed || length > dataSize - bitPosition / 8)
+	{
+		failed = true;
+		return std::string();
+	}
+
+	std::string value(static_cast<std::size_t>(length), '\0');
+	for (auto &c : value)
+		c = static_cast<char>(readBits(8));
+
+	return value;
+}
+
+
+bool BitReader::hasFailed() const
+{
+	return failed;
+}
@@ -0,0 +1,69 @@
+#ifndef BIT_STREAM_H_
+#define BIT_STREAM_H_
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+// Range of a float sent as a fixed point number of @bits bits.
+// Values outside of the range are clamped.
+struct QuantizedRange
+{
+	float min;
+	float max;
+	int bits;
+
+	std::uint32_t quantize(float value) const;
+	float dequantize(std::uint32_t value) const;
+};
+
+
+// Appends values to a byte buffer bit by bit, lowest bits first.
+// flush() has to be called after the last write.
+class BitWriter
+{
+	private:
+		std::vector<char> &buffer;
+		std::uint64_t scratch = 0;
+		int scratchBits = 0;
+
+	public:
+		BitWriter(std::vector<char> &buffer);
+
+		static std::uint32_t quantizeAngle(float degrees, int bits);
+
+		void writeBits(std::uint32_t value, int bits);
+		void writeBool(bool value);
+		void writeVarint(std::uint64_t value);
+		void writeQuantized(float value, const QuantizedRange &range);
+		void writeAngle(float degrees, int bits);
+		void writeString(const std::string &value);
+		void flush();
+};
+
+
+// Reads values written by BitWriter. Reading past the end of the data
+// returns zeros and marks the reader as failed.
+class BitReader
+{
+	private:
+		const unsigned char *data;
+		std::size_t dataSize;
+		std::size_t bitPosition = 0;
+		bool failed = false;
+
+	public:
+		BitReader(const char *data, std::size_t dataSize);
+
+		std::uint32_t readBits(int bits);
+		bool readBool();
+		std::uint64_t readVarint();
+		float readQuantized(const QuantizedRange &range);
+		float readAngle(int bits);
+		std::string readString();
+
+		bool hasFailed() const;
+};
+
+
+#endif
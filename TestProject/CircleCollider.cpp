@@ -1,43 +1,77 @@
 #include "CircleCollider.h"
 
 
+// When both colliders are in the collider store the test uses the
+// world space circles cached there at the last store refresh.
 bool CircleCollider::collisionTest(const Collider &other)
 {
-	auto ownerActorShared = getOwnerActor().lock();
-	auto otherOwnerActorShared = other.getOwnerActor().lock();
+	if (store != nullptr)
+	{
+		int selfIndex = getStoreIndex(*store);
+		int otherIndex = other.getStoreIndex(*store);
+		if (selfIndex >= 0 && otherIndex >= 0)
+			return store->overlaps(selfIndex, otherIndex);
+	}
 
-	if (!ownerActorShared || !otherOwnerActorShared)
+	if (getOwnerActor().expired() || other.getOwnerActor().expired())
 		return false;
 
 	const CircleCollider *coll = dynamic_cast<const CircleCollider*>(&other);
 	if (coll)
 	{
-		sf::Vector2f posSelf = Tools::ScaleVector(
-			Tools::rotate(
-				relativePosition,
-				ownerActorShared->getGlobalRotation()),
-			ownerActorShared->getGlobalScale()) + ownerActorShared->getGlobalPosition();
-
-		sf::Vector2f posOther = Tools::ScaleVector(
-			Tools::rotate(
-				other.relativePosition,
-				otherOwnerActorShared->getGlobalRotation()),
-			otherOwnerActorShared->getGlobalScale()) + otherOwnerActorShared->getGlobalPosition();
-
-		float xDiff = posOther.x - posSelf.x;
-		float yDiff = posOther.y - posSelf.y;
-		float distance = std::sqrt(xDiff*xDiff + yDiff*yDiff);
-
-		float avgScale = Tools::dot(ownerActorShared->getGlobalScale(), sf::Vector2f(1.0f, 1.0f)) / 2;
-		float avgScaleOther = Tools::dot(otherOwnerActorShared->getGlobalScale(), sf::Vector2f(1.0f, 1.0f)) / 2;
-
-		return radius*avgScale + coll->radius*avgScaleOther >= distance;
+		sf::Vector2f diff = coll->getGlobalCenter() - getGlobalCenter();
+		float radiiSum = getGlobalRadius() + coll->getGlobalRadius();
+
+		return radiiSum*radiiSum >= Tools::dot(diff, diff);
 	}
 	else
 		return false;
 }
 
 
+bool CircleCollider::addToStore(ColliderStore &store, Actor *owner)
+{
+	this->store = &store;
+	storeIndex = store.add(this, owner, getGlobalCenter(), getGlobalRadius());
+	return true;
+}
+
+
+// Returns the axis aligned box enclosing the collider in world space
+sf::FloatRect CircleCollider::getGlobalBounds() const
+{
+	sf::Vector2f center = getGlobalCenter();
+	float scaledRadius = getGlobalRadius();
+
+	return sf::FloatRect(center.x - scaledRadius, center.y - scaledRadius, 2 * scaledRadius, 2 * scaledRadius);
+}
+
+
+sf::Vector2f CircleCollider::getGlobalCenter() const
+{
+	auto ownerActorShared = getOwnerActor().lock();
+	if (!ownerActorShared)
+		return relativePosition;
+
+	return Tools::ScaleVector(
+		Tools::rotate(
+			relativePosition,
+			ownerActorShared->getGlobalRotation()),
+		ownerActorShared->getGlobalScale()) + ownerActorShared->getGlobalPosition();
+}
+
+
+float CircleCollider::getGlobalRadius() const
+{
+	auto ownerActorShared = getOwnerActor().lock();
+	if (!ownerActorShared)
+		return static_cast<float>(radius);
+
+	float avgScale = Tools::dot(ownerActorShared->getGlobalScale(), sf::Vector2f(1.0f, 1.0f)) / 2;
+	return static_cast<float>(radius) * avgScale;
+}
+
+
 //void CircleCollider::copy(const Component &other)
 //{
 //	const CircleCollider *component = dynamic_cast<const CircleCollider*>(&other);
@@ -48,7 +82,7 @@ bool CircleCollider::collisionTest(const Collider &other)
 //}
 
 
-void CircleCollider::draw(sf::RenderWindow &window) const
+void CircleCollider::draw(sf::RenderTarget &target) const
 {
 	auto ownerActorShared = getOwnerActor().lock();
 	if (!ownerActorShared)
@@ -68,5 +102,5 @@ void CircleCollider::draw(sf::RenderWindow &window) const
 			ownerActorShared->getGlobalRotation()),
 		ownerActorShared->getGlobalScale()) + ownerActorShared->getGlobalPosition());
 	
-	window.draw(circle);
+	target.draw(circle);
 }
\ No newline at end of file
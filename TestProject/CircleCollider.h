@@ -4,7 +4,7 @@
 #include "Actor.h"
 
 
-class CircleCollider : public Collider
+class CircleCollider final : public Collider
 {
 	CLONEABLE_COMPONENT();
 
@@ -12,7 +12,11 @@ class CircleCollider : public Collider
 		double radius = 0;
 
 		bool collisionTest(const Collider &other) override;
-		void draw(sf::RenderWindow &window) const override;
+		sf::FloatRect getGlobalBounds() const override;
+		bool addToStore(ColliderStore &store, Actor *owner) override;
+		sf::Vector2f getGlobalCenter() const;
+		float getGlobalRadius() const;
+		void draw(sf::RenderTarget &target) const override;
 };
 
 
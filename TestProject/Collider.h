@@ -2,17 +2,39 @@
 #define COLLIDER_H_
 #include <SFML/Graphics.hpp>
 #include "Component.h"
+#include "ColliderStore.h"
 
 
 class Collider : public Component
 {
+	protected:
+		const ColliderStore *store = nullptr;	// store the collider was last added to
+		int storeIndex = -1;
+
 	public:
 		sf::Vector2f relativePosition;
 
-		virtual ~Collider() = 0 {}
+		virtual ~Collider() = 0;
 		virtual bool collisionTest(const Collider &other) = 0;
-		virtual void draw(sf::RenderWindow &window) const {}
+		virtual sf::FloatRect getGlobalBounds() const = 0;
+		virtual void draw(sf::RenderTarget &target) const {}
+
+		// Colliders which can be represented in the store add themselves
+		// and return true. Others are tested with collisionTest().
+		virtual bool addToStore(ColliderStore &store, Actor *owner) { return false; }
+
+		// Returns the index of the collider in the store or -1 if the
+		// collider wasn't added to it since its last refresh
+		int getStoreIndex(const ColliderStore &store) const
+		{
+			if (this->store != &store || storeIndex < 0 || storeIndex >= static_cast<int>(store.size()))
+				return -1;
+			return store.getCollider(storeIndex) == this ? storeIndex : -1;
+		}
 };
 
 
+inline Collider::~Collider() {}
+
+
 #endif
\ No newline at end of file
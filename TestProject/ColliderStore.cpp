@@ -0,0 +1,156 @@
+#include "ColliderStore.h"
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#define COLLIDER_STORE_AVX
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define COLLIDER_STORE_SSE
+#endif
+
+
+void ColliderStore::clear()
+{
+	centersX.clear();
+	centersY.clear();
+	radii.clear();
+	colliders.clear();
+	owners.clear();
+}
+
+
+// Returns the index of the new entry
+int ColliderStore::add(const Collider *collider, Actor *owner, const sf::Vector2f &center, float radius)
+{
+	centersX.push_back(center.x);
+	centersY.push_back(center.y);
+	radii.push_back(radius);
+	colliders.push_back(collider);
+	owners.push_back(owner);
+
+	return static_cast<int>(colliders.size()) - 1;
+}
+
+
+std::size_t ColliderStore::size() const
+{
+	return colliders.size();
+}
+
+
+const Collider* ColliderStore::getCollider(int index) const
+{
+	return colliders[index];
+}
+
+
+Actor* ColliderStore::getOwner(int index) const
+{
+	return owners[index];
+}
+
+
+sf::Vector2f ColliderStore::getCenter(int index) const
+{
+	return sf::Vector2f(centersX[index], centersY[index]);
+}
+
+
+float ColliderStore::getRadius(int index) const
+{
+	return radii[index];
+}
+
+
+sf::FloatRect ColliderStore::getBounds(int index) const
+{
+	return sf::FloatRect(centersX[index] - radii[index], centersY[index] - radii[index], 2 * radii[index], 2 * radii[index]);
+}
+
+
+bool ColliderStore::overlaps(int a, int b) const
+{
+	float xDiff = centersX[b] - centersX[a];
+	float yDiff = centersY[b] - centersY[a];
+	float radiiSum = radii[a] + radii[b];
+
+	return xDiff*xDiff + yDiff*yDiff <= radiiSum*radiiSum;
+}
+
+
+// Tests the entry at 'index' against entries [first, last). Returns
+// the index of the first overlapping entry or -1 if there is none.
+int ColliderStore::findFirstOverlap(int index, std::size_t first, std::size_t last) const
+{
+	if (first >= last)
+		return -1;
+
+	int result = circleBatchTest(centersX[index], centersY[index], radii[index], &centersX[first], &centersY[first], &radii[first], last - first);
+	return result < 0 ? -1 : static_cast<int>(first) + result;
+}
+
+
+// Tests one circle against a batch of circles using squared distances.
+// Returns the position of the first overlapping circle in the batch or
+// -1 if none of them overlaps.
+int ColliderStore::circleBatchTest(float x, float y, float radius, const float *centersX, const float *centersY, const float *radii, std::size_t count)
+{
+	std::size_t i = 0;
+
+#if defined(COLLIDER_STORE_AVX)
+	__m256 px = _mm256_set1_ps(x);
+	__m256 py = _mm256_set1_ps(y);
+	__m256 pr = _mm256_set1_ps(radius);
+
+	for (; i + 8 <= count; i += 8)
+	{
+		__m256 dx = _mm256_sub_ps(_mm256_loadu_ps(centersX + i), px);
+		__m256 dy = _mm256_sub_ps(_mm256_loadu_ps(centersY + i), py);
+		__m256 r = _mm256_add_ps(_mm256_loadu_ps(radii + i), pr);
+
+		__m256 distanceSq = _mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy));
+		int mask = _mm256_movemask_ps(_mm256_cmp_ps(distanceSq, _mm256_mul_ps(r, r), _CMP_LE_OQ));
+
+		if (mask != 0)
+		{
+			for (int bit = 0; bit < 8; bit++)
+				if (mask & (1 << bit))
+					return static_cast<int>(i) + bit;
+		}
+	}
+#elif defined(COLLIDER_STORE_SSE)
+	__m128 px = _mm_set1_ps(x);
+	__m128 py = _mm_set1_ps(y);
+	__m128 pr = _mm_set1_ps(radius);
+
+	for (; i + 4 <= count; i += 4)
+	{
+		__m128 dx = _mm_sub_ps(_mm_loadu_ps(centersX + i), px);
+		__m128 dy = _mm_sub_ps(_mm_loadu_ps(centersY + i), py);
+		__m128 r = _mm_add_ps(_mm_loadu_ps(radii + i), pr);
+
+		__m128 distanceSq = _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy));
+		int mask = _mm_movemask_ps(_mm_cmple_ps(distanceSq, _mm_mul_ps(r, r)));
+
+		if (mask != 0)
+		{
+			for (int bit = 0; bit < 4; bit++)
+				if (mask & (1 << bit))
+					return static_cast<int>(i) + bit;
+		}
+	}
+#endif
+
+	// Remaining circles (or all of them without SIMD support)
+	for (; i < count; i++)
+	{
+		float xDiff = centersX[i] - x;
+		float yDiff = centersY[i] - y;
+		float radiiSum = radii[i] + radius;
+
+		if (xDiff*xDiff + yDiff*yDiff <= radiiSum*radiiSum)
+			return static_cast<int>(i);
+	}
+
+	return -1;
+}
@@ -0,0 +1,42 @@
+#ifndef COLLIDER_STORE_H_
+#define COLLIDER_STORE_H_
+#include <SFML/Graphics.hpp>
+#include <vector>
+
+
+class Actor;
+class Collider;
+
+
+// Packed structure-of-arrays table of world space circles used by the
+// collision detection. Refreshed once per frame - colliders of one actor
+// tree are stored next to each other, so whole trees can be tested
+// against each other with the batch kernel.
+class ColliderStore
+{
+	private:
+		std::vector<float> centersX;
+		std::vector<float> centersY;
+		std::vector<float> radii;
+		std::vector<const Collider*> colliders;
+		std::vector<Actor*> owners;
+
+	public:
+		void clear();
+		int add(const Collider *collider, Actor *owner, const sf::Vector2f &center, float radius);
+
+		std::size_t size() const;
+		const Collider* getCollider(int index) const;
+		Actor* getOwner(int index) const;
+		sf::Vector2f getCenter(int index) const;
+		float getRadius(int index) const;
+		sf::FloatRect getBounds(int index) const;
+
+		bool overlaps(int a, int b) const;
+		int findFirstOverlap(int index, std::size_t first, std::size_t last) const;
+
+		static int circleBatchTest(float x, float y, float radius, const float *centersX, const float *centersY, const float *radii, std::size_t count);
+};
+
+
+#endif
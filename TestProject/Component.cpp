@@ -1,6 +1,9 @@
 #include "Component.h"
 
 
+std::atomic<ComponentTypeId> Component::typeIdSeed(0);
+
+
 Component::Component(const Component &component)
 {
 	ownerActor = component.ownerActor;
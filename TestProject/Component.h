@@ -1,17 +1,24 @@
 #ifndef COMPONENT_H_
 #define COMPONENT_H_
+#include <atomic>
 #include <memory>
 #include "IDestructible.h"
+#include "MemoryPool.h"
 
 
 #define CLONEABLE_COMPONENT(...) \
-std::weak_ptr<Component> clone() const override \
+std::shared_ptr<Component> clone() const override \
 { \
-	return std::shared_ptr<Component>(new std::decay<decltype(*this)>::type(*this)); \
+	return Component::createComponent(*this); \
+} \
+ComponentTypeId getTypeId() const override \
+{ \
+	return Component::typeIdOf<std::decay<decltype(*this)>::type>(); \
 }
 
 
 class Actor;
+using ComponentTypeId = std::size_t;
 
 
 class Component : public IDestructible
@@ -23,13 +30,22 @@ class Component : public IDestructible
 		std::weak_ptr<Actor> ownerActor;
 		std::weak_ptr<Component> handle;
 
+		static std::atomic<ComponentTypeId> typeIdSeed;
+
 	public:
 		Component() = default;
 		Component(const Component &component);
-		virtual ~Component() = 0 {}
+		virtual ~Component() = 0;
 
 		template <typename T>
 		static std::shared_ptr<Component> createComponent();
+		template <typename T>
+		static std::shared_ptr<Component> createComponent(const T &original);
+
+		// Unique identifier of the component type T, assigned on first use
+		template <typename T>
+		static ComponentTypeId typeIdOf();
+		virtual ComponentTypeId getTypeId() const = 0;
 
 		std::weak_ptr<Actor> getOwnerActor();
 		std::weak_ptr<const Actor> getOwnerActor() const;
@@ -37,22 +53,46 @@ class Component : public IDestructible
 		std::weak_ptr<const Component> getHandle() const;
 
 		//virtual void copy(const Component &other) const = 0;
-		virtual std::weak_ptr<Component> clone() const = 0;
+		virtual std::shared_ptr<Component> clone() const = 0;
 
 		bool isDestroyed() const override;
 		void destroy() override;
 };
 
 
+inline Component::~Component() {}
+
+
 template <typename T>
 std::shared_ptr<Component> Component::createComponent()
 {
 	static_assert(std::is_base_of<Component, T>::value, "Component::createComponent<T>() template T parameter must derive from Component class.");
 
-	std::shared_ptr<Component> newComponent = std::shared_ptr<Component>(new T);
+	std::shared_ptr<Component> newComponent = adoptPooled<T, Component>(new (allocatePooled<T>()) T);
+	newComponent->handle = newComponent;
+	return newComponent;
+}
+
+
+
+// Creates a copy of the original component
+template <typename T>
+std::shared_ptr<Component> Component::createComponent(const T &original)
+{
+	static_assert(std::is_base_of<Component, T>::value, "Component::createComponent<T>() template T parameter must derive from Component class.");
+
+	std::shared_ptr<Component> newComponent = adoptPooled<T, Component>(new (allocatePooled<T>()) T(original));
 	newComponent->handle = newComponent;
 	return newComponent;
 }
 
 
+template <typename T>
+ComponentTypeId Component::typeIdOf()
+{
+	static const ComponentTypeId id = typeIdSeed++;
+	return id;
+}
+
+
 #endif
\ No newline at end of file
@@ -12,12 +12,15 @@
 
 struct CoroutineResultType
 {
-	virtual ~CoroutineResultType() = 0 {}
+	virtual ~CoroutineResultType() = 0;
 	virtual bool keepWaiting() { return false; }
 	virtual bool terminate() { return false; }
 };
 
 
+inline CoroutineResultType::~CoroutineResultType() {}
+
+
 struct CoroutineFinished : public CoroutineResultType
 {
 	bool terminate() { return true; }
@@ -83,8 +86,11 @@ class Coroutine
 		virtual std::unique_ptr<CoroutineResultType> operator()() = 0;
 
 	public:
-		virtual ~Coroutine() = 0 {}
+		virtual ~Coroutine() = 0;
 };
 
 
+inline Coroutine::~Coroutine() {}
+
+
 #endif
\ No newline at end of file
@@ -1,4 +1,6 @@
 #include "Game.h"
+#include <cmath>
+#include "Profiler.h"
 
 
 Game::Game()
@@ -6,10 +8,15 @@ Game::Game()
 	, initialWindowHeight(800)
 	, initialGameViewWidth(1800)
 	, initialGameViewHeight(1200)
-	, window(sf::VideoMode(initialWindowWidth, initialWindowHeight), "SFML works!")
 {
+	fixedDeltaTime = 1.0 / launchOptions.tickRate;
+
+	// A dedicated host only simulates the game, it doesn't need a window or textures
+	if (isHeadless())
+		return;
+
+	window.create(sf::VideoMode(initialWindowWidth, initialWindowHeight), "SFML works!");
 	window.setKeyRepeatEnabled(false);
-	initCollision();
 
 	// Initialize the game viewing area
 	setView(sf::Vector2f(0.0f, 0.0f), initialGameViewWidth, initialGameViewHeight);
@@ -40,40 +47,52 @@ Game::Game()
 	loadTextures(textures.plasmaFire, "Assets\\plasmaFire.png");
 	loadTextures(textures.plasmaProjectile, "Assets\\plasmaProjectile.png");
 	loadTextures(textures.plasmaSplash, "Assets\\plasmaSplash.png");
+
+	if (textureAtlas.pack() == false)
+		std::cerr << "Nie udalo sie utworzyc atlasu tekstur" << std::endl;
 }
 
 
-Game::CollThreadData::CollThreadData()
-{}
+LaunchOptions Game::launchOptions;
+
+
+Game& Game::get()
+{
+	static Game game;
+	return game;
+}
 
 
-Game::CollThreadData::CollThreadData(const CollThreadData &collThreadData)
+void Game::setLaunchOptions(const LaunchOptions &options)
 {
-	dataReady = collThreadData.dataReady;
-	resultList = collThreadData.resultList;
-	firstActor = collThreadData.firstActor;
-	actorsToTest = collThreadData.actorsToTest;
+	launchOptions = options;
 }
 
 
-Game::~Game()
+const LaunchOptions& Game::getLaunchOptions() const
 {
-	std::unique_lock<std::mutex> lck(stopConditionBlocade);
-	stopCollisionThreads = true;
-	lck.unlock();
+	return launchOptions;
+}
 
-	for (auto &i : perThreadCollisions)
-		i.dataAvailability.notify_one();
 
-	for (auto &thread : threads)
-		thread.join();
+// Benchmarks don't need a window either, except the one measuring drawing
+bool Game::isHeadless() const
+{
+	return launchOptions.host || (launchOptions.benchmark.empty() == false && launchOptions.benchmark != "draw");
 }
 
 
-Game& Game::get()
+bool Game::isRunning() const
 {
-	static Game game;
-	return game;
+	return running && (isHeadless() || window.isOpen());
+}
+
+
+void Game::quit()
+{
+	running = false;
+	if (window.isOpen())
+		window.close();
 }
 
 
@@ -83,7 +102,10 @@ void Game::loadTextures(sf::Texture &texture, const std::string &path)
 	if (!texture.loadFromFile(path.c_str()))
 	{
 		//MessageBoxA(0, ("Nie udalo sie wczytac tekstury " + path).c_str(), "Blad", MB_ICONWARNING);
+		return;
 	}
+
+	textureAtlas.add(texture);
 }
 
 
@@ -118,12 +140,135 @@ sf::View Game::fitViewIn(const sf::View &view, float newWidth, float newHeight)
 }
 
 
+// Runs as many simulation ticks as fit in the time passed since the last
+// frame. The remainder is carried over to the next frame and used to
+// interpolate drawing between the last two simulated states.
+void Game::advance(double frameTime)
+{
+	this->frameTime = frameTime;
+	tickAccumulator += frameTime;
+
+	unsigned int ticks = 0;
+	while (tickAccumulator >= fixedDeltaTime && ticks < maxTicksPerFrame)
+	{
+		tick();
+		tickAccumulator -= fixedDeltaTime;
+		ticks++;
+	}
+
+	// Drop the time which couldn't be simulated in this frame
+	if (tickAccumulator >= fixedDeltaTime)
+		tickAccumulator = std::fmod(tickAccumulator, fixedDeltaTime);
+
+	renderAlpha = static_cast<float>(tickAccumulator / fixedDeltaTime);
+}
+
+
+// Advances the simulation by exactly fixedDeltaTime
+void Game::tick()
+{
+	PROFILE_SCOPE("Game::tick");
+	steady_clock::time_point tickStart = steady_clock::now();
+	deltaTime = fixedDeltaTime;
+	for (auto &i : actorRoot->getChildren())
+		i->saveTickTransform();
+
+	updateTransforms();
+	testCollisions();
+	update();
+	executeActorCoroutines();
+	removeDestroyedActors();
+	tickCount++;
+	tickDuration = std::chrono::duration<double>(steady_clock::now() - tickStart).count();
+}
+
+
+// Draws the actors between the last two simulated states. Scripts move
+// the camera in onPreRender and draw overlays in onPostRender.
+void Game::render()
+{
+	PROFILE_SCOPE("Game::render");
+	interpolateTransforms();
+	updateTransforms();
+
+	drawnSprites = 0;
+	queuedActors = 0;
+	drawCalls = 0;
+	actorRoot->notifyScripts(&BehaviourScript::onPreRender);
+	drawActors();
+	actorRoot->notifyScripts(&BehaviourScript::onPostRender);
+	PROFILE_COUNTER("Draw: queued actors", static_cast<double>(queuedActors));
+	PROFILE_COUNTER("Draw: sprites drawn", static_cast<double>(drawnSprites));
+	PROFILE_COUNTER("Draw: draw calls", static_cast<double>(drawCalls));
+
+	restoreTransforms();
+}
+
+
+// Only top level actors are interpolated, their children follow them
+void Game::interpolateTransforms()
+{
+	simulatedTransforms.clear();
+	for (auto &i : actorRoot->getChildren())
+	{
+		sf::Vector2f previousPosition;
+		float previousRotation;
+		if (i->getTickTransform(previousPosition, previousRotation) == false)
+			continue;
+
+		sf::Vector2f position = i->getLocalPosition();
+		float rotation = i->getLocalRotation();
+		if (previousPosition == position && previousRotation == rotation)
+			continue;
+		if (Tools::length(position - previousPosition) > maxInterpolatedDistance)
+			continue;
+
+		simulatedTransforms.push_back({ i.get(), position, rotation });
+		i->setLocalPosition(previousPosition + (position - previousPosition) * renderAlpha);
+		i->setLocalRotation(Tools::lerpAngle(previousRotation, rotation, renderAlpha));
+	}
+}
+
+
+void Game::restoreTransforms()
+{
+	for (auto &i : simulatedTransforms)
+	{
+		i.actor->setLocalPosition(i.position);
+		i.actor->setLocalRotation(i.rotation);
+	}
+	simulatedTransforms.clear();
+}
+
+
 void Game::update()
 {
+	PROFILE_SCOPE("Game::update");
 	actorRoot->update();
 }
 
 
+// Propagates dirty transforms down the actor trees once per frame. Top
+// level trees are independent from each other, so they are processed on
+// the job system. Afterwards global transform getters don't modify actors,
+// which makes them safe to call from the collision jobs.
+void Game::updateTransforms()
+{
+	PROFILE_SCOPE("Game::updateTransforms");
+	transformRoots.clear();
+	for (auto &i : actorRoot->getChildren())
+		transformRoots.push_back(i.get());
+
+	// The root has to be up to date before its children read it concurrently
+	actorRoot->getGlobalPosition();
+	jobSystem.parallelFor(transformRoots.size(), 64, [this](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t i = begin; i < end; i++)
+			transformRoots[i]->updateTransforms();
+	});
+}
+
+
 void Game::notifyScripts(void(BehaviourScript::*notifyMethod)(sf::Event event), sf::Event event)
 {
 	actorRoot->notifyScripts(notifyMethod, event);
@@ -132,18 +277,47 @@ void Game::notifyScripts(void(BehaviourScript::*notifyMethod)(sf::Event event),
 
 void Game::drawActors()
 {
-	std::list<Actor*> drawables;
-	for (auto &i : actorRoot->getChildren())
-		drawables.push_back(i.get());
+	drawActors(window);
+}
+
+
+// Draws the actors seen through the current view of the target, which may
+// also be a render texture
+void Game::drawActors(sf::RenderTarget &target)
+{
+	PROFILE_SCOPE("Game::drawActors");
+	const RenderQueue &renderQueue = *actorRoot->getRenderQueue();
+
+	// World area seen through the current view, also when it is rotated
+	sf::FloatRect visibleArea = target.getView().getInverseTransform().transformRect(sf::FloatRect(-1.0f, -1.0f, 2.0f, 2.0f));
+	auto drawActor = [&](const Actor &actor)
+	{
+		if (actor.draw(spriteBatch, visibleArea))
+			drawnSprites++;
+	};
+
+	spriteBatch.begin(target);
+	if (viewCulling)
+		renderQueue.forEachVisible(visibleArea, drawActor);
+	else
+	{
+		// An area covering every sprite, so that all of them reach the batch
+		visibleArea = sf::FloatRect(-1e30f, -1e30f, 2e30f, 2e30f);
+		renderQueue.forEach(drawActor);
+	}
+	spriteBatch.end();
+	drawCalls += spriteBatch.getDrawCalls();
+	queuedActors += renderQueue.getSize();
 
-	drawables.sort([](auto &a, auto &b) { return a->getDepth() < b->getDepth(); });
-	for (auto &i : drawables)
-		i->draw(window, drawColliders);
+	// Colliders are drawn over all sprites
+	if (drawColliders)
+		renderQueue.forEach([&](const Actor &actor) { actor.drawColliders(target); });
 }
 
 
 void Game::executeActorCoroutines()
 {
+	PROFILE_SCOPE("Game::executeActorCoroutines");
 	actorRoot->executeCoroutines();
 }
 
@@ -154,172 +328,207 @@ std::weak_ptr<Actor> Game::getRootActor()
 }
 
 
+std::weak_ptr<Actor> Game::findActor(unsigned long id)
+{
+	return Actor::findActor(id);
+}
+
+
+JobSystem& Game::getJobSystem()
+{
+	return jobSystem;
+}
+
+
 void Game::removeDestroyedActors()
 {
+	PROFILE_SCOPE("Game::removeDestroyedActors");
 	actorRoot->removeDestroyedChildren();
 }
 
 
-// Runs a number of threads which purpose is to test if a number of
-// actors collide with each other when notified
-void Game::initCollision()
+// Tests actor with its children against another actor with their children.
+// On success 'whoCollided' holds the actors owning the colliding colliders.
+bool Game::testActorCollision(Actor &a, Actor &b, Collision &whoCollided)
 {
-	unsigned int threadsCount = std::thread::hardware_concurrency();
-	if (threadsCount == 0)
-		threadsCount = 2;
+	// Test a with b
+	for (auto &aCollider : a.getColliderList())
+	{
+		for (auto &bCollider : b.getColliderList())
+		{
+			if (aCollider->collisionTest(*bCollider))
+			{
+				whoCollided.first = &a;
+				whoCollided.second = &b;
+				return true;
+			}
+		}
+	}
 
-	perThreadCollisions.resize(threadsCount);
-	threads.reserve(threadsCount);
+	// Test a with all children of b and b with children of a
+	for (auto &i : b.getChildren())
+	{
+		if (testActorCollision(a, *i, whoCollided))
+			return true;
+	}
+
+	for (auto &i : a.getChildren())
+	{
+		if (testActorCollision(*i, b, whoCollided))
+			return true;
+	}
 
-	for (int i = 0; i < static_cast<int>(threadsCount); i++)
-		threads.push_back(std::thread(&Game::perThreadTest, this, std::ref<CollThreadData>(perThreadCollisions[i])));
+	return false;
 }
 
 
-// Each thread tests if a number of actors collide with each other upon notification
-void Game::perThreadTest(Game::CollThreadData &collThreadData)
+// Tests two collider trees against each other. Trees made of stored colliders
+// are tested with the batch kernel of the collider store.
+bool Game::testTreeCollision(const ColliderTree &a, const ColliderTree &b, Collision &whoCollided) const
 {
-	while (true)
+	if (a.fullyStored == false || b.fullyStored == false)
+		return testActorCollision(*a.actor, *b.actor, whoCollided);
+
+	for (std::size_t i = a.first; i < a.last; i++)
 	{
-		// Check if the thread should finish
-		std::unique_lock<std::mutex> stopConditionLock(stopConditionBlocade);
-		if (stopCollisionThreads == true)
-			return;
-		stopConditionLock.unlock();
-
-		// Wait until the next portion of collision data is available
-		std::unique_lock<std::mutex> dataBlockadeLock(collThreadData.dataBlockade);
-		while (true)
+		int other = colliderStore.findFirstOverlap(static_cast<int>(i), b.first, b.last);
+		if (other >= 0)
 		{
-			if (stopCollisionThreads == true)
-				return;
-			else if (collThreadData.dataReady == false)
-				collThreadData.dataAvailability.wait(dataBlockadeLock);
-			else break;
+			whoCollided.first = colliderStore.getOwner(static_cast<int>(i));
+			whoCollided.second = colliderStore.getOwner(other);
+			return true;
 		}
+	}
+
+	return false;
+}
+
 
-		std::pair<Actor*, Actor*> whoCollided;
+// Fills the collider store with world space circles of all colliders. Colliders
+// of every top level actor tree end up in one contiguous range of the store.
+void Game::refreshColliderStore()
+{
+	colliderStore.clear();
+	colliderTrees.clear();
 
-		// Tests actor with its children against another actor with their children
-		std::function<bool(Actor &a, Actor &b)> testActorCollision = [&](Actor &a, Actor &b)
+	std::function<void(Actor&, ColliderTree&, bool&)> addTree = [&](Actor &actor, ColliderTree &tree, bool &hasColliders)
+	{
+		for (auto &collider : actor.getColliderList())
 		{
-			// Test a with b
-			for (auto &aCollider : a.getColliderList())
+			sf::FloatRect colliderBounds;
+			if (collider->addToStore(colliderStore, &actor))
+				colliderBounds = colliderStore.getBounds(static_cast<int>(colliderStore.size()) - 1);
+			else
 			{
-				for (auto &bCollider : b.getColliderList())
-				{
-					if (aCollider->collisionTest(*bCollider))
-					{
-						whoCollided.first = &a;
-						whoCollided.second = &b;
-						return true;
-					}
-				}
+				colliderBounds = collider->getGlobalBounds();
+				tree.fullyStored = false;
 			}
 
-			// Test a with all children of b and b with children of a
-			auto testWithChildren = [&](Actor &a, Actor &b)
+			if (hasColliders == false)
+				tree.bounds = colliderBounds;
+			else
 			{
-				for (auto &i : b.getChildren())
-				{
-					if (testActorCollision(a, *i))
-					{
-						whoCollided.first = &a;
-						whoCollided.second = &(*i);
-						return true;
-					}
-				}
-
-				return false;
-			};
-
-			if (testWithChildren(a, b) || testWithChildren(b, a))
-				return true;
-
-			return false;
-		};
-
-		// Perform collision test for 'actorsToTest' number of actors
-		for (int i = 0; i < collThreadData.actorsToTest; i++, collThreadData.firstActor++)
-		{
-			for (auto other = std::next(collThreadData.firstActor); other != actorRoot->getChildren().end(); other++)
-			{
-				if (testActorCollision(*(*collThreadData.firstActor), *(*other)))
-					collThreadData.resultList.push_back(whoCollided);
+				float right = std::max(tree.bounds.left + tree.bounds.width, colliderBounds.left + colliderBounds.width);
+				float bottom = std::max(tree.bounds.top + tree.bounds.height, colliderBounds.top + colliderBounds.height);
+				tree.bounds.left = std::min(tree.bounds.left, colliderBounds.left);
+				tree.bounds.top = std::min(tree.bounds.top, colliderBounds.top);
+				tree.bounds.width = right - tree.bounds.left;
+				tree.bounds.height = bottom - tree.bounds.top;
 			}
+			hasColliders = true;
 		}
 
-		collThreadData.dataReady = false;
+		for (auto &child : actor.getChildren())
+			addTree(*child, tree, hasColliders);
+	};
+
+	for (auto &actor : actorRoot->getChildren())
+	{
+		ColliderTree tree = { actor.get(), colliderStore.size(), 0, true, sf::FloatRect() };
+		bool hasColliders = false;
+
+		addTree(*actor, tree, hasColliders);
+		tree.last = colliderStore.size();
+
+		if (hasColliders)
+			colliderTrees.push_back(tree);
 	}
 }
 
 
-// Very slow without compiler optimizations (on debug).
-// TODO: improve on n^2 complexity and rewrite to reduce
-// the constant factor
-void Game::testCollisions()
+// Puts every collider tree into the broad phase grid.
+// The grid is rebuilt from scratch each frame.
+void Game::buildCollisionGrid()
 {
-	using Collision = std::pair<Actor*, Actor*>;
+	float largestRadius = 0.0f;
+	for (auto &tree : colliderTrees)
+	{
+		for (std::size_t i = tree.first; i < tree.last; i++)
+			largestRadius = std::max(largestRadius, colliderStore.getRadius(static_cast<int>(i)));
+	}
 
-	int actorListsize = static_cast<int>(actorRoot->getChildren().size());
-	if (actorListsize <= 1)
-		return;
+	// Default cell size is the largest collider radius rounded up to a power
+	// of two, so it changes only when the radius crosses one
+	float cellSize = collisionCellSize;
+	if (cellSize <= 0.0f && largestRadius > 0.0f)
+		cellSize = std::exp2(std::ceil(std::log2(largestRadius)));
+	collisionGrid.setCellSize(cellSize);
+	collisionGrid.clear();
+
+	for (std::size_t i = 0; i < colliderTrees.size(); i++)
+		collisionGrid.insert(static_cast<int>(i), colliderTrees[i].bounds);
+}
+
+
+// Broad phase finds the pairs of top level actors which share a grid
+// cell, then the pairs are tested in chunks on the job system.
+void Game::testCollisions()
+{
+	PROFILE_SCOPE("Game::testCollisions");
+	refreshColliderStore();
 
-	// Get the total amount of collision checks and determine
-	// the suitable amount of tests per thread
-	int totalCollisionTests = (actorListsize*(actorListsize - 1)) / 2;
-	int testsPerThread = totalCollisionTests / static_cast<int>(threads.size());
-	if (testsPerThread == 0)
-		testsPerThread = 1;
-
-	std::list<std::shared_ptr<Actor>>::const_iterator currentActor = actorRoot->getChildren().cbegin();
-	int actorIndex = 0;
-	int threadIndex = 0;
-	for (int i = 0; i < totalCollisionTests && actorIndex != actorListsize - 1;)
+	candidatePairs.clear();
+	if (collisionBroadPhase)
+	{
+		buildCollisionGrid();
+		collisionGrid.getCandidatePairs(candidatePairs);
+	}
+	else
 	{
-		int actorsToTest = 0;	// how many actors to test per thread
-		for (int j = 0; j < testsPerThread && i < totalCollisionTests; actorIndex++)
+		for (int i = 0; i < static_cast<int>(colliderTrees.size()); i++)
 		{
-			int testsAtIndex = actorListsize - actorIndex - 1;	// tests done for actor at index
-
-			j += testsAtIndex;
-			i += testsAtIndex;
-			actorsToTest++;
+			for (int j = i + 1; j < static_cast<int>(colliderTrees.size()); j++)
+				candidatePairs.emplace_back(i, j);
 		}
-
-		// Update information for collision threads and order them to do the collision tests
-		std::unique_lock<std::mutex> lck(perThreadCollisions[threadIndex].dataBlockade);
-		perThreadCollisions[threadIndex].actorsToTest = actorsToTest;
-		perThreadCollisions[threadIndex].firstActor = currentActor;
-		perThreadCollisions[threadIndex].resultList.clear();
-		perThreadCollisions[threadIndex].dataReady = true;
-		lck.unlock();
-		perThreadCollisions[threadIndex].dataAvailability.notify_all();
-
-		std::advance(currentActor, actorsToTest);
-		threadIndex++;
 	}
 
-	std::vector<std::unique_lock<std::mutex>> locks;
-	locks.reserve(threads.size());
-
-	// Wait for all thread to finish collision checks (each blockade unlocks when the thread
-	// finished processing its data)
-	for (int i = 0; i < static_cast<int>(threads.size()); i++)
-		locks.push_back(std::unique_lock<std::mutex>(perThreadCollisions[i].dataBlockade));
+	collisionPairs = static_cast<unsigned long>(candidatePairs.size());
+	if (candidatePairs.empty())
+		return;
 
-	for (auto &collisionData : perThreadCollisions)
+	collisionResults.assign(candidatePairs.size(), Collision(nullptr, nullptr));
+	jobSystem.parallelFor(candidatePairs.size(), 16, [this](std::size_t begin, std::size_t end)
 	{
-		for (auto &collision : collisionData.resultList)
+		for (std::size_t i = begin; i < end; i++)
 		{
-			// Notify all scripts of actor
-			for (auto &script : collision.first->getComponents<BehaviourScript>())
-				static_cast<BehaviourScript*>(script.lock().get())->onCollision(collision.second->getHandle());
-
-			// Notify all scripts of other
-			for (auto &script : collision.second->getComponents<BehaviourScript>())
-				static_cast<BehaviourScript*>(script.lock().get())->onCollision(collision.first->getHandle());
+			Collision whoCollided;
+			if (testTreeCollision(colliderTrees[candidatePairs[i].first], colliderTrees[candidatePairs[i].second], whoCollided))
+				collisionResults[i] = whoCollided;
 		}
+	});
+
+	for (auto &collision : collisionResults)
+	{
+		if (collision.first == nullptr)
+			continue;
+
+		// Notify all scripts of actor
+		for (std::size_t i = 0; i < collision.first->getScriptList().size(); i++)
+			collision.first->getScriptList()[i]->onCollision(collision.second->getHandle());
+
+		// Notify all scripts of other
+		for (std::size_t i = 0; i < collision.second->getScriptList().size(); i++)
+			collision.second->getScriptList()[i]->onCollision(collision.first->getHandle());
 	}
 }
 
@@ -1,7 +1,6 @@
 #ifndef GAME_H_
 #define GAME_H_
 #include <SFML/Graphics.hpp>
-#include <Windows.h>
 #include <functional>
 #include <chrono>
 #include <string>
@@ -11,6 +10,12 @@
 #include "Actor.h"
 #include "Collider.h"
 #include "BehaviourScript.h"
+#include "SpatialHashGrid.h"
+#include "ColliderStore.h"
+#include "JobSystem.h"
+#include "LaunchOptions.h"
+#include "TextureAtlas.h"
+#include "SpriteBatch.h"
 
 
 class Game
@@ -19,34 +24,62 @@ class Game
 		std::shared_ptr<Actor> actorRoot = Actor::createActor(std::weak_ptr<Actor>());
 		Game();
 
-		// Collision management
-		using Collision = std::pair<Actor*, Actor*>;
+		// Options the game is constructed with, a dedicated host runs headless
+		static LaunchOptions launchOptions;
+		bool running = true;
+
+		// Thread pool shared by the engine subsystems
+		JobSystem jobSystem;
+
+		// Loaded textures are packed together, so that sprites are drawn in batches
+		TextureAtlas textureAtlas;
+		SpriteBatch spriteBatch{ textureAtlas };
 
-		struct CollThreadData
+		// Top level actors whose transforms are propagated in parallel
+		std::vector<const Actor*> transformRoots;
+
+		// Fixed timestep - simulation time not consumed by ticks yet
+		double tickAccumulator = 0.0;
+
+		// Simulated transforms of the actors drawn at interpolated ones, restored after rendering
+		struct SimulatedTransform
 		{
-			CollThreadData();
-			CollThreadData(const CollThreadData &colThreadData);
+			Actor *actor;
+			sf::Vector2f position;
+			float rotation;
+		};
+		std::vector<SimulatedTransform> simulatedTransforms;
 
-			bool dataReady = false;
-			std::mutex dataBlockade;
-			std::condition_variable dataAvailability;
+		void interpolateTransforms();
+		void restoreTransforms();
 
-			std::list<Collision> resultList;
-			std::list<std::shared_ptr<Actor>>::const_iterator firstActor;
-			int actorsToTest;
+		// Collision management
+		using Collision = std::pair<Actor*, Actor*>;
+
+		// Colliders of a top level actor and its children, kept in [first, last) of the collider store
+		struct ColliderTree
+		{
+			Actor *actor;
+			std::size_t first;
+			std::size_t last;
+			bool fullyStored;		// false if some of the colliders can't be tested through the store
+			sf::FloatRect bounds;
 		};
 
-		std::mutex stopConditionBlocade;
-		bool stopCollisionThreads = false;
+		ColliderStore colliderStore;
+		std::vector<ColliderTree> colliderTrees;
 
-		std::vector<CollThreadData> perThreadCollisions;
-		std::vector<std::thread> threads;
+		// Broad phase - pairs of collider trees which may collide
+		SpatialHashGrid collisionGrid;
+		std::vector<std::pair<int, int>> candidatePairs;
+		std::vector<Collision> collisionResults;	// one slot per candidate pair, nullptr when no collision
 
-		void initCollision();
-		void perThreadTest(CollThreadData &collThreadData);
+		void refreshColliderStore();
+		void buildCollisionGrid();
+		bool testTreeCollision(const ColliderTree &a, const ColliderTree &b, Collision &whoCollided) const;
+		static bool testActorCollision(Actor &a, Actor &b, Collision &whoCollided);
 
 	public:
-		~Game();
 		using steady_clock = std::chrono::steady_clock;
 
 		//===== Globals
@@ -55,13 +88,28 @@ class Game
 		const unsigned int initialGameViewWidth;
 		const unsigned int initialGameViewHeight;
 
-		// Used to make the game flow independet from the CPU speed
+		// Used to make the game flow independet from the CPU speed. The simulation
+		// advances in ticks of fixedDeltaTime, deltaTime equals it during a tick.
 		sf::RenderWindow window;
 		steady_clock::time_point previousFrame;
 		double deltaTime = 0.0;
+		double frameTime = 0.0;							// real time between the last two frames
+		double fixedDeltaTime = 1.0 / 60.0;
+		unsigned int maxTicksPerFrame = 8;				// longer frames slow the game down instead of stalling it
+		unsigned long long tickCount = 0;
+		double tickDuration = 0.0;						// real time the last tick took
+		float renderAlpha = 0.0f;						// part of the next tick elapsed, used to interpolate drawing
+		float maxInterpolatedDistance = 1000.0f;		// longer moves within a tick are teleports (map wrapping)
 
 		// Game state
 		bool drawColliders = false;
+		unsigned long drawnSprites = 0;		// sprites of the last render, culled actors don't count
+		unsigned long queuedActors = 0;		// actors considered for them, what was drawn without culling
+		unsigned long drawCalls = 0;		// batches the sprites were drawn in
+		bool viewCulling = true;			// false draws all queued actors, kept to measure the culling
+		float collisionCellSize = 0.0f;		// broad phase cell size, 0 picks the largest collider radius rounded up to a power of two
+		bool collisionBroadPhase = true;	// false tests all pairs of actors, kept to measure the broad phase
+		unsigned long collisionPairs = 0;	// pairs of actor trees tested in the last tick
 
 		// Game resources
 
@@ -95,19 +143,33 @@ class Game
 		} textures;
 
 		static Game& get();
+		static void setLaunchOptions(const LaunchOptions &options);		// has to precede the first get()
+		const LaunchOptions& getLaunchOptions() const;
+		bool isHeadless() const;
+		bool isRunning() const;
+		void quit();
+
 		void loadTextures(sf::Texture &texture, const std::string &path);
 
 		void setView(const sf::Vector2f &center, unsigned int newWidth, unsigned int newHeight);
 		sf::View fitViewIn(const sf::View &view, float newWidth, float newHeight);
 
+		void advance(double frameTime);
+		void tick();
+		void render();
+
 		void update();
+		void updateTransforms();
 		void notifyScripts(void(BehaviourScript::*notifyMethod)(sf::Event event), sf::Event event);
 		void drawActors();
+		void drawActors(sf::RenderTarget &target);
 		void executeActorCoroutines();
 		void removeDestroyedActors();
 		void testCollisions();
 
 		std::weak_ptr<Actor> getRootActor();
+		std::weak_ptr<Actor> findActor(unsigned long id);
+		JobSystem& getJobSystem();
 };
 
 
@@ -1,7 +1,9 @@
 #include "GameController.h"
 #include "PlayerController.h"
 #include "ProjectileController.h"
+#include "InterpolationController.h"
 #include "Game.h"
+#include "Profiler.h"
 
 
 void GameController::consoleGetInput(std::vector<reponseHandler> responseHandlers)
@@ -48,7 +50,7 @@ void GameController::onHostGame(std::string response, bool &readyToStart)
 	{
 		printf("Gracz opuszcza poczekalnie.\n");
 	});
-	networkManager->startListening("2701");
+	networkManager->startListening(Game::get().getLaunchOptions().port);
 
 	std::vector<reponseHandler> hostGameMenu =
 	{
@@ -60,65 +62,115 @@ void GameController::onHostGame(std::string response, bool &readyToStart)
 	hostGameMenu[0].handler = [&](std::string response)
 	{
 		readyToStart = true;
+		startHostedGame();
+	};
+
+	// Cancel handler
+	hostGameMenu[1].handler = [&](std::string response)
+	{
+		networkManager->setOnDisconnect([&](unsigned long connectionId) {});
 		networkManager->stopListening();
-		auto connections = networkManager->getConnections();
+		networkManager->distonnectAll();
+	};
 
-		// Give each player an identifier
-		playerId = 1;
+	consoleGetInput(hostGameMenu);
+}
 
-		unsigned long i = playerId + 1;
-		for (auto &connectionId : connections)
-		{
-			otherPlayers.push_back({ connectionId, i++ });
-		}
 
-		// Send information about players to all clients (send client's player number as the last one
-		std::vector<char> buffer(sizeof(MessageHeader) + sizeof(unsigned long));
-		auto sendBuffer = [&](unsigned long connectionId, MessageHeader header, unsigned long playerId)
-		{
-			*reinterpret_cast<MessageHeader*>(buffer.data()) = header;
-			*reinterpret_cast<unsigned long*>(buffer.data() + sizeof(MessageHeader)) = playerId;
-			networkManager->send(connectionId, buffer.data(), sizeof(MessageHeader) + sizeof(unsigned long));
-		};
+// Closes the lobby, numbers the players and sends them their identifiers
+void GameController::startHostedGame()
+{
+	networkManager->stopListening();
+	auto connections = networkManager->getConnections();
 
-		for (auto &connectionId : connections)
-		{
-			// Send host player identifier
+	// Give each player an identifier
+	playerId = 1;
+
+	unsigned long i = playerId + 1;
+	for (auto &connectionId : connections)
+	{
+		otherPlayers.emplace_back(connectionId, i++);
+	}
+
+	// Send information about players to all clients (send client's player number as the last one
+	auto sendBuffer = [&](unsigned long connectionId, MessageHeader header, unsigned long playerId)
+	{
+		BitWriter message = beginMessage(header);
+		message.writeVarint(playerId);
+		message.flush();
+		networkManager->send(connectionId, messageBuffer.data(), messageBuffer.size());
+	};
+
+	for (auto &connectionId : connections)
+	{
+		// Send host player identifier, a dedicated host has no ship to play with
+		if (Game::get().isHeadless() == false)
 			sendBuffer(connectionId, MessageHeader::OTHER_PLAYER_ID, playerId);
 
-			// Send identifiers of players with id different to @connectionId
-			for (auto &player : otherPlayers)
-			{
-				if (player.connectionId != connectionId)
-					sendBuffer(connectionId, MessageHeader::OTHER_PLAYER_ID, player.playerId);
-			}
+		// Send identifiers of players with id different to @connectionId
+		for (auto &player : otherPlayers)
+		{
+			if (player.connectionId != connectionId)
+				sendBuffer(connectionId, MessageHeader::OTHER_PLAYER_ID, player.playerId);
+		}
 
-			// Send id of the client player as the last one
-			for (auto &player : otherPlayers)
+		// Send id of the client player as the last one
+		for (auto &player : otherPlayers)
+		{
+			if (player.connectionId == connectionId)
 			{
-				if (player.connectionId == connectionId)
-				{
-					sendBuffer(connectionId, MessageHeader::THIS_PLAYER_ID, player.playerId);
-					break;
-				}
+				sendBuffer(connectionId, MessageHeader::THIS_PLAYER_ID, player.playerId);
+				break;
 			}
 		}
+	}
 
-		networkManager->setOnDisconnect([&](unsigned long connectionId)
-		{
-			printf("Gracz opuszcza gre.\n");
-		});
-	};
+	networkManager->setOnDisconnect([&](unsigned long connectionId)
+	{
+		printf("Gracz opuszcza gre.\n");
+	});
+}
 
-	// Cancel handler
-	hostGameMenu[1].handler = [&](std::string response)
+
+// Dedicated host waits for the players given on the command line
+// and starts the game without the console menu
+void GameController::onDedicatedHost()
+{
+	const LaunchOptions &options = Game::get().getLaunchOptions();
+	host = true;
+	deltaCompression = options.fullSnapshots == false;
+
+	std::mutex lobbyBlockade;
+	std::condition_variable cv;
+	networkManager->setOnConnect([&](unsigned long)
 	{
-		networkManager->setOnDisconnect([&](unsigned long connectionId) {});
-		networkManager->stopListening();
-		networkManager->distonnectAll();
-	};
+		printf("Gracz dolacza do poczekalni.\n");
+		cv.notify_all();
+	});
+	networkManager->setOnDisconnect([&](unsigned long)
+	{
+		printf("Gracz opuszcza poczekalnie.\n");
+	});
 
-	consoleGetInput(hostGameMenu);
+	try
+	{
+		networkManager->startListening(options.port);
+	}
+	catch (std::exception &e)
+	{
+		printf("Nie udalo sie uruchomic serwera: %s\n", e.what());
+		std::exit(1);
+	}
+	printf("Serwer na porcie %s oczekuje na graczy: %u\n", options.port.c_str(), options.players);
+
+	// Callbacks may run under the network manager's lock, so the count is polled
+	std::unique_lock<std::mutex> lobbyLock(lobbyBlockade);
+	while (networkManager->getConnectionsCount() < options.players)
+		cv.wait_for(lobbyLock, std::chrono::milliseconds(100));
+	lobbyLock.unlock();
+
+	startHostedGame();
+	networkManager->setOnConnect(nullptr);
 }
 
 
@@ -153,20 +205,33 @@ void GameController::onJoinGame(std::string, bool &readyToStart)
 		otherPlayers.clear();
 		networkManager->setOnReceive([&](unsigned long connectionId, const char *data, int dataSize)
 		{
-			unsigned long receivedPlayerId = *reinterpret_cast<const unsigned long*>(data + sizeof(MessageHeader));
+			BitReader message(data, dataSize);
+			MessageHeader header = static_cast<MessageHeader>(message.readBits(8));
+
+			// The host creates the map and the ships right after sending the ids,
+			// they wait in the queue until the game starts
+			if (header != MessageHeader::THIS_PLAYER_ID && header != MessageHeader::OTHER_PLAYER_ID)
+			{
+				onReceiveData(connectionId, data, dataSize);
+				return;
+			}
+
+			unsigned long receivedPlayerId = static_cast<unsigned long>(message.readVarint());
+			if (message.hasFailed())
+				return;
 
-			if (*reinterpret_cast<const MessageHeader*>(data) == MessageHeader::THIS_PLAYER_ID)
+			if (header == MessageHeader::THIS_PLAYER_ID)
 			{
 				playerId = receivedPlayerId;
 				playerInfoReceived = true;
 				cv.notify_all();
 			}
-			else if (*reinterpret_cast<const MessageHeader*>(data) == MessageHeader::OTHER_PLAYER_ID)
+			else if (header == MessageHeader::OTHER_PLAYER_ID)
 			{
-				otherPlayers.push_back({ connectionId, receivedPlayerId });
+				otherPlayers.emplace_back(connectionId, receivedPlayerId);
 			}
 		});
-		networkManager->connectAsClient(server, "2701");
+		networkManager->connectAsClient(server, Game::get().getLaunchOptions().port);
 
 		// Waiting for the server to send information about players
 		std::unique_lock<std::mutex> infoLock(infoBlockade);
@@ -183,7 +248,11 @@ void GameController::onJoinGame(std::string, bool &readyToStart)
 
 		networkManager->setOnDisconnect([&](unsigned long connectionId)
 		{
+#ifdef _WIN32
 			MessageBoxA(0, "Utracono polaczenie z serwerem!", "Blad", MB_OK);
+#else
+			printf("Utracono polaczenie z serwerem!\n");
+#endif
 			std::exit(0);
 		});
 	}
@@ -197,26 +266,57 @@ void GameController::onJoinGame(std::string, bool &readyToStart)
 void GameController::onReceiveData(unsigned long connectionId, const char *data, int dataSize)
 {
 	if (networkDataQueue != nullptr)
-	{
-		std::unique_lock<std::mutex> queueLock(networkDataQueue->blockade);
+		networkDataQueue->push(connectionId, data, dataSize);
+}
 
-		std::vector<char> dataChunk(dataSize);
-		std::memcpy(dataChunk.data(), data, dataSize);
-		networkDataQueue->dataQueue.push({ std::move(dataChunk), connectionId });
-	}
+
+// Ships wrap around past the map edges, so positions get twice the map size
+StateQuantization GameController::createQuantization(float mapWidth, float mapHeight)
+{
+	StateQuantization quantization;
+	quantization.positionX = { -mapWidth, mapWidth, 18 };
+	quantization.positionY = { -mapHeight, mapHeight, 18 };
+	quantization.velocity = { -2048.0f, 2048.0f, 16 };
+	quantization.rotationBits = 12;
+	return quantization;
+}
+
+
+// Unreliable messages of one kind about one actor are ordered separately
+// from the others, so that a reordered update isn't dropped just because
+// an update of another actor overtook it
+std::uint32_t GameController::datagramStream(MessageHeader header, unsigned long actorId)
+{
+	return static_cast<std::uint32_t>(actorId) << 8 | static_cast<std::uint32_t>(header);
 }
 
 
 void GameController::start()
 {
-	mapWidth = 12000;
-	mapHeight = 12000;
+	mapWidth = defaultMapWidth;
+	mapHeight = defaultMapHeight;
 	minimapViewportScale = 0.35f;
+	quantization = createQuantization(mapWidth, mapHeight);
+	lobbyTick = Game::get().tickCount + 1;
+
+	const LaunchOptions &options = Game::get().getLaunchOptions();
+	logBandwidth = options.logBandwidth;
+	logPrediction = options.logPrediction;
+
+	// A benchmark builds its own scene, there is no one to play with
+	if (options.benchmark.empty() == false)
+		return;
 
 	if (networkManager == nullptr)
 		std::cerr << "Error: NetworkManager pointer set to nullptr" << std::endl;
 
 	bool readyToStart = false;
+	if (Game::get().isHeadless())
+	{
+		onDedicatedHost();
+		readyToStart = true;
+	}
+
 	while (readyToStart == false)
 	{
 		std::vector<reponseHandler> mainMenu =
@@ -248,14 +348,16 @@ void GameController::start()
 		// Create map and send the seed to all players
 		createMap(mapWidth, mapHeight, static_cast<unsigned int>(std::time(0)));
 
-		// Create a ship for all players
-		createPlayerShip(random(-mapWidth / 2, mapWidth / 2), random(-mapHeight / 2, mapHeight / 2), random(0, 360), playerId, "playerShip" + std::to_string(playerId));
+		// Create a ship for all players, a dedicated host doesn't play
+		if (Game::get().isHeadless() == false)
+			createPlayerShip(random(-mapWidth / 2, mapWidth / 2), random(-mapHeight / 2, mapHeight / 2), random(0, 360), playerId, "playerShip" + std::to_string(playerId));
 		for (auto &player : otherPlayers)
 		{
 			createPlayerShip(random(-mapWidth / 2, mapWidth / 2), random(-mapHeight / 2, mapHeight / 2), random(0, 360), player.playerId, "playerShip" + std::to_string(player.playerId));
 		}
 
 		// Run synchronization coroutine
+		hostClockStart = std::chrono::steady_clock::now();
 		coroutineMaster.startCoroutine(SynchronizationUpdate(this), "synchronizationCoroutine");
 	}
 
@@ -265,67 +367,123 @@ void GameController::start()
 
 void GameController::update()
 {
+	interpolationTime += Game::get().deltaTime;
+
 	if (networkDataQueue != nullptr)
 	{
-		std::unique_lock<std::mutex> queueLock(networkDataQueue->blockade);
+		PROFILE_SCOPE("GameController::handleMessages");
+		networkDataQueue->takeAll(receivedMessages);
+		receivedMessages.forEach([this](unsigned long connectionId, const char *data, std::size_t dataSize)
+		{
+			handleMessage(connectionId, data, dataSize);
+		});
+	}
 
-		// Perform operations based on message header received from client/server
-		while (networkDataQueue->dataQueue.empty() == false)
+	// Remove destroyed ships and projectiles from lists
+	playerShips.remove_if([](std::weak_ptr<Actor> &actor) { return actor.expired(); });
+	projectiles.remove_if([](std::weak_ptr<Actor> &actor) { return actor.expired(); });
+	for (auto ids = replicatedIds.begin(); ids != replicatedIds.end();)
+	{
+		auto actor = replicatedActors.find(ids->second);
+		if (actor == replicatedActors.end() || actor->second.expired())
 		{
-			auto item = networkDataQueue->dataQueue.front();
-			auto dataChunk = item.first;
-			networkDataQueue->dataQueue.pop();
+			if (actor != replicatedActors.end())
+				replicatedActors.erase(actor);
+			ids = replicatedIds.erase(ids);
+		}
+		else
+			++ids;
+	}
 
-			MessageHeader header = *reinterpret_cast<MessageHeader*>(dataChunk.data());
-			switch (header)
-			{
-				case MessageHeader::CREATE_MAP:
-					onCreateMap(std::move(dataChunk));
-					break;
+	// The tick which ran start() waited in the lobby, so it is left out
+	if (isHost() && Game::get().tickCount > lobbyTick)
+	{
+		double tickDuration = Game::get().tickDuration;
+		tickTimeSum += tickDuration;
+		tickTimeMax = std::max(tickTimeMax, tickDuration);
+		tickTimeCount++;
+		sendHostStats();
+	}
 
-				case MessageHeader::CREATE_PLAYER_SHIP:
-					onCreatePlayerShip(std::move(dataChunk));
-					break;
+	// A dedicated host ends when all players have left
+	if (host && Game::get().isHeadless() && networkManager->getConnectionsCount() == 0)
+	{
+		printf("Wszyscy gracze opuscili gre, zamykanie serwera.\n");
+		Game::get().quit();
+	}
+}
 
-				case MessageHeader::PLAYER_INPUT_EVENT:
-					onEvent(std::move(dataChunk));
-					break;
 
-				case MessageHeader::SET_ROTATION:
-					onSetRotation(std::move(dataChunk));
-					break;
+void GameController::onPostRender()
+{
+	drawMinimap();
+}
 
-				case MessageHeader::SET_POSITION:
-					onSetPosition(std::move(dataChunk));
-					break;
 
-				case MessageHeader::SET_VELOCITY:
-					onSetVelocity(std::move(dataChunk));
-					break;
+// Performs operations based on message header received from client/server
+void GameController::handleMessage(unsigned long connectionId, const char *data, std::size_t dataSize)
+{
+	BitReader message(data, dataSize);
+	MessageHeader header = static_cast<MessageHeader>(message.readBits(8));
+	if (message.hasFailed())
+		return;
 
-				case MessageHeader::DESTROY_ACTOR:
-					onDestroyActor(std::move(dataChunk));
-					break;
-			}
+	switch (header)
+	{
+		case MessageHeader::CREATE_MAP:
+			onCreateMap(message);
+			break;
 
-			queueLock.unlock();
-			if (isHost())
-			{
-				for (auto &player : otherPlayers)
-				{
-					if (player.connectionId != item.second)
-						networkManager->send(player.connectionId, dataChunk.data(), dataChunk.size());
-				}
-			}
-			queueLock.lock();
-		}
-	}
+		case MessageHeader::CREATE_PLAYER_SHIP:
+			onCreatePlayerShip(message);
+			break;
 
-	// Remove destroyed ships and projectiles from lists
-	playerShips.remove_if([](std::weak_ptr<Actor> &actor) { return actor.expired(); });
-	projectiles.remove_if([](std::weak_ptr<Actor> &actor) { return actor.expired(); });
+		case MessageHeader::PLAYER_INPUT_EVENT:
+			onEvent(message);
+			break;
 
-	drawMinimap();
+		case MessageHeader::SET_ROTATION:
+			onSetRotation(message);
+			break;
+
+		case MessageHeader::SET_POSITION:
+			onSetPosition(message);
+			break;
+
+		case MessageHeader::SET_VELOCITY:
+			onSetVelocity(message);
+			break;
+
+		case MessageHeader::DESTROY_ACTOR:
+			onDestroyActor(message);
+			break;
+
+		case MessageHeader::STATE_SNAPSHOT:
+			onStateSnapshot(message);
+			break;
+
+		case MessageHeader::SNAPSHOT_ACK:
+			onSnapshotAck(connectionId, message);
+			return;		// meant for the host only
+
+		case MessageHeader::HOST_STATS:
+			return;		// read by the load generator only
+
+		default:
+			return;		// player ids are only sent in the lobby, unknown headers aren't relayed
+	}
+
+	// Relay the message to the other clients. State updates are not relayed,
+	// they reach other clients in snapshots, filtered by relevance to each of them.
+	bool stateUpdate = header == MessageHeader::SET_ROTATION || header == MessageHeader::SET_POSITION || header == MessageHeader::SET_VELOCITY;
+	if (isHost() && stateUpdate == false)
+	{
+		for (auto &player : otherPlayers)
+		{
+			if (player.connectionId != connectionId)
+				networkManager->send(player.connectionId, data, dataSize);
+		}
+	}
 }
 
 
@@ -403,29 +561,55 @@ void GameController::drawMinimap()
 }
 
 
-void GameController::onCreateMap(std::vector<char> dataChunk)
+void GameController::onCreateMap(BitReader &message)
 {
-	unsigned int seed = *reinterpret_cast<unsigned int*>(dataChunk.data() + sizeof(MessageHeader));
-	createMap(mapWidth, mapHeight, seed);
+	unsigned int seed = message.readBits(32);
+	if (message.hasFailed() == false)
+		createMap(mapWidth, mapHeight, seed);
 }
 
 
-void GameController::onCreatePlayerShip(std::vector<char> dataChunk)
+void GameController::onCreatePlayerShip(BitReader &message)
 {
-	float x = *reinterpret_cast<float*>(dataChunk.data() + sizeof(MessageHeader));
-	float y = *reinterpret_cast<float*>(dataChunk.data() + sizeof(MessageHeader) + sizeof(float));
-	float angle = *reinterpret_cast<float*>(dataChunk.data() + sizeof(MessageHeader) + 2 * sizeof(float));
-	unsigned long id = *reinterpret_cast<unsigned long*>(dataChunk.data() + sizeof(MessageHeader) + 3 * sizeof(float));
-	std::string name(dataChunk.data() + sizeof(MessageHeader) + 3 * sizeof(float) + sizeof(unsigned long));
-
-	createPlayerShip(x, y, angle, id, name);
+	float x = message.readQuantized(quantization.positionX);
+	float y = message.readQuantized(quantization.positionY);
+	float angle = message.readAngle(quantization.rotationBits);
+	unsigned long id = static_cast<unsigned long>(message.readVarint());
+	std::string name = message.readString();
+	unsigned long actorId = static_cast<unsigned long>(message.readVarint());
+
+	if (message.hasFailed() == false)
+		registerReplicatedActor(actorId, createPlayerShip(x, y, angle, id, name));
 }
 
 
-void GameController::onEvent(std::vector<char> dataChunk)
+void GameController::onEvent(BitReader &message)
 {
-	sf::Event event = *reinterpret_cast<sf::Event*>(dataChunk.data() + sizeof(MessageHeader));
-	unsigned long eventPlayerId = *reinterpret_cast<unsigned long*>(dataChunk.data() + sizeof(MessageHeader) + sizeof(sf::Event));
+	sf::Event event;
+	event.type = message.readBool() ? sf::Event::KeyPressed : sf::Event::KeyReleased;
+	event.key.code = static_cast<sf::Keyboard::Key>(static_cast<int>(message.readBits(7)) + sf::Keyboard::Unknown);
+	event.key.alt = message.readBool();
+	event.key.control = message.readBool();
+	event.key.shift = message.readBool();
+	event.key.system = message.readBool();
+	unsigned long eventPlayerId = static_cast<unsigned long>(message.readVarint());
+	unsigned long eventSequence = static_cast<unsigned long>(message.readVarint());
+
+	if (message.hasFailed())
+		return;
+
+	// The host tells each client in snapshots which of its inputs were applied
+	if (isHost())
+	{
+		for (auto &player : otherPlayers)
+		{
+			if (player.playerId == eventPlayerId)
+			{
+				player.processedInput = eventSequence;
+				player.processedInputTime = std::chrono::steady_clock::now();
+			}
+		}
+	}
 
 	for (auto &ship : playerShips)
 	{
@@ -447,143 +631,227 @@ void GameController::onEvent(std::vector<char> dataChunk)
 }
 
 
-void GameController::onSetRotation(std::vector<char> dataChunk)
+void GameController::onSetRotation(BitReader &message)
 {
-	float rotation = *reinterpret_cast<float*>(dataChunk.data() + sizeof(MessageHeader));
-	unsigned long actorId = *reinterpret_cast<unsigned long*>(dataChunk.data() + sizeof(MessageHeader) + sizeof(float));
+	float rotation = message.readAngle(quantization.rotationBits);
+	unsigned long actorId = static_cast<unsigned long>(message.readVarint());
+	if (message.hasFailed())
+		return;
+
+	// Interpolated actors take their rotation from snapshots only
+	auto actor = findReplicatedActor(actorId);
+	if (actor && actor->getComponent<InterpolationController>().expired())
+		actor->setLocalRotation(rotation);
+}
 
-	for (auto &ship : playerShips)
-	{
-		auto shipLocked = ship.lock();
-		if (!shipLocked)
-			continue;
 
-		if (shipLocked->getId() == actorId)
-		{
-			shipLocked->setLocalRotation(rotation);
-			return;
-		}
-	}
+void GameController::onSetPosition(BitReader &message)
+{
+	sf::Vector2f position;
+	position.x = message.readQuantized(quantization.positionX);
+	position.y = message.readQuantized(quantization.positionY);
+	unsigned long actorId = static_cast<unsigned long>(message.readVarint());
+	if (message.hasFailed())
+		return;
+
+	auto actor = findReplicatedActor(actorId);
+	if (actor && actor->getComponent<InterpolationController>().expired())
+		actor->setLocalPosition(position);
+}
 
-	for (auto &projectile : projectiles)
-	{
-		auto projectileLocked = projectile.lock();
-		if (!projectileLocked)
-			continue;
 
-		if (projectileLocked->getId() == actorId)
-		{
-			projectileLocked->setLocalRotation(rotation);
-			break;
-		}
+void GameController::onSetVelocity(BitReader &message)
+{
+	sf::Vector2f velocity;
+	velocity.x = message.readQuantized(quantization.velocity);
+	velocity.y = message.readQuantized(quantization.velocity);
+	unsigned long actorId = static_cast<unsigned long>(message.readVarint());
+	if (message.hasFailed())
+		return;
+
+	auto actor = findReplicatedActor(actorId);
+	if (!actor)
+		return;
+
+	// Ships and projectiles keep their velocities in different scripts
+	auto component = actor->getComponent<PlayerController>().lock();
+	if (component)
+	{
+		static_cast<PlayerController*>(component.get())->velocity = velocity;
+		return;
 	}
+
+	component = actor->getComponent<ProjectileController>().lock();
+	if (component)
+		static_cast<ProjectileController*>(component.get())->velocity = velocity;
 }
 
 
-void GameController::onSetPosition(std::vector<char> dataChunk)
+void GameController::onDestroyActor(BitReader &message)
 {
-	sf::Vector2f position = *reinterpret_cast<sf::Vector2f*>(dataChunk.data() + sizeof(MessageHeader));
-	unsigned long actorId = *reinterpret_cast<unsigned long*>(dataChunk.data() + sizeof(MessageHeader) + sizeof(sf::Vector2f));
-
-	for (auto &ship : playerShips)
+	if (message.readBool() == false)
 	{
-		auto shipLocked = ship.lock();
-		if (!shipLocked)
-			continue;
-
-		if (shipLocked->getId() == actorId)
-		{
-			shipLocked->setLocalPosition(position);
-			return;
-		}
+		unsigned long actorId = static_cast<unsigned long>(message.readVarint());
+		auto actor = findReplicatedActor(actorId);
+		if (message.hasFailed() == false && actor)
+			actor->destroy();
+		return;
 	}
 
+	unsigned long projectilePlayerId = static_cast<unsigned long>(message.readVarint());
+	unsigned long shot = static_cast<unsigned long>(message.readVarint());
+	if (message.hasFailed())
+		return;
+
 	for (auto &projectile : projectiles)
 	{
 		auto projectileLocked = projectile.lock();
 		if (!projectileLocked)
 			continue;
 
-		if (projectileLocked->getId() == actorId)
+		auto component = projectileLocked->getComponent<ProjectileController>().lock();
+		auto projectileController = static_cast<ProjectileController*>(component.get());
+		if (projectileController != nullptr && projectileController->playerId == projectilePlayerId && projectileController->shot == shot)
 		{
-			projectileLocked->setLocalPosition(position);
+			projectileLocked->destroy();
 			break;
 		}
 	}
 }
 
 
-void GameController::onSetVelocity(std::vector<char> dataChunk)
+void GameController::onStateSnapshot(BitReader &message)
 {
-	sf::Vector2f velocity = *reinterpret_cast<sf::Vector2f*>(dataChunk.data() + sizeof(MessageHeader));
-	unsigned long actorId = *reinterpret_cast<unsigned long*>(dataChunk.data() + sizeof(MessageHeader) + sizeof(sf::Vector2f));
-
-	for (auto &ship : playerShips)
+	// Skip snapshots older than the last one applied
+	unsigned long sequence = 0;
+	unsigned long baselineSequence = 0;
+	if (SnapshotHistory::decodeSequences(message, sequence, baselineSequence) == false || sequence <= snapshotSequence)
+		return;
+
+	// Without its baseline the delta can't be rebuilt, it isn't acknowledged
+	// so that the host falls back to an older baseline or a full snapshot
+	const Snapshot *baseline = snapshotHistory.find(baselineSequence);
+	if (baselineSequence != 0 && baseline == nullptr)
+		return;
+
+	if (SnapshotHistory::decodeDelta(message, baseline, quantization, receivedSnapshot, changedStates) == false)
+		return;
+	receivedSnapshot.sequence = sequence;
+
+	unsigned long processedInput = static_cast<unsigned long>(message.readVarint());
+	float inputAge = message.readVarint() / 1000.0f;
+	double hostTime = message.readVarint() / 1000.0;
+	if (message.hasFailed())
+		return;
+
+	// States of actors unknown here are kept in the stored snapshot - the
+	// snapshot may come through UDP before CREATE_PLAYER_SHIP through TCP,
+	// and later deltas skip the actor as long as it doesn't change.
+	// They are only left out when the states are applied below.
+	snapshotSequence = sequence;
+	snapshotHistory.add(receivedSnapshot);
+	sendSnapshotAck(sequence);
+
+	adjustInterpolationClock(hostTime);
+
+	// Distant actors are sent rarely, so only the states present in the snapshot
+	// are applied - the others would give interpolation stale samples
+	for (auto &state : changedStates)
 	{
-		auto shipLocked = ship.lock();
-		if (!shipLocked)
+		auto actor = findReplicatedActor(state.actorId);
+		if (!actor)
 			continue;
 
-		if (shipLocked->getId() == actorId)
-		{
-			auto component = shipLocked->getComponent<PlayerController>().lock();
-			if (!component)
-				return;
+		// The player's own ship is predicted locally and reconciled below
+		auto component = actor->getComponent<PlayerController>().lock();
+		auto playerController = static_cast<PlayerController*>(component.get());
+		if (playerController != nullptr && playerController->playerId == playerId)
+			continue;
+		if (playerController != nullptr)
+			playerController->velocity = state.velocity;
 
-			auto playerController = static_cast<PlayerController*>(component.get());
-			playerController->velocity = velocity;
-			return;
+		component = actor->getComponent<InterpolationController>().lock();
+		if (component)
+		{
+			static_cast<InterpolationController*>(component.get())->addSample(hostTime, state.position, state.rotation);
+			continue;
 		}
+
+		actor->setLocalPosition(state.position);
+		if (playerController != nullptr)
+			actor->setLocalRotation(state.rotation);
 	}
 
-	for (auto &projectile : projectiles)
-	{
-		auto projectileLocked = projectile.lock();
-		if (!projectileLocked)
-			continue;
+	reconcilePlayerShip(processedInput, inputAge);
+}
 
-		if (projectileLocked->getId() == actorId)
-		{
-			auto component = projectileLocked->getComponent<PlayerController>().lock();
-			if (!component)
-				return;
 
-			auto projectileController = static_cast<ProjectileController*>(component.get());
-			projectileController->velocity = velocity;
-			break;
-		}
+// Keeps the interpolation time interpolationDelay behind the host time of the
+// newest snapshot. Small differences are corrected gradually, so that remote
+// actors don't jump because of a single late snapshot.
+void GameController::adjustInterpolationClock(double hostTime)
+{
+	double targetTime = hostTime - interpolationDelay;
+	if (interpolationClockSet == false || std::abs(targetTime - interpolationTime) > interpolationDelay)
+	{
+		interpolationTime = targetTime;
+		interpolationClockSet = true;
+		return;
 	}
+
+	interpolationTime += (targetTime - interpolationTime) * 0.1;
 }
 
 
-void GameController::onDestroyActor(std::vector<char> dataChunk)
+// Moves the player's ship to the state from the last snapshot and
+// simulates again the frames the host didn't take into account yet
+void GameController::reconcilePlayerShip(unsigned long processedInput, float inputAge)
 {
-	unsigned long actorId = *reinterpret_cast<unsigned long*>(dataChunk.data() + sizeof(MessageHeader));
-
 	for (auto &ship : playerShips)
 	{
 		auto shipLocked = ship.lock();
 		if (!shipLocked)
 			continue;
 
-		if (shipLocked->getId() == actorId)
-		{
-			shipLocked->destroy();
+		auto component = shipLocked->getComponent<PlayerController>().lock();
+		auto playerController = static_cast<PlayerController*>(component.get());
+		if (playerController == nullptr || playerController->playerId != playerId)
+			continue;
+
+		unsigned long actorId = 0;
+		const ActorState *state = findReplicatedId(shipLocked->getId(), actorId) ? receivedSnapshot.findState(actorId) : nullptr;
+		if (state == nullptr)
 			return;
-		}
+
+		correctionSum += playerController->reconcile(state->position, state->velocity, processedInput, inputAge);
+		correctionCount++;
+		break;
 	}
 
-	for (auto &projectile : projectiles)
+	// Inputs confirmed by this snapshot made a full round trip
+	auto now = std::chrono::steady_clock::now();
+	while (pendingInputs.empty() == false && pendingInputs.front().first <= processedInput)
 	{
-		auto projectileLocked = projectile.lock();
-		if (!projectileLocked)
-			continue;
+		inputLatencySum += std::chrono::duration<double>(now - pendingInputs.front().second).count();
+		inputLatencyCount++;
+		pendingInputs.pop_front();
+	}
 
-		if (projectileLocked->getId() == actorId)
-		{
-			projectileLocked->destroy();
-			break;
-		}
+	if (logPrediction)
+		reportPrediction();
+}
+
+
+void GameController::onSnapshotAck(unsigned long connectionId, BitReader &message)
+{
+	unsigned long sequence = static_cast<unsigned long>(message.readVarint());
+	if (message.hasFailed())
+		return;
+
+	for (auto &player : otherPlayers)
+	{
+		if (player.connectionId == connectionId && player.ackedSnapshot < sequence)
+			player.ackedSnapshot = sequence;
 	}
 }
 
@@ -666,10 +934,17 @@ std::shared_ptr<Actor> GameController::createPlayerShip(float x, float y, float
 	playerController->playerId = playerId;
 	playerController->hitPoints = 150;
 
+	// Ships of other players replicated from the host are interpolated between snapshots
+	if (host == false && playerId != this->playerId)
+	{
+		playerController->interpolated = true;
+		playerShip->addComponent<InterpolationController>();
+	}
+
 	playerShips.push_back(playerShip);
 	if (host)
 	{
-		sendCreatePlayerShip(x, y, rotation, playerId, name);
+		sendCreatePlayerShip(x, y, rotation, playerId, name, playerShip->getId());
 	}
 	return playerShip;
 }
@@ -696,13 +971,10 @@ std::shared_ptr<Actor> GameController::createProjectile(float x, float y, float
 	auto component = projectile->addComponent<ProjectileController>().lock();
 	auto projectileController = static_cast<ProjectileController*>(component.get());
 	projectileController->playerId = playerId;
+	projectileController->shot = ++shotsFired[playerId];
 	projectileController->damageDealt = 10;
 
 	projectiles.push_back(projectile);
-	if (host)
-	{
-		//sendCreatePlayerShip(x, y, rotation, playerId, name);
-	}
 	return projectile;
 }
 
@@ -726,9 +998,18 @@ void GameController::createMap(float width, float height, unsigned int seed)
 		newDecoration->setLocalPosition(sf::Vector2f(random(mapWidth) - mapWidth / 2, random(mapHeight) - mapHeight / 2));
 		newDecoration->setLocalScale(size);
 		newDecoration->setLocalRotation(random(360.0f));
+		newDecoration->setStatic(true);
 		return newDecoration;
 	};
 
+	// Decorations are only drawn, a dedicated host just passes the seed on
+	if (game.isHeadless())
+	{
+		std::srand(newSeed);
+		sendCreateMap(seed);
+		return;
+	}
+
 	// Generate random stars
 	for (int i = 0; i < 100; i++)
 	{
@@ -775,7 +1056,7 @@ void GameController::setNetworkManager(Network::NetworkManager *networkManager)
 }
 
 
-void GameController::setDataQueue(ThreadsafeDataQueue *networkDataQueue)
+void GameController::setDataQueue(MessageQueue *networkDataQueue)
 {
 	this->networkDataQueue = networkDataQueue;
 }
@@ -805,119 +1086,419 @@ unsigned long GameController::getPlayerId() const
 }
 
 
+unsigned long GameController::getInputSequence() const
+{
+	return inputSequence;
+}
+
+
+double GameController::getInterpolationTime() const
+{
+	return interpolationTime;
+}
+
+
 std::list<PlayerInfo> GameController::getPlayers() const
 {
 	return otherPlayers;
 }
 
 
-void GameController::sendCreateMap(unsigned int seed)
+// Client side: remembers the host id of an actor created on the host's
+// request. An actor created again for the same host id replaces the old one.
+void GameController::registerReplicatedActor(unsigned long actorId, const std::shared_ptr<Actor> &actor)
 {
-	if (networkManager != nullptr)
+	auto previous = replicatedActors.find(actorId);
+	if (previous != replicatedActors.end())
 	{
-		std::vector<char> dataChunk(sizeof(MessageHeader) + sizeof(unsigned int));
+		auto previousActor = previous->second.lock();
+		if (previousActor && previousActor != actor)
+			replicatedIds.erase(previousActor->getId());
+	}
+
+	auto previousId = replicatedIds.find(actor->getId());
+	if (previousId != replicatedIds.end() && previousId->second != actorId)
+		replicatedActors.erase(previousId->second);
+
+	replicatedActors[actorId] = actor;
+	replicatedIds[actor->getId()] = actorId;
+}
+
+
+// Finds the actor by its id on the host
+std::shared_ptr<Actor> GameController::findReplicatedActor(unsigned long actorId) const
+{
+	if (host)
+		return Game::get().findActor(actorId).lock();
 
-		*reinterpret_cast<MessageHeader*>(dataChunk.data()) = MessageHeader::CREATE_MAP;
-		memcpy(dataChunk.data() + sizeof(MessageHeader), &seed, sizeof(unsigned int));
+	auto actor = replicatedActors.find(actorId);
+	return actor != replicatedActors.end() ? actor->second.lock() : nullptr;
+}
 
-		networkManager->sendToAll(dataChunk.data(), dataChunk.size());
+
+// Puts the id of a local actor on the host into @actorId,
+// returns false if the actor isn't replicated
+bool GameController::findReplicatedId(unsigned long localId, unsigned long &actorId) const
+{
+	if (host)
+	{
+		actorId = localId;
+		return true;
 	}
+
+	auto ids = replicatedIds.find(localId);
+	if (ids == replicatedIds.end())
+		return false;
+
+	actorId = ids->second;
+	return true;
 }
 
 
-void GameController::sendCreatePlayerShip(float x, float y, float rotation, unsigned long playerId, std::string name)
+// Starts a new message in messageBuffer
+BitWriter GameController::beginMessage(MessageHeader header)
+{
+	messageBuffer.clear();
+
+	BitWriter message(messageBuffer);
+	message.writeBits(static_cast<std::uint32_t>(header), 8);
+	return message;
+}
+
+
+void GameController::sendCreateMap(unsigned int seed)
 {
 	if (networkManager != nullptr)
 	{
-		std::vector<char> dataChunk(sizeof(MessageHeader) + 3 * sizeof(float) + sizeof(unsigned long) + name.size() + 1);
+		BitWriter message = beginMessage(MessageHeader::CREATE_MAP);
+		message.writeBits(seed, 32);
+		message.flush();
+
+		networkManager->sendToAll(messageBuffer.data(), messageBuffer.size());
+	}
+}
 
-		*reinterpret_cast<MessageHeader*>(dataChunk.data()) = MessageHeader::CREATE_PLAYER_SHIP;
-		memcpy(dataChunk.data() + sizeof(MessageHeader), &x, sizeof(float));
-		memcpy(dataChunk.data() + sizeof(MessageHeader) + sizeof(float), &y, sizeof(float));
-		memcpy(dataChunk.data() + sizeof(MessageHeader) + 2 * sizeof(float), &rotation, sizeof(float));
-		memcpy(dataChunk.data() + sizeof(MessageHeader) + 3 * sizeof(float), &playerId, sizeof(unsigned long));
-		memcpy(dataChunk.data() + sizeof(MessageHeader) + 3 * sizeof(float) + sizeof(unsigned long), name.c_str(), name.size());
-		*reinterpret_cast<char*>(dataChunk.data() + sizeof(MessageHeader) + 3 * sizeof(float) + sizeof(unsigned long) + name.size()) = '\0';
 
-		networkManager->sendToAll(dataChunk.data(), dataChunk.size());
+void GameController::sendCreatePlayerShip(float x, float y, float rotation, unsigned long playerId, std::string name, unsigned long actorId)
+{
+	if (networkManager != nullptr)
+	{
+		BitWriter message = beginMessage(MessageHeader::CREATE_PLAYER_SHIP);
+		message.writeQuantized(x, quantization.positionX);
+		message.writeQuantized(y, quantization.positionY);
+		message.writeAngle(rotation, quantization.rotationBits);
+		message.writeVarint(playerId);
+		message.writeString(name);
+		message.writeVarint(actorId);
+		message.flush();
+
+		networkManager->sendToAll(messageBuffer.data(), messageBuffer.size());
 	}
 }
 
 
+// Only keyboard events are sent - the key code and modifiers are all the ships react to
 void GameController::sendEvent(sf::Event event)
 {
+	if (event.type != sf::Event::KeyPressed && event.type != sf::Event::KeyReleased)
+		return;
+
 	if (networkManager != nullptr)
 	{
-		std::vector<char> dataChunk(sizeof(MessageHeader) + sizeof(sf::Event) + sizeof(unsigned long));
-
-		*reinterpret_cast<MessageHeader*>(dataChunk.data()) = MessageHeader::PLAYER_INPUT_EVENT;
-		memcpy(dataChunk.data() + sizeof(MessageHeader), &event, sizeof(sf::Event));
-		memcpy(dataChunk.data() + sizeof(MessageHeader) + sizeof(sf::Event), &playerId, sizeof(unsigned long));
+		BitWriter message = beginMessage(MessageHeader::PLAYER_INPUT_EVENT);
+		message.writeBool(event.type == sf::Event::KeyPressed);
+		message.writeBits(static_cast<std::uint32_t>(event.key.code - sf::Keyboard::Unknown), 7);
+		message.writeBool(event.key.alt);
+		message.writeBool(event.key.control);
+		message.writeBool(event.key.shift);
+		message.writeBool(event.key.system);
+		message.writeVarint(playerId);
+		message.writeVarint(++inputSequence);
+		message.flush();
+
+		// Kept to measure how long the host takes to confirm the input
+		if (host == false)
+		{
+			pendingInputs.emplace_back(inputSequence, std::chrono::steady_clock::now());
+			if (pendingInputs.size() > 256)
+				pendingInputs.pop_front();
+		}
 
-		networkManager->sendToAll(dataChunk.data(), dataChunk.size());
+		networkManager->sendToAll(messageBuffer.data(), messageBuffer.size());
 	}
 }
 
 
 void GameController::sendSetRotation(float angle, unsigned long actorId)
 {
-	if (networkManager != nullptr)
+	// Actors the host doesn't know about have nothing to update
+	unsigned long replicatedId = 0;
+	if (networkManager != nullptr && findReplicatedId(actorId, replicatedId))
 	{
-		std::vector<char> dataChunk(sizeof(MessageHeader) + sizeof(float) + sizeof(unsigned long));
+		BitWriter message = beginMessage(MessageHeader::SET_ROTATION);
+		message.writeAngle(angle, quantization.rotationBits);
+		message.writeVarint(replicatedId);
+		message.flush();
 
-		*reinterpret_cast<MessageHeader*>(dataChunk.data()) = MessageHeader::SET_ROTATION;
-		memcpy(dataChunk.data() + sizeof(MessageHeader), &angle, sizeof(float));
-		memcpy(dataChunk.data() + sizeof(MessageHeader) + sizeof(float), &actorId, sizeof(unsigned long));
-
-		networkManager->sendToAll(dataChunk.data(), dataChunk.size());
+		networkManager->sendToAllUnreliable(messageBuffer.data(), messageBuffer.size(), datagramStream(MessageHeader::SET_ROTATION, replicatedId));
 	}
 }
 
 
 void GameController::sendSetPosition(sf::Vector2f position, unsigned long actorId)
 {
-	if (networkManager != nullptr)
+	unsigned long replicatedId = 0;
+	if (networkManager != nullptr && findReplicatedId(actorId, replicatedId))
 	{
-		std::vector<char> dataChunk(sizeof(MessageHeader) + sizeof(sf::Vector2f) + sizeof(unsigned long));
-
-		*reinterpret_cast<MessageHeader*>(dataChunk.data()) = MessageHeader::SET_POSITION;
-		memcpy(dataChunk.data() + sizeof(MessageHeader), &position, sizeof(sf::Vector2f));
-		memcpy(dataChunk.data() + sizeof(MessageHeader) + sizeof(sf::Vector2f), &actorId, sizeof(unsigned long));
+		BitWriter message = beginMessage(MessageHeader::SET_POSITION);
+		message.writeQuantized(position.x, quantization.positionX);
+		message.writeQuantized(position.y, quantization.positionY);
+		message.writeVarint(replicatedId);
+		message.flush();
 
-		networkManager->sendToAll(dataChunk.data(), dataChunk.size());
+		networkManager->sendToAllUnreliable(messageBuffer.data(), messageBuffer.size(), datagramStream(MessageHeader::SET_POSITION, replicatedId));
 	}
 }
 
 
 void GameController::sendSetVelocity(sf::Vector2f velocity, unsigned long actorId)
+{
+	unsigned long replicatedId = 0;
+	if (networkManager != nullptr && findReplicatedId(actorId, replicatedId))
+	{
+		BitWriter message = beginMessage(MessageHeader::SET_VELOCITY);
+		message.writeQuantized(velocity.x, quantization.velocity);
+		message.writeQuantized(velocity.y, quantization.velocity);
+		message.writeVarint(replicatedId);
+		message.flush();
+
+		networkManager->sendToAllUnreliable(messageBuffer.data(), messageBuffer.size(), datagramStream(MessageHeader::SET_VELOCITY, replicatedId));
+	}
+}
+
+
+void GameController::sendDestroyActor(unsigned long actorId)
 {
 	if (networkManager != nullptr)
 	{
-		std::vector<char> dataChunk(sizeof(MessageHeader) + sizeof(sf::Vector2f) + sizeof(unsigned long));
+		auto actor = Game::get().findActor(actorId).lock();
+		auto component = actor ? actor->getComponent<ProjectileController>().lock() : nullptr;
+		auto projectileController = static_cast<ProjectileController*>(component.get());
+
+		// Actors the host doesn't know about have nothing to destroy
+		unsigned long replicatedId = 0;
+		if (projectileController == nullptr && findReplicatedId(actorId, replicatedId) == false)
+			return;
 
-		*reinterpret_cast<MessageHeader*>(dataChunk.data()) = MessageHeader::SET_VELOCITY;
-		memcpy(dataChunk.data() + sizeof(MessageHeader), &velocity, sizeof(sf::Vector2f));
-		memcpy(dataChunk.data() + sizeof(MessageHeader) + sizeof(sf::Vector2f), &actorId, sizeof(unsigned long));
+		BitWriter message = beginMessage(MessageHeader::DESTROY_ACTOR);
+		message.writeBool(projectileController != nullptr);
+		if (projectileController != nullptr)
+		{
+			message.writeVarint(projectileController->playerId);
+			message.writeVarint(projectileController->shot);
+		}
+		else
+			message.writeVarint(replicatedId);
+		message.flush();
 
-		networkManager->sendToAll(dataChunk.data(), dataChunk.size());
+		networkManager->sendToAll(messageBuffer.data(), messageBuffer.size());
 	}
 }
 
 
-void GameController::sendDestroyActor(unsigned long actorId)
+// Sends the state of ships to each client as a single message, encoded
+// against the last snapshot the client acknowledged (or whole without
+// deltaCompression). A lost snapshot is covered by the next one, so they
+// go through the unreliable channel.
+//
+// Ships within the view of the client's ship are sent every time, distant
+// ones only every distantUpdateInterval snapshots - in between their states
+// from the baseline are repeated, so the delta skips them. Ships missing
+// from the baseline are always sent.
+void GameController::sendStateSnapshot()
+{
+	PROFILE_SCOPE("GameController::sendStateSnapshot");
+	if (networkManager == nullptr)
+		return;
+
+	Snapshot snapshot;
+	snapshot.sequence = ++snapshotSequence;
+
+	for (auto &ship : playerShips)
+	{
+		auto shipLocked = ship.lock();
+		if (!shipLocked)
+			continue;
+
+		ActorState state;
+		state.actorId = shipLocked->getId();
+		state.position = shipLocked->getLocalPosition();
+		state.rotation = shipLocked->getLocalRotation();
+		state.velocity = sf::Vector2f();
+
+		auto component = shipLocked->getComponent<PlayerController>().lock();
+		if (component)
+			state.velocity = static_cast<PlayerController*>(component.get())->velocity;
+
+		snapshot.states.push_back(state);
+	}
+	std::sort(snapshot.states.begin(), snapshot.states.end(), [](const ActorState &a, const ActorState &b) { return a.actorId < b.actorId; });
+
+	auto now = std::chrono::steady_clock::now();
+	Snapshot view;
+	view.sequence = snapshot.sequence;
+	for (auto &player : otherPlayers)
+	{
+		const Snapshot *baseline = deltaCompression ? player.sentSnapshots.find(player.ackedSnapshot) : nullptr;
+		sf::Vector2f viewerPosition;
+		bool hasViewer = getShipPosition(player.playerId, viewerPosition);
+		bool distantUpdate = (snapshot.sequence + player.playerId) % distantUpdateInterval == 0;
+
+		view.states.clear();
+		for (auto &state : snapshot.states)
+		{
+			if (distantUpdate || hasViewer == false || isRelevant(viewerPosition, state.position))
+			{
+				view.states.push_back(state);
+				continue;
+			}
+
+			// A ship the client doesn't have yet is sent at once, not on the next distant update
+			const ActorState *base = baseline != nullptr ? baseline->findState(state.actorId) : nullptr;
+			view.states.push_back(base != nullptr ? *base : state);
+		}
+
+		BitWriter message = beginMessage(MessageHeader::STATE_SNAPSHOT);
+		SnapshotHistory::encodeDelta(view, baseline, quantization, message);
+		player.sentSnapshots.add(view);
+
+		// Last input of the player applied so far and how many milliseconds ago
+		auto inputAge = now - player.processedInputTime;
+		message.writeVarint(player.processedInput);
+		message.writeVarint(player.processedInput != 0 ? std::chrono::duration_cast<std::chrono::milliseconds>(inputAge).count() : 0);
+
+		// Host clock in milliseconds, remote actors are interpolated along it
+		message.writeVarint(std::chrono::duration_cast<std::chrono::milliseconds>(now - hostClockStart).count());
+		message.flush();
+
+		networkManager->sendUnreliable(player.connectionId, messageBuffer.data(), messageBuffer.size(), datagramStream(MessageHeader::STATE_SNAPSHOT));
+	}
+
+	if (logBandwidth)
+		reportBandwidth();
+}
+
+
+void GameController::sendSnapshotAck(unsigned long sequence)
 {
 	if (networkManager != nullptr)
 	{
-		std::vector<char> dataChunk(sizeof(MessageHeader) + sizeof(unsigned long));
+		BitWriter message = beginMessage(MessageHeader::SNAPSHOT_ACK);
+		message.writeVarint(sequence);
+		message.flush();
+
+		networkManager->sendToAllUnreliable(messageBuffer.data(), messageBuffer.size(), datagramStream(MessageHeader::SNAPSHOT_ACK));
+	}
+}
+
+
+// Tells the clients how long the host's ticks take, once a second
+void GameController::sendHostStats()
+{
+	auto now = std::chrono::steady_clock::now();
+	if (now - hostStatsTime < std::chrono::seconds(1) || networkManager == nullptr || tickTimeCount == 0)
+		return;
+	hostStatsTime = now;
+
+	BitWriter message = beginMessage(MessageHeader::HOST_STATS);
+	message.writeVarint(static_cast<std::uint64_t>(tickTimeSum / tickTimeCount * 1e6));
+	message.writeVarint(static_cast<std::uint64_t>(tickTimeMax * 1e6));
+	message.writeVarint(tickTimeCount);
+	message.writeVarint(networkManager->getConnectionsCount());
+	message.flush();
+	networkManager->sendToAll(messageBuffer.data(), messageBuffer.size());
+
+	tickTimeSum = 0.0;
+	tickTimeMax = 0.0;
+	tickTimeCount = 0;
+}
+
 
-		*reinterpret_cast<MessageHeader*>(dataChunk.data()) = MessageHeader::DESTROY_ACTOR;
-		memcpy(dataChunk.data() + sizeof(MessageHeader), &actorId, sizeof(unsigned long));
+// Prints bytes sent to and received from each client since the previous report
+void GameController::reportBandwidth()
+{
+	auto now = std::chrono::steady_clock::now();
+	double elapsed = std::chrono::duration<double>(now - bandwidthReportTime).count();
+	if (elapsed < 1.0)
+		return;
+	bandwidthReportTime = now;
+
+	for (auto &player : otherPlayers)
+	{
+		Network::NetworkManager::ConnectionStats stats;
+		if (networkManager->getConnectionStats(player.connectionId, stats) == false)
+			continue;
 
-		networkManager->sendToAll(dataChunk.data(), dataChunk.size());
+		auto &previous = reportedStats[player.connectionId];
+		printf("Gracz %lu: wysylane %.0f B/s, odbierane %.0f B/s\n", player.playerId,
+			(stats.bytesSent - previous.bytesSent) / elapsed, (stats.bytesReceived - previous.bytesReceived) / elapsed);
+		previous = stats;
 	}
 }
 
 
+// Finds the ship of the player, returns false if the player has none
+bool GameController::getShipPosition(unsigned long playerId, sf::Vector2f &position) const
+{
+	for (auto &ship : playerShips)
+	{
+		auto shipLocked = ship.lock();
+		if (!shipLocked)
+			continue;
+
+		auto component = shipLocked->getComponent<PlayerController>().lock();
+		if (component && static_cast<PlayerController*>(component.get())->playerId == playerId)
+		{
+			position = shipLocked->getLocalPosition();
+			return true;
+		}
+	}
+
+	return false;
+}
+
+
+// Tells if the position is within the game view centered at the viewer, extended by relevanceMargin
+bool GameController::isRelevant(sf::Vector2f viewerPosition, sf::Vector2f position) const
+{
+	Game &game = Game::get();
+	float rangeX = game.initialGameViewWidth / 2.0f + relevanceMargin;
+	float rangeY = game.initialGameViewHeight / 2.0f + relevanceMargin;
+
+	return std::abs(position.x - viewerPosition.x) <= rangeX && std::abs(position.y - viewerPosition.y) <= rangeY;
+}
+
+
+// Prints the average time until the host confirms an input and the average
+// distance the player's ship is moved by on reconciliation
+void GameController::reportPrediction()
+{
+	auto now = std::chrono::steady_clock::now();
+	if (now - predictionReportTime < std::chrono::seconds(1))
+		return;
+	predictionReportTime = now;
+
+	printf("Potwierdzenie wejscia: %.1f ms, korekta pozycji: %.2f px\n",
+		inputLatencyCount > 0 ? inputLatencySum / inputLatencyCount * 1000.0 : 0.0,
+		correctionCount > 0 ? correctionSum / correctionCount : 0.0f);
+
+	inputLatencySum = 0.0;
+	inputLatencyCount = 0;
+	correctionSum = 0.0f;
+	correctionCount = 0;
+}
+
+
 GameController::SynchronizationUpdate::SynchronizationUpdate(GameController *controller)
 	: controller(controller)
 {}
@@ -928,24 +1509,8 @@ std::unique_ptr<CoroutineResultType> GameController::SynchronizationUpdate::oper
 	coroutineBegin();
 	while (true)
 	{
-		//printf("Co 20 milisekund\n");
-		for (auto &ship : controller->playerShips)
-		{
-			auto shipLocked = ship.lock();
-			if (!shipLocked)
-				continue;
-
-			controller->sendSetPosition(shipLocked->getLocalPosition(), shipLocked->getId());
-			controller->sendSetRotation(shipLocked->getLocalRotation(), shipLocked->getId());
-
-			auto component = shipLocked->getComponent<PlayerController>().lock();
-			if (!component)
-				continue;
-
-			auto playerController = static_cast<PlayerController*>(component.get());
-			controller->sendSetVelocity(playerController->velocity, shipLocked->getId());
-		}
-		yieldReturn(mkUniq(WaitForSeconds(0.020)));
+		controller->sendStateSnapshot();
+		yieldReturn(mkUniq(WaitForSeconds(controller->synchronizationInterval)));
 	}
 	coroutineEnd(mkUniq(CoroutineFinished()));
 }
\ No newline at end of file
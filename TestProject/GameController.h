@@ -2,21 +2,28 @@
 #define GAME_CONTROLLER_H_
 #include <SFML/Window/Mouse.hpp>
 #include <regex>
+#include <chrono>
+#include <unordered_map>
+#include <deque>
+#include <algorithm>
 #include "BehaviourScript.h"
 #include "CircleCollider.h"
 #include "Actor.h"
 #include "NetworkManager.h"
 #include "PlayerInfo.h"
 #include "MessageHeader.h"
-#include "ThreadsafeDataQueue.h"
+#include "MessageQueue.h"
+#include "StateSnapshot.h"
+#include "BitStream.h"
 
 
-class GameController : public BehaviourScript
+class GameController final : public BehaviourScript
 {
 	CLONEABLE_COMPONENT();
 
 	Network::NetworkManager *networkManager;
-	ThreadsafeDataQueue *networkDataQueue;
+	MessageQueue *networkDataQueue;
+	MessageQueue::Batch receivedMessages;		// messages taken from networkDataQueue in the current frame
 	std::list<PlayerInfo> otherPlayers;
 	unsigned long playerId;
 	bool host = false;
@@ -27,6 +34,65 @@ class GameController : public BehaviourScript
 	std::list<std::weak_ptr<Actor>> playerShips;
 	std::list<std::weak_ptr<Actor>> projectiles;
 
+	// Actors are sent by their ids on the host. Clients create them on their
+	// own, so they keep the host ids of the replicated ones. Projectiles are
+	// never announced, every peer fires them from the same input events,
+	// so they are told apart by the player and the number of the shot.
+	std::unordered_map<unsigned long, std::weak_ptr<Actor>> replicatedActors;	// by host id
+	std::unordered_map<unsigned long, unsigned long> replicatedIds;			// host id by local id
+	std::unordered_map<unsigned long, unsigned long> shotsFired;				// by player id
+	void registerReplicatedActor(unsigned long actorId, const std::shared_ptr<Actor> &actor);
+	std::shared_ptr<Actor> findReplicatedActor(unsigned long actorId) const;
+	bool findReplicatedId(unsigned long localId, unsigned long &actorId) const;
+
+	// Wire encoding - all messages are bit packed into messageBuffer
+	StateQuantization quantization;
+	std::vector<char> messageBuffer;
+	BitWriter beginMessage(MessageHeader header);
+
+	// State replication - the host keeps snapshots it sent in PlayerInfo, clients the ones they received
+	SnapshotHistory snapshotHistory;
+	unsigned long snapshotSequence = 0;		// last sent or received snapshot
+	Snapshot receivedSnapshot;
+	std::vector<ActorState> changedStates;
+
+	// Remote actors are shown interpolationDelay behind the newest snapshot,
+	// interpolationTime follows the host clock, which the host sends in snapshots
+	std::chrono::steady_clock::time_point hostClockStart;
+	double interpolationTime = 0.0;
+	bool interpolationClockSet = false;
+	void adjustInterpolationClock(double hostTime);
+
+	// Client side prediction - inputs are numbered, snapshots tell which one the host applied last
+	unsigned long inputSequence = 0;
+	std::deque<std::pair<unsigned long, std::chrono::steady_clock::time_point>> pendingInputs;
+	void reconcilePlayerShip(unsigned long processedInput, float inputAge);
+
+	// Area of interest
+	bool getShipPosition(unsigned long playerId, sf::Vector2f &position) const;
+	bool isRelevant(sf::Vector2f viewerPosition, sf::Vector2f position) const;
+
+	// Prediction measurement
+	std::chrono::steady_clock::time_point predictionReportTime;
+	double inputLatencySum = 0.0;
+	unsigned long inputLatencyCount = 0;
+	float correctionSum = 0.0f;
+	unsigned long correctionCount = 0;
+	void reportPrediction();
+
+	// Host tick time, sent to clients in HOST_STATS
+	unsigned long long lobbyTick = 0;		// tick running start(), its duration includes the lobby
+	std::chrono::steady_clock::time_point hostStatsTime;
+	double tickTimeSum = 0.0;
+	double tickTimeMax = 0.0;
+	unsigned long tickTimeCount = 0;
+	void sendHostStats();
+
+	// Bandwidth measurement
+	std::chrono::steady_clock::time_point bandwidthReportTime;
+	std::unordered_map<unsigned long, Network::NetworkManager::ConnectionStats> reportedStats;
+	void reportBandwidth();
+
 	struct reponseHandler
 	{
 		std::string choice;
@@ -35,46 +101,71 @@ class GameController : public BehaviourScript
 	};
 	void consoleGetInput(std::vector<reponseHandler> responseHandlers);
 	void onHostGame(std::string response, bool &readyToStart);
+	void onDedicatedHost();
+	void startHostedGame();
 	void onJoinGame(std::string response, bool &readyToStart);
 	void onReceiveData(unsigned long connectionId, const char *data, int dataSize);
 
 	void start() override;
 	void update() override;
+	void onPostRender() override;
 	void onKeyboardEvent(sf::Event event) override;
 	void onMouseEvent(sf::Event event) override;
 	void drawMinimap();
-
-	void onCreateMap(std::vector<char> dataChunk);
-	void onCreatePlayerShip(std::vector<char> dataChunk);
-	void onEvent(std::vector<char> dataChunk);
-	void onSetRotation(std::vector<char> dataChunk);
-	void onSetPosition(std::vector<char> dataChunk);
-	void onSetVelocity(std::vector<char> dataChunk);
-	void onDestroyActor(std::vector<char> dataChunk);
+	void handleMessage(unsigned long connectionId, const char *data, std::size_t dataSize);
+
+	void onCreateMap(BitReader &message);
+	void onCreatePlayerShip(BitReader &message);
+	void onEvent(BitReader &message);
+	void onSetRotation(BitReader &message);
+	void onSetPosition(BitReader &message);
+	void onSetVelocity(BitReader &message);
+	void onDestroyActor(BitReader &message);
+	void onStateSnapshot(BitReader &message);
+	void onSnapshotAck(unsigned long connectionId, BitReader &message);
 
 	// Coroutines
 	class SynchronizationUpdate;
 
 	public:
+		static constexpr float defaultMapWidth = 12000.0f;
+		static constexpr float defaultMapHeight = 12000.0f;
+		static StateQuantization createQuantization(float mapWidth, float mapHeight);
+		static std::uint32_t datagramStream(MessageHeader header, unsigned long actorId = 0);
+
+		bool logBandwidth = false;		// host prints bytes per second of every client
+		bool deltaCompression = true;	// false sends whole snapshots, kept to measure the delta compression
+		bool logPrediction = false;		// client prints input round trip and prediction error
+
+		double synchronizationInterval = 0.040;		// seconds between state snapshots
+		double interpolationDelay = 0.100;			// should cover two snapshots and their jitter
+
+		float relevanceMargin = 1000.0f;				// added to the game view when choosing ships sent every time
+		unsigned long distantUpdateInterval = 10;		// snapshots between updates of the other ships
+
 		std::shared_ptr<Actor> createPlayerShip(float x, float y, float rotation, unsigned long playerId, std::string name);
 		std::shared_ptr<Actor> createProjectile(float x, float y, float rotation, unsigned long playerId, std::string name);
 		void createMap(float width, float height, unsigned int seed);
 
 		void setNetworkManager(Network::NetworkManager *networkManager);
-		void setDataQueue(ThreadsafeDataQueue *networkDataQueue);
+		void setDataQueue(MessageQueue *networkDataQueue);
 		float getMapWidth() const;
 		float getMapHeight() const;
 		bool isHost() const;
 		unsigned long getPlayerId() const;
+		unsigned long getInputSequence() const;
+		double getInterpolationTime() const;
 		std::list<PlayerInfo> getPlayers() const;
 
 		void sendCreateMap(unsigned int seed);
-		void sendCreatePlayerShip(float x, float y, float rotation, unsigned long playerId, std::string name);
+		void sendCreatePlayerShip(float x, float y, float rotation, unsigned long playerId, std::string name, unsigned long actorId);
 		void sendEvent(sf::Event event);
 		void sendSetRotation(float angle, unsigned long actorId);
 		void sendSetPosition(sf::Vector2f position, unsigned long actorId);
 		void sendSetVelocity(sf::Vector2f velocity, unsigned long actorId);
 		void sendDestroyActor(unsigned long actorId);
+		void sendStateSnapshot();
+		void sendSnapshotAck(unsigned long sequence);
 };
 
 
@@ -5,10 +5,13 @@
 class IDestructible
 {
 	public:
-		virtual ~IDestructible() = 0 {}
+		virtual ~IDestructible() = 0;
 		virtual bool isDestroyed() const = 0;
 		virtual void destroy() = 0;
 };
 
 
+inline IDestructible::~IDestructible() {}
+
+
 #endif
\ No newline at end of file
@@ -0,0 +1,67 @@
+#include "InterpolationController.h"
+#include "GameController.h"
+#include "Game.h"
+
+
+void InterpolationController::awake()
+{
+	gameController = Game::get().getRootActor().lock()->getChild("gameActor").lock()->getComponent<GameController>();
+}
+
+
+void InterpolationController::update()
+{
+	if (count == 0)
+		return;
+
+	auto ownerActor = getOwnerActor().lock();
+	auto controller = static_cast<GameController*>(gameController.lock().get());
+	double renderTime = controller->getInterpolationTime();
+
+	// Find the newest sample not later than the rendered moment
+	std::size_t age = 0;
+	while (age < count && getSample(age).time > renderTime)
+		age++;
+
+	// Past the newest sample or before the oldest one the actor stays in place
+	if (age == 0 || age == count)
+	{
+		const Sample &sample = getSample(age == 0 ? 0 : count - 1);
+		ownerActor->setLocalPosition(sample.position);
+		ownerActor->setLocalRotation(sample.rotation);
+		return;
+	}
+
+	const Sample &from = getSample(age);
+	const Sample &to = getSample(age - 1);
+	if (Tools::length(to.position - from.position) > teleportDistance)
+	{
+		ownerActor->setLocalPosition(to.position);
+		ownerActor->setLocalRotation(to.rotation);
+		return;
+	}
+
+	float t = static_cast<float>((renderTime - from.time) / (to.time - from.time));
+	ownerActor->setLocalPosition(from.position + (to.position - from.position) * t);
+	ownerActor->setLocalRotation(Tools::lerpAngle(from.rotation, to.rotation, t));
+}
+
+
+// Age 0 is the newest sample
+const InterpolationController::Sample& InterpolationController::getSample(std::size_t age) const
+{
+	return samples[(newest + capacity - age) % capacity];
+}
+
+
+// Samples have to come in order, older ones are ignored
+void InterpolationController::addSample(double time, sf::Vector2f position, float rotation)
+{
+	if (count > 0 && time <= getSample(0).time)
+		return;
+
+	newest = (newest + 1) % capacity;
+	samples[newest] = { time, position, rotation };
+	if (count < capacity)
+		count++;
+}
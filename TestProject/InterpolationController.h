@@ -0,0 +1,45 @@
+#ifndef INTERPOLATION_CONTROLLER_H_
+#define INTERPOLATION_CONTROLLER_H_
+#include <SFML/System/Vector2.hpp>
+#include "BehaviourScript.h"
+#include "Actor.h"
+
+
+// Moves a remote actor along the states received in snapshots. The actor is
+// shown GameController::interpolationDelay seconds in the past, between the
+// two snapshots surrounding that moment, so late or uneven updates don't
+// make it jitter.
+class InterpolationController final : public BehaviourScript
+{
+	CLONEABLE_COMPONENT();
+
+	// Handle to game controller
+	std::weak_ptr<Component> gameController;
+
+	struct Sample
+	{
+		double time;		// host time of the snapshot
+		sf::Vector2f position;
+		float rotation;
+	};
+
+	// Ring buffer of the newest samples
+	static const std::size_t capacity = 32;
+	Sample samples[capacity];
+	std::size_t newest = 0;
+	std::size_t count = 0;
+
+	const Sample& getSample(std::size_t age) const;
+
+	void awake() override;
+	void update() override;
+
+	public:
+		// Samples further apart are not interpolated - ships jump when wrapping around the map edges
+		float teleportDistance = 1000.0f;
+
+		void addSample(double time, sf::Vector2f position, float rotation);
+};
+
+
+#endif
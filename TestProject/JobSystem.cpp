@@ -0,0 +1,189 @@
+#include <algorithm>
+#include "JobSystem.h"
+
+
+thread_local int JobSystem::workerIndex = -1;
+
+
+bool JobSystem::Counter::isDone() const
+{
+	return jobsLeft.load(std::memory_order_acquire) == 0;
+}
+
+
+void JobSystem::workerTask(int index)
+{
+	workerIndex = index;
+
+	std::pair<Job, Counter*> job;
+	while (true)
+	{
+		if (popJob(index, job) || stealJob(index, job))
+		{
+			runJob(job);
+			continue;
+		}
+
+		// Sleep until there is some work to do
+		std::unique_lock<std::mutex> sleepLock(sleepBlockade);
+		while (stopWorkers == false && queuedJobs.load() == 0)
+			jobAvailability.wait(sleepLock);
+
+		if (stopWorkers)
+			return;
+	}
+}
+
+
+// Takes the most recently pushed job from the owned queue
+bool JobSystem::popJob(int index, std::pair<Job, Counter*> &job)
+{
+	WorkerQueue &queue = *queues[index];
+	std::unique_lock<std::mutex> queueLock(queue.blockade);
+	if (queue.jobs.empty())
+		return false;
+
+	job = std::move(queue.jobs.back());
+	queue.jobs.pop_back();
+	queuedJobs--;
+	return true;
+}
+
+
+// Takes the oldest job from any other queue
+bool JobSystem::stealJob(int thiefIndex, std::pair<Job, Counter*> &job)
+{
+	int queuesCount = static_cast<int>(queues.size());
+	for (int i = 1; i < queuesCount; i++)
+	{
+		WorkerQueue &queue = *queues[(thiefIndex + i) % queuesCount];
+		std::unique_lock<std::mutex> queueLock(queue.blockade);
+		if (queue.jobs.empty())
+			continue;
+
+		job = std::move(queue.jobs.front());
+		queue.jobs.pop_front();
+		queuedJobs--;
+		return true;
+	}
+	return false;
+}
+
+
+void JobSystem::runJob(std::pair<Job, Counter*> &job)
+{
+	job.first();
+	job.first = nullptr;
+	job.second->jobsLeft.fetch_sub(1, std::memory_order_release);
+}
+
+
+void JobSystem::wakeWorkers()
+{
+	// Taking the lock guarantees that no worker is between
+	// checking the queued jobs count and falling asleep
+	std::unique_lock<std::mutex> sleepLock(sleepBlockade);
+	sleepLock.unlock();
+	jobAvailability.notify_all();
+}
+
+
+JobSystem::JobSystem(unsigned int threadsCount)
+{
+	if (threadsCount == 0)
+		threadsCount = std::thread::hardware_concurrency();
+	if (threadsCount == 0)
+		threadsCount = 2;
+
+	for (unsigned int i = 0; i < threadsCount + 1; i++)
+		queues.push_back(std::make_unique<WorkerQueue>());
+
+	workers.reserve(threadsCount);
+	for (unsigned int i = 0; i < threadsCount; i++)
+		workers.push_back(std::thread(&JobSystem::workerTask, this, static_cast<int>(i)));
+}
+
+
+JobSystem::~JobSystem()
+{
+	std::unique_lock<std::mutex> sleepLock(sleepBlockade);
+	stopWorkers = true;
+	sleepLock.unlock();
+	jobAvailability.notify_all();
+
+	for (auto &worker : workers)
+		worker.join();
+}
+
+
+std::size_t JobSystem::getWorkersCount() const
+{
+	return workers.size();
+}
+
+
+// Pushes the job to the queue of the calling thread (or the
+// shared queue if the caller doesn't belong to the pool)
+void JobSystem::submit(Job job, Counter &counter)
+{
+	int index = workerIndex >= 0 ? workerIndex : static_cast<int>(queues.size()) - 1;
+	counter.jobsLeft++;
+
+	std::unique_lock<std::mutex> queueLock(queues[index]->blockade);
+	queues[index]->jobs.push_back({ std::move(job), &counter });
+	queuedJobs++;
+	queueLock.unlock();
+
+	wakeWorkers();
+}
+
+
+// Executes queued jobs until all jobs tracked by the counter finish
+void JobSystem::wait(Counter &counter)
+{
+	int index = workerIndex >= 0 ? workerIndex : static_cast<int>(queues.size()) - 1;
+
+	std::pair<Job, Counter*> job;
+	while (counter.isDone() == false)
+	{
+		if (popJob(index, job) || stealJob(index, job))
+			runJob(job);
+		else
+			std::this_thread::yield();
+	}
+}
+
+
+// Splits [0, count) into chunks of at most grainSize elements and runs
+// body(begin, end) for each of them on the pool. Returns when all chunks
+// have been processed.
+void JobSystem::parallelFor(std::size_t count, std::size_t grainSize, const std::function<void(std::size_t, std::size_t)> &body)
+{
+	if (count == 0)
+		return;
+	if (grainSize == 0)
+		grainSize = 1;
+
+	// Not worth scheduling anything for a single chunk
+	if (count <= grainSize)
+	{
+		body(0, count);
+		return;
+	}
+
+	int index = workerIndex >= 0 ? workerIndex : static_cast<int>(queues.size()) - 1;
+	Counter counter;
+
+	std::unique_lock<std::mutex> queueLock(queues[index]->blockade);
+	for (std::size_t begin = 0; begin < count; begin += grainSize)
+	{
+		std::size_t end = std::min(begin + grainSize, count);
+		counter.jobsLeft++;
+		queues[index]->jobs.push_back({ [&body, begin, end]() { body(begin, end); }, &counter });
+		queuedJobs++;
+	}
+	queueLock.unlock();
+
+	wakeWorkers();
+	wait(counter);
+}
@@ -0,0 +1,73 @@
+#ifndef JOB_SYSTEM_H_
+#define JOB_SYSTEM_H_
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+
+// Work-stealing task scheduler. Every worker thread owns a deque of jobs -
+// it takes jobs from the back of its own deque and, when it runs out of
+// work, steals from the front of the other deques. Threads which submit
+// jobs from outside of the pool use a shared deque and help executing
+// jobs while waiting for their completion.
+class JobSystem
+{
+	public:
+		using Job = std::function<void()>;
+
+		// Number of jobs which haven't finished yet. Used to wait for
+		// a group of jobs submitted together.
+		class Counter
+		{
+			friend class JobSystem;
+
+			private:
+				std::atomic<int> jobsLeft{ 0 };
+
+			public:
+				bool isDone() const;
+		};
+
+	private:
+		struct WorkerQueue
+		{
+			std::mutex blockade;
+			std::deque<std::pair<Job, Counter*>> jobs;
+		};
+
+		std::vector<std::unique_ptr<WorkerQueue>> queues;	// one per worker, the last one is shared by external threads
+		std::vector<std::thread> workers;
+
+		std::mutex sleepBlockade;
+		std::condition_variable jobAvailability;
+		std::atomic<int> queuedJobs{ 0 };
+		bool stopWorkers = false;
+
+		static thread_local int workerIndex;	// index of the queue owned by the current thread
+
+		void workerTask(int index);
+		bool popJob(int index, std::pair<Job, Counter*> &job);
+		bool stealJob(int thiefIndex, std::pair<Job, Counter*> &job);
+		void runJob(std::pair<Job, Counter*> &job);
+		void wakeWorkers();
+
+	public:
+		JobSystem(unsigned int threadsCount = 0);
+		JobSystem(const JobSystem&) = delete;
+		JobSystem& operator=(const JobSystem&) = delete;
+		~JobSystem();
+
+		std::size_t getWorkersCount() const;
+
+		void submit(Job job, Counter &counter);
+		void wait(Counter &counter);
+		void parallelFor(std::size_t count, std::size_t grainSize, const std::function<void(std::size_t, std::size_t)> &body);
+};
+
+
+#endif
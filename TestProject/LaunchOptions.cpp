@@ -0,0 +1,118 @@
+#include "LaunchOptions.h"
+
+
+// Throws std::invalid_argument describing the first wrong option
+LaunchOptions LaunchOptions::parse(int argc, char *argv[])
+{
+	LaunchOptions options;
+
+	// Returns the value following the option at index i
+	auto value = [&](int &i) -> std::string
+	{
+		if (i + 1 >= argc)
+			throw std::invalid_argument(std::string("brak wartosci opcji ") + argv[i]);
+		return argv[++i];
+	};
+
+	auto number = [&](int &i, unsigned int min, unsigned int max) -> unsigned int
+	{
+		std::string option = argv[i];
+		std::string text = value(i);
+
+		std::size_t parsed = 0;
+		unsigned long result = 0;
+		try
+		{
+			result = std::stoul(text, &parsed);
+		}
+		catch (std::exception&)
+		{
+		}
+
+		if (parsed != text.size() || result < min || result > max)
+			throw std::invalid_argument("nieprawidlowa wartosc opcji " + option + ": " + text);
+		return static_cast<unsigned int>(result);
+	};
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string option = argv[i];
+		if (option == "--host")
+			options.host = true;
+		else if (option == "--port")
+			options.port = std::to_string(number(i, 1, 65535));
+		else if (option == "--players")
+			options.players = number(i, 1, 1000);
+		else if (option == "--ticks")
+			options.tickRate = number(i, 1, 1000);
+		else if (option == "--full-snapshots")
+			options.fullSnapshots = true;
+		else if (option == "--log-bandwidth")
+			options.logBandwidth = true;
+		else if (option == "--log-prediction")
+			options.logPrediction = true;
+		else if (option == "--bots")
+			options.bots = number(i, 1, 1000);
+		else if (option == "--connect")
+			options.server = value(i);
+		else if (option == "--duration")
+			options.duration = number(i, 1, 86400);
+		else if (option == "--latency")
+			options.latency = number(i, 0, 10000);
+		else if (option == "--benchmark")
+			options.benchmark = value(i);
+		else if (option == "--profile-csv")
+			options.profileCsv = value(i);
+		else if (option == "--profile-trace")
+			options.profileTrace = value(i);
+		else if (option == "--profile-overlay")
+			options.profileOverlay = true;
+		else
+			throw std::invalid_argument("nieznana opcja " + option);
+	}
+
+	if (options.host && options.bots > 0)
+		throw std::invalid_argument("opcje --host i --bots wykluczaja sie");
+	if (options.fullSnapshots && options.host == false)
+		throw std::invalid_argument("opcja --full-snapshots wymaga --host");
+	if (options.logBandwidth && (options.bots > 0 || options.benchmark.empty() == false))
+		throw std::invalid_argument("opcja --log-bandwidth wyklucza --bots i --benchmark");
+	if (options.logPrediction && (options.host || options.bots > 0 || options.benchmark.empty() == false))
+		throw std::invalid_argument("opcja --log-prediction wyklucza --host, --bots i --benchmark");
+	if (options.latency > 0 && options.bots == 0)
+		throw std::invalid_argument("opcja --latency wymaga --bots");
+	if (options.benchmark.empty() == false && (options.host || options.bots > 0))
+		throw std::invalid_argument("opcja --benchmark wyklucza --host i --bots");
+	if (options.benchmark.empty() == false && options.benchmark != "collisions" && options.benchmark != "actors" && options.benchmark != "network" && options.benchmark != "draw")
+		throw std::invalid_argument("nieznany test wydajnosci " + options.benchmark);
+
+	return options;
+}
+
+
+const char* LaunchOptions::usage()
+{
+	return "Uzycie: TestProject [--host] [--port numer] [--players liczba] [--ticks liczba] [--full-snapshots] [--log-bandwidth] [--log-prediction]\n"
+		"       TestProject --bots liczba [--connect adres] [--port numer] [--duration sekundy] [--latency ms]\n"
+		"       TestProject --benchmark nazwa\n"
+		"       opcje profilera: [--profile-csv plik] [--profile-trace plik] [--profile-overlay]\n"
+		"  --host      serwer bez okna, czeka na graczy i sam rozpoczyna gre\n"
+		"  --port      port TCP i UDP (domyslnie 2701)\n"
+		"  --players   liczba graczy, na ktorych czeka serwer (domyslnie 1)\n"
+		"  --ticks     kroki symulacji na sekunde (domyslnie 60)\n"
+		"  --full-snapshots  serwer wysyla pelne stany zamiast roznic (do pomiaru przepustowosci)\n"
+		"  --log-bandwidth   serwer co sekunde wypisuje przepustowosc kazdego gracza\n"
+		"  --log-prediction  klient co sekunde wypisuje czas potwierdzenia wejscia i korekte predykcji\n"
+		"  --bots      generator obciazenia - liczba botow laczacych sie z serwerem\n"
+		"  --connect   adres serwera dla botow (domyslnie 127.0.0.1)\n"
+		"  --duration  czas pomiaru w sekundach (domyslnie 30)\n"
+		"  --latency   opoznienie w obie strony dodawane do ruchu botow w ms (domyslnie 0)\n"
+		"  --benchmark test wydajnosci bez okna zamiast gry:\n"
+		"              collisions - tick symulacji przy 100, 1000 i 10000 pociskow\n"
+		"              actors     - przejscia po 10000 aktorach\n"
+		"              network    - przepustowosc localhost przy 10000 i wiecej wiadomosci/s\n"
+		"              draw       - rysowanie mapy z odrzucaniem poza widokiem i bez (w oknie)\n"
+		"  --profile-csv plik      zapisuje czasy faz kazdej klatki do pliku CSV\n"
+		"  --profile-trace plik    zapisuje slad w formacie Chrome (chrome://tracing)\n"
+		"  --profile-overlay       pokazuje nakladke profilera (przelaczana klawiszem F3)\n";
+}
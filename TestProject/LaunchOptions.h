@@ -0,0 +1,37 @@
+#ifndef LAUNCH_OPTIONS_H_
+#define LAUNCH_OPTIONS_H_
+#include <string>
+#include <stdexcept>
+
+
+// Settings given on the command line, e.g.
+// --host --port 2701 --players 8 --ticks 60
+// --bots 8 --connect 127.0.0.1 --duration 60 --latency 100
+// --benchmark collisions
+struct LaunchOptions
+{
+	bool host = false;				// dedicated host - no window, textures and console menu
+	std::string port = "2701";
+	unsigned int players = 1;		// clients the dedicated host waits for before starting the game
+	unsigned int tickRate = 60;		// simulation ticks per second
+	bool fullSnapshots = false;		// host sends whole snapshots instead of deltas, to measure the delta compression
+	bool logBandwidth = false;		// host prints bytes per second of every client
+	bool logPrediction = false;		// client prints input round trip and prediction error
+
+	unsigned int bots = 0;			// load generator clients, 0 runs the game
+	std::string server = "127.0.0.1";
+	unsigned int duration = 30;		// seconds the load generator measures for
+	unsigned int latency = 0;		// round trip in milliseconds the bots add to their traffic
+
+	std::string benchmark;			// measurement run instead of the game, empty if none
+
+	std::string profileCsv;			// files the profiler writes to, empty if none
+	std::string profileTrace;
+	bool profileOverlay = false;	// shown from the start, F3 toggles it
+
+	static LaunchOptions parse(int argc, char *argv[]);
+	static const char* usage();
+};
+
+
+#endif
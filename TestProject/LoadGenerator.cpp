@@ -0,0 +1,492 @@
+#include "LoadGenerator.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <numeric>
+#include <thread>
+#include "GameController.h"
+#include "MessageHeader.h"
+#include "PlayerController.h"
+#include "Tools.h"
+
+
+LoadGenerator::LoadGenerator(const LaunchOptions &options)
+	: options(options)
+	, quantization(GameController::createQuantization(GameController::defaultMapWidth, GameController::defaultMapHeight))
+{
+}
+
+
+// Runs the bots for options.duration seconds after the host starts the game.
+// Returns the exit code of the program.
+int LoadGenerator::run()
+{
+	connectBots();
+	if (bots.empty())
+		return 1;
+
+	printf("Polaczone boty: %zu, oczekiwanie na rozpoczecie gry...\n", bots.size());
+
+	bool started = false;
+	clock::time_point startTime;
+	clock::time_point reportTime;
+	while (true)
+	{
+		clock::time_point now = clock::now();
+		for (auto &bot : bots)
+		{
+			receiveMessages(*bot, now);
+
+			// Inputs sent before the host creates the ship would be lost
+			if (bot->joined && bot->shipId != 0 && bot->disconnected == false)
+			{
+				runScript(*bot, now);
+				simulateFrames(*bot, now);
+			}
+			flushOutgoing(*bot, now);
+		}
+
+		// Measuring starts when the host sends the first player id
+		if (started == false)
+		{
+			started = std::any_of(bots.begin(), bots.end(), [](const std::unique_ptr<Bot> &bot) { return bot->joined; });
+			startTime = now;
+			reportTime = now;
+		}
+		else if (now - reportTime >= std::chrono::seconds(1))
+		{
+			report(std::chrono::duration<double>(now - startTime).count(), std::chrono::duration<double>(now - reportTime).count());
+			reportTime = now;
+
+			if (now - startTime >= std::chrono::seconds(options.duration))
+				break;
+		}
+
+		// The delay line needs finer steps to keep the latency accurate
+		std::this_thread::sleep_for(std::chrono::milliseconds(options.latency > 0 ? 1 : 5));
+	}
+
+	std::vector<double> &samples = allLatencies;
+	printf("\nPodsumowanie po %u s:\n", options.duration);
+	printf("  maksymalny tick hosta: %.2f ms\n", hostTickMaxOverall * 1000.0);
+	if (samples.empty() == false)
+	{
+		printf("  opoznienie aktualizacji: p50 %.1f ms, p90 %.1f ms, p99 %.1f ms, maks %.1f ms (probek %zu)\n",
+			percentile(samples, 0.50) * 1000.0, percentile(samples, 0.90) * 1000.0, percentile(samples, 0.99) * 1000.0,
+			percentile(samples, 1.0) * 1000.0, samples.size());
+	}
+	else
+		printf("  brak potwierdzonych wejsc\n");
+
+	if (allCorrections.empty() == false && allLags.empty() == false)
+	{
+		printf("  korekta predykcji: sr %.2f px, p50 %.2f px, p99 %.2f px, maks %.2f px (korekt %zu)\n",
+			std::accumulate(allCorrections.begin(), allCorrections.end(), 0.0) / allCorrections.size(),
+			percentile(allCorrections, 0.50), percentile(allCorrections, 0.99), percentile(allCorrections, 1.0), allCorrections.size());
+		printf("  ostatni stan z hosta za predykcja: sr %.1f px, p50 %.1f px, p99 %.1f px\n",
+			std::accumulate(allLags.begin(), allLags.end(), 0.0) / allLags.size(),
+			percentile(allLags, 0.50), percentile(allLags, 0.99));
+	}
+
+	return 0;
+}
+
+
+// Every bot gets a separate network manager, like a separate game client
+void LoadGenerator::connectBots()
+{
+	printf("Laczenie %u botow z %s:%s...\n", options.bots, options.server.c_str(), options.port.c_str());
+	for (unsigned int i = 0; i < options.bots; i++)
+	{
+		auto bot = std::make_unique<Bot>();
+		Bot *botPtr = bot.get();
+		bot->index = i;
+
+		bot->networkManager.setOnReceive([botPtr](unsigned long connectionId, const char *data, int dataSize)
+		{
+			botPtr->receivedMessages.push(connectionId, data, dataSize);
+		});
+		bot->networkManager.setOnDisconnect([botPtr](unsigned long)
+		{
+			botPtr->disconnected = true;
+		});
+
+		try
+		{
+			bot->networkManager.connectAsClient(options.server, options.port);
+		}
+		catch (std::exception &e)
+		{
+			printf("Bot %u nie polaczyl sie z serwerem: %s\n", i, e.what());
+			continue;
+		}
+
+		auto connections = bot->networkManager.getConnections();
+		if (connections.empty() == false)
+			bot->connectionId = connections.front();
+		bots.push_back(std::move(bot));
+	}
+}
+
+
+// Takes the messages received by the network thread, through the delay line if there is one
+void LoadGenerator::receiveMessages(Bot &bot, clock::time_point now)
+{
+	bot.receivedMessages.takeAll(bot.batch);
+	bot.batch.forEach([&](unsigned long, const char *data, std::size_t dataSize)
+	{
+		if (options.latency == 0)
+			handleMessage(bot, data, dataSize);
+		else
+			bot.delayedIncoming.push_back({ now + std::chrono::microseconds(options.latency * 500), true, 0, std::vector<char>(data, data + dataSize) });
+	});
+
+	while (bot.delayedIncoming.empty() == false && bot.delayedIncoming.front().due <= now)
+	{
+		handleMessage(bot, bot.delayedIncoming.front().data.data(), bot.delayedIncoming.front().data.size());
+		bot.delayedIncoming.pop_front();
+	}
+}
+
+
+// Sends the message in messageBuffer, through the delay line if there is one
+void LoadGenerator::send(Bot &bot, bool reliable, std::uint32_t stream)
+{
+	if (options.latency > 0)
+	{
+		bot.delayedOutgoing.push_back({ clock::now() + std::chrono::microseconds(options.latency * 500), reliable, stream, messageBuffer });
+		return;
+	}
+
+	if (reliable)
+		bot.networkManager.sendToAll(messageBuffer.data(), messageBuffer.size());
+	else
+		bot.networkManager.sendToAllUnreliable(messageBuffer.data(), messageBuffer.size(), stream);
+}
+
+
+void LoadGenerator::flushOutgoing(Bot &bot, clock::time_point now)
+{
+	while (bot.delayedOutgoing.empty() == false && bot.delayedOutgoing.front().due <= now)
+	{
+		DelayedMessage &message = bot.delayedOutgoing.front();
+		if (message.reliable)
+			bot.networkManager.sendToAll(message.data.data(), message.data.size());
+		else
+			bot.networkManager.sendToAllUnreliable(message.data.data(), message.data.size(), message.stream);
+		bot.delayedOutgoing.pop_front();
+	}
+}
+
+
+void LoadGenerator::handleMessage(Bot &bot, const char *data, std::size_t dataSize)
+{
+	BitReader message(data, dataSize);
+	MessageHeader header = static_cast<MessageHeader>(message.readBits(8));
+	if (message.hasFailed())
+		return;
+
+	switch (header)
+	{
+		case MessageHeader::THIS_PLAYER_ID:
+			bot.playerId = static_cast<unsigned long>(message.readVarint());
+			bot.joined = message.hasFailed() == false;
+			break;
+
+		case MessageHeader::CREATE_PLAYER_SHIP:
+			onCreatePlayerShip(bot, message);
+			break;
+
+		case MessageHeader::STATE_SNAPSHOT:
+			onStateSnapshot(bot, message);
+			break;
+
+		case MessageHeader::HOST_STATS:
+			onHostStats(message);
+			break;
+
+		default:
+			break;
+	}
+}
+
+
+// Decodes the message like GameController::onCreatePlayerShip, the ship
+// of the bot starts being predicted
+void LoadGenerator::onCreatePlayerShip(Bot &bot, BitReader &message)
+{
+	float x = message.readQuantized(quantization.positionX);
+	float y = message.readQuantized(quantization.positionY);
+	float angle = message.readAngle(quantization.rotationBits);
+	unsigned long id = static_cast<unsigned long>(message.readVarint());
+	message.readString();
+	unsigned long actorId = static_cast<unsigned long>(message.readVarint());
+	if (message.hasFailed() || id != bot.playerId)
+		return;
+
+	bot.shipId = actorId;
+	bot.position = sf::Vector2f(x, y);
+	bot.rotation = angle;
+}
+
+
+// Decodes the snapshot like GameController::onStateSnapshot, but only
+// uses the state of the bot's ship and its last applied input
+void LoadGenerator::onStateSnapshot(Bot &bot, BitReader &message)
+{
+	unsigned long sequence = 0;
+	unsigned long baselineSequence = 0;
+	if (SnapshotHistory::decodeSequences(message, sequence, baselineSequence) == false || sequence <= bot.snapshotSequence)
+		return;
+
+	const Snapshot *baseline = bot.snapshotHistory.find(baselineSequence);
+	if (baselineSequence != 0 && baseline == nullptr)
+		return;
+
+	if (SnapshotHistory::decodeDelta(message, baseline, quantization, bot.receivedSnapshot, bot.changedStates) == false)
+		return;
+	bot.receivedSnapshot.sequence = sequence;
+
+	unsigned long processedInput = static_cast<unsigned long>(message.readVarint());
+	float inputAge = message.readVarint() / 1000.0f;
+	message.readVarint();		// host time
+	if (message.hasFailed())
+		return;
+
+	bot.snapshotSequence = sequence;
+	bot.snapshotHistory.add(bot.receivedSnapshot);
+
+	messageBuffer.clear();
+	BitWriter ack(messageBuffer);
+	ack.writeBits(static_cast<std::uint32_t>(MessageHeader::SNAPSHOT_ACK), 8);
+	ack.writeVarint(sequence);
+	ack.flush();
+	send(bot, false, GameController::datagramStream(MessageHeader::SNAPSHOT_ACK));
+
+	const ActorState *state = bot.receivedSnapshot.findState(bot.shipId);
+	if (state != nullptr)
+		reconcile(bot, *state, processedInput, inputAge);
+
+	clock::time_point now = clock::now();
+	while (bot.pendingInputs.empty() == false && bot.pendingInputs.front().first <= processedInput)
+	{
+		latencies.push_back(std::chrono::duration<double>(now - bot.pendingInputs.front().second).count());
+		bot.pendingInputs.pop_front();
+	}
+}
+
+
+// Advances the predicted ship in steps of the host's tick, with the engines
+// fired at the moment, and records them to replay on reconciliation
+void LoadGenerator::simulateFrames(Bot &bot, clock::time_point now)
+{
+	if (bot.previousFrame == clock::time_point())
+		bot.previousFrame = now;
+	bot.frameAccumulator += std::chrono::duration<double>(now - bot.previousFrame).count();
+	bot.previousFrame = now;
+
+	const float deltaTime = 1.0f / options.tickRate;
+	while (bot.frameAccumulator >= deltaTime)
+	{
+		InputFrame frame = { bot.inputSequence, deltaTime, bot.engines };
+		simulateFrame(bot.position, bot.velocity, bot.rotation, frame);
+		bot.recordedFrames.push_back(frame);
+		if (bot.recordedFrames.size() > 1024)
+			bot.recordedFrames.pop_front();
+
+		bot.frameAccumulator -= deltaTime;
+	}
+}
+
+
+// Moves the predicted ship by one frame, with the default motion of ships
+void LoadGenerator::simulateFrame(sf::Vector2f &position, sf::Vector2f &velocity, float rotation, const InputFrame &frame) const
+{
+	PlayerController::simulate(position, velocity, rotation, frame.engines, frame.deltaTime, PlayerController::Motion(),
+		sf::Vector2f(GameController::defaultMapWidth, GameController::defaultMapHeight));
+}
+
+
+// Replays the recorded frames on top of the host's state the way
+// PlayerController::reconcile does. The distance to the state itself is
+// how far behind the ship would be drawn without prediction.
+void LoadGenerator::reconcile(Bot &bot, const ActorState &state, unsigned long processedInput, float inputAge)
+{
+	float lag = Tools::length(state.position - bot.position);
+	if (lag <= maxMeasuredDistance)
+		allLags.push_back(lag);
+
+	if (processedInput != bot.reconciledInput)
+	{
+		bot.reconciledInput = processedInput;
+		bot.consumedTime = 0.0f;
+	}
+
+	while (bot.recordedFrames.empty() == false && bot.recordedFrames.front().inputSequence < processedInput)
+		bot.recordedFrames.pop_front();
+
+	float skippedTime = inputAge - bot.consumedTime;
+	while (bot.recordedFrames.empty() == false && bot.recordedFrames.front().inputSequence == processedInput && bot.recordedFrames.front().deltaTime <= skippedTime)
+	{
+		skippedTime -= bot.recordedFrames.front().deltaTime;
+		bot.consumedTime += bot.recordedFrames.front().deltaTime;
+		bot.recordedFrames.pop_front();
+	}
+
+	sf::Vector2f position = state.position;
+	sf::Vector2f velocity = state.velocity;
+	bool partialFrame = bot.recordedFrames.empty() == false && bot.recordedFrames.front().inputSequence == processedInput && skippedTime > 0.0f;
+	for (auto &recorded : bot.recordedFrames)
+	{
+		InputFrame frame = recorded;
+		if (partialFrame)
+		{
+			frame.deltaTime -= skippedTime;
+			partialFrame = false;
+		}
+
+		simulateFrame(position, velocity, state.rotation, frame);
+	}
+
+	float correction = Tools::length(position - bot.position);
+	if (correction <= maxMeasuredDistance)
+		corrections.push_back(correction);
+	bot.position = position;
+	bot.velocity = velocity;
+	bot.rotation = state.rotation;
+}
+
+
+void LoadGenerator::onHostStats(BitReader &message)
+{
+	double mean = message.readVarint() / 1e6;
+	double max = message.readVarint() / 1e6;
+	message.readVarint();		// ticks
+	unsigned long players = static_cast<unsigned long>(message.readVarint());
+	if (message.hasFailed())
+		return;
+
+	hostStatsReceived = true;
+	hostTickMean = mean;
+	hostTickMax = max;
+	hostTickMaxOverall = std::max(hostTickMaxOverall, max);
+	hostPlayers = players;
+}
+
+
+// Main engine is kept on, the ship changes the strafing direction every
+// second and fires four times a second. Bots are shifted in time, so that
+// their inputs don't reach the host at once.
+void LoadGenerator::runScript(Bot &bot, clock::time_point now)
+{
+	if (bot.inputSequence == 0)
+	{
+		auto offset = std::chrono::milliseconds(bot.index * 37 % 1000);
+		bot.nextStrafe = now + offset;
+		bot.nextShot = now + offset % 250;
+		sendKey(bot, sf::Keyboard::W, true);
+	}
+
+	if (now >= bot.nextStrafe)
+	{
+		sendKey(bot, bot.strafingLeft ? sf::Keyboard::A : sf::Keyboard::D, false);
+		bot.strafingLeft = !bot.strafingLeft;
+		sendKey(bot, bot.strafingLeft ? sf::Keyboard::A : sf::Keyboard::D, true);
+		bot.nextStrafe += std::chrono::seconds(1);
+	}
+
+	if (now >= bot.nextShot)
+	{
+		sendKey(bot, sf::Keyboard::Space, true);
+		sendKey(bot, sf::Keyboard::Space, false);
+		bot.nextShot += std::chrono::milliseconds(250);
+	}
+}
+
+
+// Sends PLAYER_INPUT_EVENT the same way as GameController::sendEvent.
+// The predicted ship fires its engines at once, like PlayerController::reactToKeyboard.
+void LoadGenerator::sendKey(Bot &bot, sf::Keyboard::Key key, bool pressed)
+{
+	unsigned char engine = 0;
+	if (key == sf::Keyboard::W)
+		engine = PlayerController::MAIN_ENGINE;
+	else if (key == sf::Keyboard::S)
+		engine = PlayerController::REVERSE_ENGINE;
+	else if (key == sf::Keyboard::A)
+		engine = PlayerController::LEFT_ENGINE;
+	else if (key == sf::Keyboard::D)
+		engine = PlayerController::RIGHT_ENGINE;
+	bot.engines = pressed ? bot.engines | engine : bot.engines & ~engine;
+
+	messageBuffer.clear();
+	BitWriter message(messageBuffer);
+	message.writeBits(static_cast<std::uint32_t>(MessageHeader::PLAYER_INPUT_EVENT), 8);
+	message.writeBool(pressed);
+	message.writeBits(static_cast<std::uint32_t>(key - sf::Keyboard::Unknown), 7);
+	message.writeBool(false);
+	message.writeBool(false);
+	message.writeBool(false);
+	message.writeBool(false);
+	message.writeVarint(bot.playerId);
+	message.writeVarint(++bot.inputSequence);
+	message.flush();
+
+	bot.pendingInputs.emplace_back(bot.inputSequence, clock::now());
+	if (bot.pendingInputs.size() > 256)
+		bot.pendingInputs.pop_front();
+
+	send(bot, true);
+}
+
+
+void LoadGenerator::report(double elapsed, double reportInterval)
+{
+	// Bandwidth of a single client, averaged and the highest among the bots
+	double receivedSum = 0.0, receivedMax = 0.0, sentSum = 0.0;
+	std::size_t connected = 0;
+	for (auto &bot : bots)
+	{
+		Network::NetworkManager::ConnectionStats stats;
+		if (bot->disconnected || bot->networkManager.getConnectionStats(bot->connectionId, stats) == false)
+			continue;
+
+		double received = (stats.bytesReceived - bot->reportedStats.bytesReceived) / reportInterval;
+		double sent = (stats.bytesSent - bot->reportedStats.bytesSent) / reportInterval;
+		bot->reportedStats = stats;
+
+		receivedSum += received;
+		receivedMax = std::max(receivedMax, received);
+		sentSum += sent;
+		connected++;
+	}
+
+	printf("[%3.0f s] boty %zu/%zu", elapsed, connected, bots.size());
+	if (hostStatsReceived)
+		printf(" | tick hosta sr %.2f ms maks %.2f ms, graczy %lu", hostTickMean * 1000.0, hostTickMax * 1000.0, hostPlayers);
+	if (connected > 0)
+		printf(" | klient odbiera sr %.0f B/s maks %.0f B/s, wysyla sr %.0f B/s", receivedSum / connected, receivedMax, sentSum / connected);
+	if (latencies.empty() == false)
+	{
+		printf(" | opoznienie p50 %.1f ms p90 %.1f ms p99 %.1f ms maks %.1f ms",
+			percentile(latencies, 0.50) * 1000.0, percentile(latencies, 0.90) * 1000.0,
+			percentile(latencies, 0.99) * 1000.0, percentile(latencies, 1.0) * 1000.0);
+	}
+	if (corrections.empty() == false)
+		printf(" | korekta predykcji sr %.2f px", std::accumulate(corrections.begin(), corrections.end(), 0.0) / corrections.size());
+	printf("\n");
+
+	allLatencies.insert(allLatencies.end(), latencies.begin(), latencies.end());
+	latencies.clear();
+	allCorrections.insert(allCorrections.end(), corrections.begin(), corrections.end());
+	corrections.clear();
+}
+
+
+// Nearest rank percentile, sorts the values
+double LoadGenerator::percentile(std::vector<double> &values, double fraction)
+{
+	std::sort(values.begin(), values.end());
+	std::size_t rank = static_cast<std::size_t>(std::ceil(fraction * values.size()));
+	return values[std::max<std::size_t>(rank, 1) - 1];
+}
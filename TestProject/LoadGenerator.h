@@ -0,0 +1,146 @@
+#ifndef LOAD_GENERATOR_H_
+#define LOAD_GENERATOR_H_
+#include <SFML/Window/Keyboard.hpp>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "NetworkManager.h"
+#include "MessageQueue.h"
+#include "StateSnapshot.h"
+#include "BitStream.h"
+#include "LaunchOptions.h"
+
+
+// Headless clients driven by a script, used to measure how the host scales.
+// Each bot has its own connection, goes through the player id handshake,
+// acknowledges snapshots and sends input events: the main engine stays on,
+// the ship strafes left and right and fires a few times per second.
+// Once a second the host's tick time (from HOST_STATS), bandwidth of the
+// bots and percentiles of the update latency - time from sending an input
+// to receiving a snapshot in which the host applied it - are printed.
+//
+// Each bot predicts its own ship like PlayerController and reconciles it
+// with snapshots, measuring how far the ship is moved by the corrections
+// and how far the last received state lags behind the predicted one. With
+// options.latency the traffic of the bots goes through a delay line, half
+// of the round trip in each direction, like through a latency proxy.
+class LoadGenerator
+{
+	private:
+		using clock = std::chrono::steady_clock;
+
+		// Message held back by the delay line until it is due
+		struct DelayedMessage
+		{
+			clock::time_point due;
+			bool reliable;
+			std::uint32_t stream;
+			std::vector<char> data;
+		};
+
+		// Simulation step of the predicted ship, see PlayerController::InputFrame
+		struct InputFrame
+		{
+			unsigned long inputSequence;
+			float deltaTime;
+			unsigned char engines;
+		};
+
+		struct Bot
+		{
+			unsigned int index;
+			Network::NetworkManager networkManager;
+			MessageQueue receivedMessages{ 256 };
+			MessageQueue::Batch batch;
+			std::atomic<bool> disconnected{ false };
+
+			unsigned long connectionId = 0;
+			unsigned long playerId = 0;
+			bool joined = false;
+
+			// Snapshots are acknowledged like by a real client, so the host sends deltas
+			SnapshotHistory snapshotHistory;
+			unsigned long snapshotSequence = 0;
+			Snapshot receivedSnapshot;
+			std::vector<ActorState> changedStates;
+
+			// Inputs waiting for a snapshot which confirms them
+			unsigned long inputSequence = 0;
+			std::deque<std::pair<unsigned long, clock::time_point>> pendingInputs;
+
+			// Latency proxy
+			std::deque<DelayedMessage> delayedIncoming;
+			std::deque<DelayedMessage> delayedOutgoing;
+
+			// Prediction of the own ship, known after CREATE_PLAYER_SHIP
+			unsigned long shipId = 0;
+			sf::Vector2f position;
+			sf::Vector2f velocity;
+			float rotation = 0.0f;
+			unsigned char engines = 0;
+			std::deque<InputFrame> recordedFrames;
+			unsigned long reconciledInput = 0;
+			float consumedTime = 0.0f;
+			double frameAccumulator = 0.0;
+			clock::time_point previousFrame;
+
+			// Script state
+			clock::time_point nextStrafe;
+			clock::time_point nextShot;
+			bool strafingLeft = false;
+
+			Network::NetworkManager::ConnectionStats reportedStats;
+		};
+
+		LaunchOptions options;
+		StateQuantization quantization;
+		std::vector<std::unique_ptr<Bot>> bots;
+		std::vector<char> messageBuffer;
+
+		// Update latencies in seconds, of the current report and of the whole run
+		std::vector<double> latencies;
+		std::vector<double> allLatencies;
+
+		// Distances in pixels the predicted ships were moved by on reconciliation,
+		// and between them and the states received from the host. Longer ones
+		// than maxMeasuredDistance are wraps around the map edges.
+		static constexpr float maxMeasuredDistance = 1000.0f;
+		std::vector<double> corrections;
+		std::vector<double> allCorrections;
+		std::vector<double> allLags;
+
+		// Last HOST_STATS, tick times in seconds
+		bool hostStatsReceived = false;
+		double hostTickMean = 0.0;
+		double hostTickMax = 0.0;
+		double hostTickMaxOverall = 0.0;
+		unsigned long hostPlayers = 0;
+
+		void connectBots();
+		void receiveMessages(Bot &bot, clock::time_point now);
+		void send(Bot &bot, bool reliable, std::uint32_t stream = 0);
+		void flushOutgoing(Bot &bot, clock::time_point now);
+		void handleMessage(Bot &bot, const char *data, std::size_t dataSize);
+		void onCreatePlayerShip(Bot &bot, BitReader &message);
+		void onStateSnapshot(Bot &bot, BitReader &message);
+		void simulateFrames(Bot &bot, clock::time_point now);
+		void simulateFrame(sf::Vector2f &position, sf::Vector2f &velocity, float rotation, const InputFrame &frame) const;
+		void reconcile(Bot &bot, const ActorState &state, unsigned long processedInput, float inputAge);
+		void onHostStats(BitReader &message);
+		void runScript(Bot &bot, clock::time_point now);
+		void sendKey(Bot &bot, sf::Keyboard::Key key, bool pressed);
+		void report(double elapsed, double reportInterval);
+		static double percentile(std::vector<double> &values, double fraction);
+
+	public:
+		LoadGenerator(const LaunchOptions &options);
+		LoadGenerator(const LoadGenerator&) = delete;
+		LoadGenerator& operator=(const LoadGenerator&) = delete;
+
+		int run();
+};
+
+
+#endif
@@ -1,23 +1,40 @@
 #include <cstdlib>
 #include <ctime>
+#include <thread>
 #include "NetworkManager.h"
 #include "Game.h"
 #include "GameController.h"
 #include "Button.h"
-#include "ThreadsafeDataQueue.h"
+#include "MessageQueue.h"
+#include "LaunchOptions.h"
+#include "LoadGenerator.h"
+#include "Benchmark.h"
+#include "Profiler.h"
 
 
 //std::list<Button> buttons;
 //sf::Texture buttonTexture;
 
 
-int main()
+int main(int argc, char *argv[])
 {
 	/*buttonTexture.loadFromFile("button.png");
 	buttons.push_back(Button(buttonTexture, 200, 150, 300, 123.5, 200, 100, Game::get().window, []()
 	{
 		MessageBoxA(0, "I was clicked!", "Click!", MB_OK);
 	}));*/
+	LaunchOptions options;
+	try
+	{
+		options = LaunchOptions::parse(argc, argv);
+	}
+	catch (std::invalid_argument &e)
+	{
+		std::cerr << "Blad: " << e.what() << std::endl << LaunchOptions::usage();
+		return 1;
+	}
+
+#ifdef _WIN32
 	WSADATA wsaData;
 	int iResult;
 
@@ -28,8 +45,43 @@ int main()
 		std::cerr << "WSAStartup failed: " << iResult << std::endl;
 		return 1;
 	}
+#endif
+
+	// Load generator runs bots instead of the game
+	if (options.bots > 0)
+	{
+		int result = LoadGenerator(options).run();
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return result;
+	}
+
+	// Benchmarks simulate a scene of their own instead of the game
+	if (options.benchmark.empty() == false)
+	{
+		Game::setLaunchOptions(options);
+		int result = Benchmark(options).run();
+#ifdef _WIN32
+		WSACleanup();
+#endif
+		return result;
+	}
 
-	ThreadsafeDataQueue networkDataQueue;
+	// Profiler output, markers are compiled only in debug builds or with ENABLE_PROFILER
+	Profiler &profiler = Profiler::get();
+	profiler.overlayEnabled = options.profileOverlay;
+	if (options.profileCsv.empty() == false && profiler.openCsv(options.profileCsv) == false)
+		std::cerr << "Nie udalo sie otworzyc pliku " << options.profileCsv << std::endl;
+	if (options.profileTrace.empty() == false && profiler.openTrace(options.profileTrace) == false)
+		std::cerr << "Nie udalo sie otworzyc pliku " << options.profileTrace << std::endl;
+#ifndef PROFILER_ENABLED
+	if (options.profileCsv.empty() == false || options.profileTrace.empty() == false || options.profileOverlay)
+		std::cerr << "Profiler jest wylaczony w tej kompilacji, zdefiniuj ENABLE_PROFILER" << std::endl;
+#endif
+
+	Game::setLaunchOptions(options);
+	MessageQueue networkDataQueue;
 	Network::NetworkManager networkManager;
 	Game &game = Game::get();
 	std::srand(static_cast<unsigned>(std::time(0)));
@@ -43,11 +95,12 @@ int main()
 	controller->setDataQueue(&networkDataQueue);
 
 	game.previousFrame = Game::steady_clock::now();
-	while (game.window.isOpen())
+	while (game.isRunning())
 	{
-		// Update the time between last two frames
-		game.deltaTime = static_cast<double>((Game::steady_clock::now() - game.previousFrame).count()) / Game::steady_clock::period::den;
-		game.previousFrame = Game::steady_clock::now();
+		// Measure the time between last two frames
+		Game::steady_clock::time_point now = Game::steady_clock::now();
+		double frameTime = static_cast<double>((now - game.previousFrame).count()) / Game::steady_clock::period::den;
+		game.previousFrame = now;
 
 		// Handle incoming events
 		sf::Event event;
@@ -56,7 +109,7 @@ int main()
 			switch (event.type)
 			{
 				case sf::Event::Closed:
-					game.window.close();
+					game.quit();
 					break;
 
 				case sf::Event::Resized:
@@ -70,6 +123,8 @@ int main()
 
 				case sf::Event::KeyPressed:
 				case sf::Event::KeyReleased:
+					if (event.type == sf::Event::KeyPressed && event.key.code == sf::Keyboard::F3)
+						profiler.overlayEnabled = !profiler.overlayEnabled;
 					game.notifyScripts(&BehaviourScript::onKeyboardEvent, event);
 					break;
 
@@ -102,19 +157,35 @@ int main()
 			}
 		}
 
-		game.window.clear();
+		// Simulate in fixed ticks, then draw the state interpolated between them
+		game.advance(frameTime);
+
+		// A dedicated host doesn't draw, it sleeps until the next tick is due
+		if (game.isHeadless())
+		{
+			profiler.endFrame();
+			std::chrono::duration<double> untilNextTick((1.0 - game.renderAlpha) * game.fixedDeltaTime);
+			std::this_thread::sleep_until(now + std::chrono::duration_cast<Game::steady_clock::duration>(untilNextTick));
+			continue;
+		}
 
-		game.drawActors();
-		game.testCollisions();
-		game.update();
-		game.executeActorCoroutines();
-		game.removeDestroyedActors();
+		game.window.clear();
+		game.render();
 		/*for (auto &button : buttons)
 			button.draw();*/
 
-		game.window.display();
+		if (profiler.overlayEnabled)
+			profiler.drawOverlay(game.window);
+
+		{
+			PROFILE_SCOPE("Main::display");
+			game.window.display();
+		}
+		profiler.endFrame();
 	}
 
+#ifdef _WIN32
 	WSACleanup();
+#endif
 	return 0;
 }
\ No newline at end of file
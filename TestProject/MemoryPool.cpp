@@ -0,0 +1,51 @@
+#include "MemoryPool.h"
+
+
+void MemoryPool::addChunk()
+{
+	chunks.push_back(std::make_unique<char[]>(blockSize * blocksPerChunk));
+	char *chunk = chunks.back().get();
+
+	// Link new blocks so they are handed out in address order
+	for (std::size_t i = blocksPerChunk; i > 0; i--)
+	{
+		FreeBlock *block = reinterpret_cast<FreeBlock*>(chunk + (i - 1) * blockSize);
+		block->next = freeList;
+		freeList = block;
+	}
+}
+
+
+MemoryPool::MemoryPool(std::size_t blockSize, std::size_t blocksPerChunk)
+	: blocksPerChunk(blocksPerChunk)
+{
+	// Every block has to be able to hold the free list link and be aligned for any type
+	const std::size_t alignment = alignof(std::max_align_t);
+	if (blockSize < sizeof(FreeBlock))
+		blockSize = sizeof(FreeBlock);
+	this->blockSize = (blockSize + alignment - 1) / alignment * alignment;
+}
+
+
+void* MemoryPool::allocate()
+{
+	std::unique_lock<std::mutex> poolLock(blockade);
+	if (freeList == nullptr)
+		addChunk();
+
+	FreeBlock *block = freeList;
+	freeList = block->next;
+	return block;
+}
+
+
+void MemoryPool::deallocate(void *block)
+{
+	if (block == nullptr)
+		return;
+
+	std::unique_lock<std::mutex> poolLock(blockade);
+	FreeBlock *freeBlock = static_cast<FreeBlock*>(block);
+	freeBlock->next = freeList;
+	freeList = freeBlock;
+}
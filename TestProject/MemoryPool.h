@@ -0,0 +1,136 @@
+#ifndef MEMORY_POOL_H_
+#define MEMORY_POOL_H_
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <vector>
+
+
+// Allocator of fixed size blocks. Blocks are carved from large chunks,
+// so objects allocated one after another end up next to each other in
+// memory, and freed blocks are recycled through a free list.
+class MemoryPool
+{
+	private:
+		struct FreeBlock
+		{
+			FreeBlock *next;
+		};
+
+		std::size_t blockSize;
+		std::size_t blocksPerChunk;
+		std::vector<std::unique_ptr<char[]>> chunks;
+		FreeBlock *freeList = nullptr;
+		std::mutex blockade;
+
+		void addChunk();
+
+	public:
+		MemoryPool(std::size_t blockSize, std::size_t blocksPerChunk = 256);
+		MemoryPool(const MemoryPool&) = delete;
+		MemoryPool& operator=(const MemoryPool&) = delete;
+
+		void* allocate();
+		void deallocate(void *block);
+
+		// Returns the pool shared by all objects of the given size
+		template <std::size_t Size>
+		static MemoryPool& get();
+};
+
+
+// Standard allocator which takes single objects from the memory pool.
+// Used to put shared_ptr control blocks into the pools as well.
+template <typename T>
+class PoolAllocator
+{
+	public:
+		using value_type = T;
+
+		PoolAllocator() = default;
+		template <typename U>
+		PoolAllocator(const PoolAllocator<U>&) {}
+
+		T* allocate(std::size_t count);
+		void deallocate(T *pointer, std::size_t count);
+
+		template <typename U>
+		bool operator==(const PoolAllocator<U>&) const { return true; }
+		template <typename U>
+		bool operator!=(const PoolAllocator<U>&) const { return false; }
+};
+
+
+// Destroys an object created with adoptPooled()
+template <typename T>
+struct PoolDeleter
+{
+	void operator()(T *object) const;
+};
+
+
+template <typename T>
+void* allocatePooled();
+
+template <typename T, typename B = T>
+std::shared_ptr<B> adoptPooled(T *object);
+
+
+
+template <std::size_t Size>
+MemoryPool& MemoryPool::get()
+{
+	// Never destroyed - objects owned by other statics may be
+	// released after the pool would be destroyed at exit
+	static MemoryPool *pool = new MemoryPool(Size);
+	return *pool;
+}
+
+
+template <typename T>
+T* PoolAllocator<T>::allocate(std::size_t count)
+{
+	if (count != 1)
+		return static_cast<T*>(::operator new(count * sizeof(T)));
+	return static_cast<T*>(MemoryPool::get<sizeof(T)>().allocate());
+}
+
+
+template <typename T>
+void PoolAllocator<T>::deallocate(T *pointer, std::size_t count)
+{
+	if (count != 1)
+		::operator delete(pointer);
+	else
+		MemoryPool::get<sizeof(T)>().deallocate(pointer);
+}
+
+
+template <typename T>
+void PoolDeleter<T>::operator()(T *object) const
+{
+	object->~T();
+	MemoryPool::get<sizeof(T)>().deallocate(object);
+}
+
+
+// Returns uninitialized memory for one object of type T. The object
+// has to be constructed in it and passed to adoptPooled().
+template <typename T>
+void* allocatePooled()
+{
+	return MemoryPool::get<sizeof(T)>().allocate();
+}
+
+
+// Creates a shared pointer owning an object constructed in memory returned
+// by allocatePooled<T>(). The control block is taken from the pools too.
+template <typename T, typename B>
+std::shared_ptr<B> adoptPooled(T *object)
+{
+	return std::shared_ptr<B>(object, PoolDeleter<T>(), PoolAllocator<T>());
+}
+
+
+#endif
@@ -1,19 +1,27 @@
 #ifndef MESSAGE_HEADER_H_
 #define MESSAGE_HEADER_H_
+#include <cstdint>
 
 
-enum class MessageHeader : int
+// Sent as the first 8 bits of every message, the rest is bit packed with
+// BitWriter. Positions and velocities are quantized to the ranges set in
+// GameController, angles to 12 bits and identifiers are varints. Actor IDs
+// are the IDs of the actors on the host, clients map them to their own.
+enum class MessageHeader : std::uint8_t
 {
-	THIS_PLAYER_ID,				// unsigned long id of the receiver player
-	OTHER_PLAYER_ID,			// unsigned long id of a player who is not a receiver
+	THIS_PLAYER_ID,				// varint id of the receiver player
+	OTHER_PLAYER_ID,			// varint id of a player who is not a receiver
 
-	CREATE_MAP,					// unsigned int map seed
-	CREATE_PLAYER_SHIP,			// float x, float y, float rotation, unsigned long playerId, null terminated name
-	PLAYER_INPUT_EVENT,			// sf::Event event, unsigned long player ID
-	SET_ROTATION,				// float angle, unsigned long actor ID
-	SET_POSITION,				// sf::Vector2f position, unsigned long actor ID
-	SET_VELOCITY,				// sf::Vector2f position, unsigned long actor ID
-	DESTROY_ACTOR				// unsigned long actor ID
+	CREATE_MAP,					// 32 bit map seed
+	CREATE_PLAYER_SHIP,			// position x, position y, angle, varint playerId, name, varint actor ID
+	PLAYER_INPUT_EVENT,			// pressed bit, 7 bit key code, alt, control, shift, system bits, varint player ID, varint input sequence
+	SET_ROTATION,				// angle, varint actor ID
+	SET_POSITION,				// position x, position y, varint actor ID
+	SET_VELOCITY,				// velocity x, velocity y, varint actor ID
+	DESTROY_ACTOR,				// projectile bit, then varint actor ID, or varint player ID and varint shot of the projectile
+	STATE_SNAPSHOT,				// delta of replicated actor states (see SnapshotHistory), varint last applied input of the receiver, varint its age in ms, varint host time in ms
+	SNAPSHOT_ACK,				// varint sequence of the received snapshot
+	HOST_STATS					// varint mean and max tick time of the host in us, varint ticks, varint players, sent every second
 };
 
 
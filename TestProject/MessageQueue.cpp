@@ -0,0 +1,120 @@
+#include "MessageQueue.h"
+#include <thread>
+
+
+// Capacity is rounded up to a power of two
+MessageQueue::MessageQueue(std::size_t capacity)
+{
+	std::size_t cellCount = 2;
+	while (cellCount < capacity)
+		cellCount *= 2;
+	cellMask = cellCount - 1;
+
+	messages = std::make_unique<Message[]>(cellCount);
+	freeCells = std::make_unique<Cell[]>(cellCount);
+	for (std::size_t i = 0; i < cellCount; i++)
+		freeCells[i].sequence.store(i, std::memory_order_relaxed);
+
+	for (std::size_t i = 0; i < cellCount; i++)
+		releaseMessage(&messages[i]);
+}
+
+
+// Puts the node back into the ring of free nodes. Only called by the consumer.
+bool MessageQueue::releaseMessage(Message *message)
+{
+	std::size_t position = freeEnqueuePosition.load(std::memory_order_relaxed);
+	Cell *cell;
+	while (true)
+	{
+		cell = &freeCells[position & cellMask];
+		std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+
+		if (difference == 0)
+		{
+			if (freeEnqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+			return false;
+		else
+			position = freeEnqueuePosition.load(std::memory_order_relaxed);
+	}
+
+	cell->message = message;
+	cell->sequence.store(position + 1, std::memory_order_release);
+	return true;
+}
+
+
+// Takes a free node, returns nullptr if there is none
+MessageQueue::Message* MessageQueue::acquireMessage()
+{
+	std::size_t position = freeDequeuePosition.load(std::memory_order_relaxed);
+	Cell *cell;
+	while (true)
+	{
+		cell = &freeCells[position & cellMask];
+		std::size_t sequence = cell->sequence.load(std::memory_order_acquire);
+		auto difference = static_cast<std::ptrdiff_t>(sequence - (position + 1));
+
+		if (difference == 0)
+		{
+			if (freeDequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+				break;
+		}
+		else if (difference < 0)
+			return nullptr;
+		else
+			position = freeDequeuePosition.load(std::memory_order_relaxed);
+	}
+
+	Message *message = cell->message;
+	cell->sequence.store(position + cellMask + 1, std::memory_order_release);
+	return message;
+}
+
+
+void MessageQueue::push(unsigned long connectionId, const char *data, std::size_t size)
+{
+	// All nodes are waiting for the consumer
+	Message *message = acquireMessage();
+	while (message == nullptr)
+	{
+		std::this_thread::yield();
+		message = acquireMessage();
+	}
+
+	message->connectionId = connectionId;
+	message->data.assign(data, data + size);
+
+	message->next = pending.load(std::memory_order_relaxed);
+	while (pending.compare_exchange_weak(message->next, message, std::memory_order_release, std::memory_order_relaxed) == false)
+		;
+}
+
+
+// Recycles the messages of @batch and replaces them with all pending ones
+void MessageQueue::takeAll(Batch &batch)
+{
+	while (batch.first != nullptr)
+	{
+		Message *message = batch.first;
+		batch.first = message->next;
+
+		if (message->data.capacity() > maxKeptBufferSize)
+			std::vector<char>().swap(message->data);
+		releaseMessage(message);
+	}
+
+	// The pending stack holds the newest message first
+	Message *message = pending.exchange(nullptr, std::memory_order_acquire);
+	while (message != nullptr)
+	{
+		Message *next = message->next;
+		message->next = batch.first;
+		batch.first = message;
+		message = next;
+	}
+}
@@ -0,0 +1,80 @@
+#ifndef MESSAGE_QUEUE_H_
+#define MESSAGE_QUEUE_H_
+#include <atomic>
+#include <memory>
+#include <vector>
+#include <cstddef>
+
+
+// Lock-free queue passing messages from the network threads to the main
+// thread. Messages live in a fixed set of nodes whose buffers are reused,
+// so pushing doesn't allocate once the buffers have grown.
+//
+// Producers take a free node from a bounded ring (Vyukov's algorithm,
+// ABA safe through per cell sequence numbers), fill it and link it onto
+// a pending stack with one compare-and-swap. The consumer takes the whole
+// stack with a single exchange and gets it as a Batch, whose nodes return
+// to the ring on the next takeAll(). When all nodes are taken the
+// producers wait for the consumer.
+class MessageQueue
+{
+	public:
+		struct Message
+		{
+			Message *next = nullptr;
+			unsigned long connectionId = 0;
+			std::vector<char> data;
+		};
+
+		// Messages taken from the queue, in the order they were pushed
+		class Batch
+		{
+			friend class MessageQueue;
+			Message *first = nullptr;
+
+			public:
+				// Calls @handler(connectionId, data, size) for every message
+				template <typename Handler>
+				void forEach(Handler handler) const;
+		};
+
+	private:
+		struct Cell
+		{
+			std::atomic<std::size_t> sequence;
+			Message *message;
+		};
+
+		// Buffers bigger than this are released when their node is recycled
+		static const std::size_t maxKeptBufferSize = 16 * 1024;
+
+		std::unique_ptr<Message[]> messages;
+		std::unique_ptr<Cell[]> freeCells;
+		std::size_t cellMask;
+		std::atomic<std::size_t> freeEnqueuePosition{ 0 };
+		std::atomic<std::size_t> freeDequeuePosition{ 0 };
+
+		std::atomic<Message*> pending{ nullptr };
+
+		bool releaseMessage(Message *message);
+		Message* acquireMessage();
+
+	public:
+		MessageQueue(std::size_t capacity = 4096);
+		MessageQueue(const MessageQueue&) = delete;
+		MessageQueue& operator=(const MessageQueue&) = delete;
+
+		void push(unsigned long connectionId, const char *data, std::size_t size);
+		void takeAll(Batch &batch);
+};
+
+
+template <typename Handler>
+void MessageQueue::Batch::forEach(Handler handler) const
+{
+	for (Message *message = first; message != nullptr; message = message->next)
+		handler(message->connectionId, message->data.data(), message->data.size());
+}
+
+
+#endif
@@ -1,8 +1,23 @@
 #include "NetworkManager.h"
+#include <algorithm>
+#include <cstring>
+#include "Profiler.h"
 
 
 namespace Network
 {
+#ifdef _WIN32
+	namespace
+	{
+		// Small messages are sent at once instead of waiting for the ACK of the previous ones
+		void setNoDelay(SOCKET socket)
+		{
+			BOOL flag = TRUE;
+			setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, reinterpret_cast<const char*>(&flag), sizeof(flag));
+		}
+	}
+
+
 	void NetworkManager::connectionListenerTask()
 	{
 		while (true)
@@ -16,6 +31,7 @@ namespace Network
 			SOCKET connectionSocket = accept(managedSocket, nullptr, nullptr);
 			if (connectionSocket != INVALID_SOCKET)
 			{
+				setNoDelay(connectionSocket);
 				managerLock.lock();
 				connections.push_back(std::make_unique<Connection>());
 				auto &newConnection = *connections.back();
@@ -23,8 +39,10 @@ namespace Network
 				newConnection.socket = connectionSocket;
 				newConnection.identifier = IdSeed++;
 				newConnection.receiverThread = std::thread(&NetworkManager::receiverTask, this, &newConnection);
+				newConnection.senderThread = std::thread(&NetworkManager::senderTask, this, &newConnection);
 				newConnection.self = std::prev(connections.end());
 				newConnection.receiverThread.detach();
+				assignDatagramToken(newConnection);
 				managerLock.unlock();
 
 				if (onConnect != nullptr)
@@ -36,63 +54,187 @@ namespace Network
 
 	void NetworkManager::receiverTask(Connection *connection)
 	{
-		char buffer[200];
-		int bufferLength = 200;
+		RingBuffer &buffer = connection->receiveBuffer;
+		std::vector<char> scratch;		// holds messages wrapping around the buffer end
 		int iResult = 0;
 
 		do
 		{
-			iResult = recv(connection->socket, buffer, bufferLength, 0);
+			// Receive directly into the free space of the ring buffer
+			std::size_t regionSize = 0;
+			char *region = buffer.getWriteRegion(regionSize);
+
+			iResult = recv(connection->socket, region, static_cast<int>(regionSize), 0);
 			if (iResult > 0)
 			{
-				std::unique_lock<std::mutex> managerLock(managerBlockade);
-				if (onReceive != nullptr)
-					onReceive(connection->identifier, buffer, iResult);
+				buffer.commitWrite(iResult);
+				connection->bytesReceived += iResult;
+				if (dispatchMessages(*connection, scratch) == false)
+					break;
 			}
 
 		} while (iResult > 0);
 
+		unsigned long identifier = connection->identifier;
+
+		// Stop the sender before the connection goes away
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
-		closesocket(connection->socket);
-		connections.erase(connection->self);
+		if (connection->closing == false)
+			abortConnection(*connection);
+		managerLock.unlock();
+		connection->senderThread.join();
+
+		managerLock.lock();
+		eraseConnection(*connection);
 		managerLock.unlock();
 
 		if (onDisconnect != nullptr)
-			onDisconnect(connection->identifier);
+			onDisconnect(identifier);
 
 		cleanupConditional.notify_all();
 	}
 
 
-	NetworkManager::~NetworkManager()
+	// Writes the queued frames of the connection, up to maxGatheredFrames
+	// of them with a single WSASend(). The queue is not locked while sending.
+	void NetworkManager::senderTask(Connection *connection)
 	{
-		stopListening();
-		distonnectAll();
+		std::vector<WSABUF> buffers;
+		std::vector<Frame> frames;
 
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
-		while (connections.empty() == false)
-			cleanupConditional.wait(managerLock);
+		while (true)
+		{
+			while (connection->outgoingFrames.empty() && connection->closing == false)
+				connection->sendConditional.wait(managerLock);
+			if (connection->closing)
+				break;
+
+			std::size_t count = std::min(connection->outgoingFrames.size(), maxGatheredFrames);
+			frames.assign(connection->outgoingFrames.begin(), connection->outgoingFrames.begin() + count);
+			managerLock.unlock();
+
+			buffers.resize(count);
+			for (std::size_t i = 0; i < count; i++)
+			{
+				buffers[i].buf = const_cast<char*>(frames[i]->data());
+				buffers[i].len = static_cast<ULONG>(frames[i]->size());
+			}
+
+			// A blocking socket sends everything or fails
+			DWORD sent = 0;
+			int iResult = WSASend(connection->socket, buffers.data(), static_cast<DWORD>(count), &sent, 0, nullptr, nullptr);
+			connection->bytesSent += sent;
+
+			managerLock.lock();
+			for (std::size_t i = 0; i < count; i++)
+			{
+				connection->outgoingSize -= connection->outgoingFrames.front()->size();
+				connection->outgoingFrames.pop_front();
+			}
+			frames.clear();
+
+			if (iResult == SOCKET_ERROR)
+			{
+				if (connection->closing == false)
+					abortConnection(*connection);
+				break;
+			}
+		}
 	}
 
 
-	void NetworkManager::setOnConnect(std::function<void(unsigned long)> callback)
+	// Closes the socket, which ends both the receiver and the sender thread.
+	// Called with managerBlockade locked.
+	void NetworkManager::abortConnection(Connection &connection)
+	{
+		connection.closing = true;
+		closesocket(connection.socket);
+		connection.sendConditional.notify_all();
+	}
+
+
+	// Receives datagrams until the socket is closed
+	void NetworkManager::datagramReceiverTask()
+	{
+		char datagram[maxDatagramSize];
+
+		while (true)
+		{
+			sockaddr_storage source;
+			int sourceLength = sizeof(source);
+
+			int iResult = recvfrom(datagramSocket, datagram, sizeof(datagram), 0, reinterpret_cast<sockaddr*>(&source), &sourceLength);
+			if (iResult == SOCKET_ERROR)
+			{
+				// Reported after a datagram to a peer which is already gone
+				int error = WSAGetLastError();
+				if (error == WSAECONNRESET || error == WSAEMSGSIZE)
+					continue;
+				break;
+			}
+
+			onDatagram(datagram, iResult, source, sourceLength);
+		}
+	}
+
+
+	// Binds the socket of the unreliable channel, to any free port if port is nullptr
+	void NetworkManager::openDatagramSocket(const char *port)
 	{
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
-		onConnect = callback;
+		if (datagramSocket != INVALID_SOCKET)
+			return;
+
+		sockaddr_in address;
+		ZeroMemory(&address, sizeof(address));
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons(port != nullptr ? static_cast<u_short>(std::stoi(port)) : 0);
+
+		datagramSocket = socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP);
+		if (datagramSocket == INVALID_SOCKET)
+			throw std::runtime_error("Error at socket(): " + std::to_string(WSAGetLastError()));
+
+		if (bind(datagramSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+		{
+			int error = WSAGetLastError();
+			closesocket(datagramSocket);
+			datagramSocket = INVALID_SOCKET;
+			throw std::runtime_error("bind failed with error: " + std::to_string(error));
+		}
+
+		datagramReceiverThread = std::thread(&NetworkManager::datagramReceiverTask, this);
 	}
 
 
-	void NetworkManager::setOnDisconnect(std::function<void(unsigned long)> callback)
+	void NetworkManager::closeDatagramSocket()
 	{
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
-		onDisconnect = callback;
+		if (datagramSocket == INVALID_SOCKET)
+			return;
+
+		closesocket(datagramSocket);
+		managerLock.unlock();
+
+		datagramReceiverThread.join();
+
+		managerLock.lock();
+		datagramSocket = INVALID_SOCKET;
 	}
 
 
-	void NetworkManager::setOnReceive(std::function<void(unsigned long, const char*, int)> callback)
+	NetworkManager::~NetworkManager()
 	{
+		stopListening();
+		distonnectAll();
+
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
-		onReceive = callback;
+		while (connections.empty() == false)
+			cleanupConditional.wait(managerLock);
+		managerLock.unlock();
+
+		closeDatagramSocket();
 	}
 
 
@@ -144,6 +286,8 @@ namespace Network
 			throw std::runtime_error("listen failed with error: " + std::to_string(WSAGetLastError()));
 		}
 
+		openDatagramSocket(port.c_str());
+
 		managerLock.lock();
 		listeningAsServer = true;
 		managerLock.unlock();
@@ -211,17 +355,32 @@ namespace Network
 			break;
 		}
 
+		// Datagrams go to the same address and port as the connection
+		sockaddr_storage serverAddress;
+		socklen_t serverAddressLength = 0;
+		if (succeedToConnect)
+		{
+			serverAddressLength = static_cast<socklen_t>(ptr->ai_addrlen);
+			std::memcpy(&serverAddress, ptr->ai_addr, ptr->ai_addrlen);
+		}
+
 		freeaddrinfo(result);
 		if (succeedToConnect == false)
 			throw std::runtime_error("failed to connect with server " + server + " on port " + port);
 
+		openDatagramSocket(nullptr);
+		setNoDelay(clientSocket);
+
 		managerLock.lock();
 		connections.push_back(std::make_unique<Connection>());
 		auto &newConnection = *connections.back();
 
 		newConnection.socket = clientSocket;
+		newConnection.datagramAddress = serverAddress;
+		newConnection.datagramAddressLength = serverAddressLength;
 		newConnection.identifier = IdSeed++;
 		newConnection.receiverThread = std::thread(&NetworkManager::receiverTask, this, &newConnection);
+		newConnection.senderThread = std::thread(&NetworkManager::senderTask, this, &newConnection);
 		newConnection.self = std::prev(connections.end());
 		newConnection.receiverThread.detach();
 
@@ -235,9 +394,10 @@ namespace Network
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
 		for (auto &connection : connections)
 		{
-			if (connection->identifier)
+			if (connection->identifier == connectionId)
 			{
-				closesocket(connection->socket);
+				if (connection->closing == false)
+					abortConnection(*connection);
 				return;
 			}
 		}
@@ -249,13 +409,253 @@ namespace Network
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
 
 		for (auto &connection : connections)
-			closesocket(connection->socket);
-		IdSeed = 0;
+		{
+			if (connection->closing == false)
+				abortConnection(*connection);
+		}
+
+		// Identifiers start over once the receiver threads erase all connections
+		if (connections.empty())
+			IdSeed = 0;
+		else
+			resetIdSeed = true;
 
 		managerLock.unlock();
 	}
 
 
+	// Queues the frame for the sender thread. Called with managerBlockade locked.
+	bool NetworkManager::sendFrame(Connection &connection, const Frame &frame)
+	{
+		if (connection.closing)
+			return false;
+
+		if (queueFrame(connection, frame) == false)
+		{
+			abortConnection(connection);
+			return false;
+		}
+
+		connection.sendConditional.notify_one();
+		return true;
+	}
+#endif
+
+
+	// Passes all complete messages from the receive buffer to onReceive().
+	// Returns false if the peer sent a frame which can never fit into the buffer.
+	bool NetworkManager::dispatchMessages(Connection &connection, std::vector<char> &scratch)
+	{
+		PROFILE_SCOPE("NetworkManager::dispatchMessages");
+		RingBuffer &buffer = connection.receiveBuffer;
+		std::unique_lock<std::mutex> receiveLock(receiveBlockade);
+
+		while (buffer.getReadableSize() >= sizeof(FrameLength))
+		{
+			FrameLength length = 0;
+			buffer.peek(reinterpret_cast<char*>(&length), sizeof(FrameLength));
+
+			bool controlFrame = (length & controlFrameFlag) != 0;
+			length &= ~controlFrameFlag;
+			if (length > maxMessageSize)
+				return false;
+
+			if (buffer.getReadableSize() < sizeof(FrameLength) + length)
+				break;
+			buffer.consume(sizeof(FrameLength));
+
+			const char *message = buffer.getReadRegion();
+			if (buffer.getContiguousReadableSize() < length)
+			{
+				scratch.resize(length);
+				buffer.peek(scratch.data(), length);
+				message = scratch.data();
+			}
+
+			if (controlFrame)
+				onControlFrame(connection, message, length);
+			else if (onReceive != nullptr)
+				onReceive(connection.identifier, message, static_cast<int>(length));
+			buffer.consume(length);
+		}
+
+		return true;
+	}
+
+
+	NetworkManager::Frame NetworkManager::buildFrame(const void *data, std::size_t dataSize, FrameLength flags)
+	{
+		if (dataSize > maxMessageSize)
+			throw std::runtime_error("message of " + std::to_string(dataSize) + " bytes exceeds the frame limit");
+
+		auto frame = std::make_shared<std::vector<char>>(sizeof(FrameLength) + dataSize);
+		FrameLength length = static_cast<FrameLength>(dataSize) | flags;
+		std::memcpy(frame->data(), &length, sizeof(FrameLength));
+		if (dataSize > 0)
+			std::memcpy(frame->data() + sizeof(FrameLength), data, dataSize);
+
+		return frame;
+	}
+
+
+	// Adds the frame to the outgoing queue of the connection. Returns false
+	// if the peer doesn't keep up, the frame is not queued then.
+	// Called with managerBlockade locked.
+	bool NetworkManager::queueFrame(Connection &connection, const Frame &frame)
+	{
+		if (connection.outgoingSize + frame->size() > maxQueuedOutputSize)
+			return false;
+
+		connection.outgoingFrames.push_back(frame);
+		connection.outgoingSize += frame->size();
+		return true;
+	}
+
+
+	// Removes the closed connection. Identifiers start over from 0 when it
+	// was the last one to go after distonnectAll(), not earlier, so that
+	// a connection still open can't share an identifier with a new one.
+	// Called with managerBlockade locked.
+	void NetworkManager::eraseConnection(Connection &connection)
+	{
+		datagramConnections.erase(connection.datagramToken);
+		connections.erase(connection.self);
+
+		if (connections.empty() && resetIdSeed)
+		{
+			IdSeed = 0;
+			resetIdSeed = false;
+		}
+	}
+
+
+	// Gives an accepted connection its token of the unreliable channel.
+	// Called by the host with managerBlockade locked.
+	void NetworkManager::assignDatagramToken(Connection &connection)
+	{
+		std::uint64_t token = 0;
+		while (token == 0 || datagramConnections.count(token) != 0)
+			token = tokenGenerator();
+
+		connection.datagramToken = token;
+		datagramConnections[token] = &connection;
+		sendFrame(connection, buildFrame(&token, sizeof(token), controlFrameFlag));
+	}
+
+
+	// Client side: stores the token received from the host and sends a few
+	// empty datagrams, so that the host learns the address they come from
+	void NetworkManager::onControlFrame(Connection &connection, const char *data, std::size_t dataSize)
+	{
+		std::uint64_t token = 0;
+		if (dataSize < sizeof(token))
+			return;
+		std::memcpy(&token, data, sizeof(token));
+
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		datagramConnections.erase(connection.datagramToken);
+		connection.datagramToken = token;
+		datagramConnections[token] = &connection;
+
+		for (int i = 0; i < 3; i++)
+			sendDatagram(connection, nullptr, 0, 0);
+	}
+
+
+	// Datagrams start with the token of their connection, the stream and a sequence
+	// number. Only datagrams newer than the last one received on the same stream
+	// are passed to onReceive(). Sequences are compared with serial number
+	// arithmetic, so they may wrap around.
+	void NetworkManager::onDatagram(const char *data, std::size_t dataSize, const sockaddr_storage &source, socklen_t sourceLength)
+	{
+		PROFILE_SCOPE("NetworkManager::onDatagram");
+		if (dataSize < datagramHeaderSize)
+			return;
+
+		std::uint64_t token = 0;
+		std::uint32_t stream = 0;
+		std::uint32_t sequence = 0;
+		std::memcpy(&token, data, sizeof(token));
+		std::memcpy(&stream, data + sizeof(token), sizeof(stream));
+		std::memcpy(&sequence, data + sizeof(token) + sizeof(stream), sizeof(sequence));
+
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		auto found = datagramConnections.find(token);
+		if (found == datagramConnections.end())
+			return;
+
+		Connection &connection = *found->second;
+		auto received = connection.receivedDatagrams.find(stream);
+		if (received == connection.receivedDatagrams.end())
+			connection.receivedDatagrams.emplace(stream, sequence);
+		else if (static_cast<std::int32_t>(sequence - received->second) > 0)
+			received->second = sequence;
+		else
+			return;
+
+		connection.datagramAddress = source;
+		connection.datagramAddressLength = sourceLength;
+		connection.bytesReceived += dataSize;
+		unsigned long identifier = connection.identifier;
+		managerLock.unlock();
+
+		if (dataSize == datagramHeaderSize)
+			return;
+
+		std::unique_lock<std::mutex> receiveLock(receiveBlockade);
+		if (onReceive != nullptr)
+			onReceive(identifier, data + datagramHeaderSize, static_cast<int>(dataSize - datagramHeaderSize));
+	}
+
+
+	// Returns false if the message has to go through the connection instead.
+	// Called with managerBlockade locked.
+	bool NetworkManager::sendDatagram(Connection &connection, const void *data, std::size_t dataSize, std::uint32_t stream)
+	{
+		if (datagramSocket == INVALID_SOCKET || connection.datagramToken == 0 || connection.datagramAddressLength == 0)
+			return false;
+		if (dataSize > maxUnreliableMessageSize)
+			return false;
+
+		std::uint32_t sequence = ++connection.sentDatagrams[stream];
+		datagramBuffer.resize(datagramHeaderSize + dataSize);
+		std::memcpy(datagramBuffer.data(), &connection.datagramToken, sizeof(std::uint64_t));
+		std::memcpy(datagramBuffer.data() + sizeof(std::uint64_t), &stream, sizeof(stream));
+		std::memcpy(datagramBuffer.data() + sizeof(std::uint64_t) + sizeof(stream), &sequence, sizeof(sequence));
+		if (dataSize > 0)
+			std::memcpy(datagramBuffer.data() + datagramHeaderSize, data, dataSize);
+
+		// A lost datagram is not an error of the connection
+		auto address = reinterpret_cast<const sockaddr*>(&connection.datagramAddress);
+		int iResult = sendto(datagramSocket, datagramBuffer.data(), static_cast<int>(datagramBuffer.size()), 0, address, connection.datagramAddressLength);
+		if (iResult > 0)
+			connection.bytesSent += iResult;
+
+		return true;
+	}
+
+
+	void NetworkManager::setOnConnect(std::function<void(unsigned long)> callback)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		onConnect = callback;
+	}
+
+
+	void NetworkManager::setOnDisconnect(std::function<void(unsigned long)> callback)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		onDisconnect = callback;
+	}
+
+
+	void NetworkManager::setOnReceive(std::function<void(unsigned long, const char*, int)> callback)
+	{
+		std::unique_lock<std::mutex> receiveLock(receiveBlockade);
+		onReceive = callback;
+	}
+
+
 	std::list<unsigned long> NetworkManager::getConnections() const
 	{
 		std::list<unsigned long> result;
@@ -275,26 +675,74 @@ namespace Network
 	}
 
 
-	void NetworkManager::send(unsigned long connectionId, void *data, std::size_t dataSize)
+	bool NetworkManager::getConnectionStats(unsigned long connectionId, ConnectionStats &stats) const
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		for (auto &connection : connections)
+		{
+			if (connection->identifier == connectionId)
+			{
+				stats.bytesSent = connection->bytesSent;
+				stats.bytesReceived = connection->bytesReceived;
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+
+	void NetworkManager::send(unsigned long connectionId, const void *data, std::size_t dataSize)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		for (auto &connection : connections)
+		{
+			if (connection->identifier == connectionId)
+			{
+				sendFrame(*connection, buildFrame(data, dataSize));
+				return;
+			}
+		}
+	}
+
+
+	void NetworkManager::sendToAll(const void *data, std::size_t dataSize)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		if (connections.empty())
+			return;
+
+		Frame frame = buildFrame(data, dataSize);
+		for (auto &connection : connections)
+			sendFrame(*connection, frame);
+	}
+
+
+	// Sends the message as a datagram, which may be lost, duplicated or
+	// dropped for arriving after a newer one of the same @stream. Falls back
+	// to the connection while the unreliable channel isn't set up yet.
+	void NetworkManager::sendUnreliable(unsigned long connectionId, const void *data, std::size_t dataSize, std::uint32_t stream)
 	{
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
 		for (auto &connection : connections)
 		{
 			if (connection->identifier == connectionId)
 			{
-				int iResult = ::send(connection->socket, static_cast<const char*>(data), dataSize, 0);
+				if (sendDatagram(*connection, data, dataSize, stream) == false)
+					sendFrame(*connection, buildFrame(data, dataSize));
 				return;
 			}
 		}
 	}
 
 
-	void NetworkManager::sendToAll(void *data, std::size_t dataSize)
+	void NetworkManager::sendToAllUnreliable(const void *data, std::size_t dataSize, std::uint32_t stream)
 	{
 		std::unique_lock<std::mutex> managerLock(managerBlockade);
 		for (auto &connection : connections)
 		{
-			int iResult = ::send(connection->socket, static_cast<const char*>(data), dataSize, 0);
+			if (sendDatagram(*connection, data, dataSize, stream) == false)
+				sendFrame(*connection, buildFrame(data, dataSize));
 		}
 	}
 }
\ No newline at end of file
@@ -1,6 +1,7 @@
 #ifndef NETWORK_MANAGER_H_
 #define NETWORK_MANAGER_H_
 
+#ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
 #endif
@@ -10,38 +11,139 @@
 #include <ws2tcpip.h>
 #include <iphlpapi.h>
 #pragma comment(lib, "Ws2_32.lib")
+#else
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netdb.h>
+#endif
 
 #include <string>
 #include <stdexcept>
 #include <thread>
 #include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <memory>
 #include <list>
+#include <deque>
+#include <vector>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
 #include <functional>
+#include "RingBuffer.h"
 
 
 namespace Network
 {
+#ifndef _WIN32
+	using SOCKET = int;
+	const SOCKET INVALID_SOCKET = -1;
+	const int SOCKET_ERROR = -1;
+#endif
+
+
+	// On Windows every connection has its own receiver thread. On Linux all
+	// sockets are non-blocking and served by a single epoll reactor thread.
+	//
+	// Messages are sent as frames prefixed with their length, so that
+	// onReceive() is always called with exactly one complete message
+	//
+	// Sending never blocks the caller: frames are queued per connection and
+	// written by the network threads, many at once with scatter/gather I/O.
+	// A connection whose queue exceeds maxQueuedOutputSize is disconnected.
+	//
+	// Besides the TCP connection each peer has an unreliable channel - a UDP
+	// socket on the same port. The host gives every connection a random token
+	// through a control frame; datagrams carry the token, a stream chosen by
+	// the sender and a sequence number of the stream. Datagrams older than
+	// the newest one received on their stream are dropped, so that updates
+	// of one kind don't make the other ones look stale.
+	// Until the channel is ready unreliable messages go through TCP.
 	class NetworkManager
 	{
+		public:
+			using FrameLength = std::uint32_t;
+			static const std::size_t receiveBufferSize = 1 << 16;
+			static const std::size_t maxMessageSize = receiveBufferSize - sizeof(FrameLength);
+			static const std::size_t maxQueuedOutputSize = 1 << 20;	// peers slower than this are dropped
+			static const std::size_t maxGatheredFrames = 64;		// frames written by one system call
+
+			static const std::size_t maxDatagramSize = 1200;	// stays below common MTU
+			static const std::size_t datagramHeaderSize = sizeof(std::uint64_t) + 2 * sizeof(std::uint32_t);
+			static const std::size_t maxUnreliableMessageSize = maxDatagramSize - datagramHeaderSize;
+
+			// Bytes transferred through a connection since it was established, framing included
+			struct ConnectionStats
+			{
+				std::uint64_t bytesSent = 0;
+				std::uint64_t bytesReceived = 0;
+			};
+
 		private:
 			struct Connection;
+			using Frame = std::shared_ptr<const std::vector<char>>;	// shared by queues of all receivers
 			unsigned long IdSeed = 0;
+			bool resetIdSeed = false;		// set by distonnectAll() until the last connection is erased
 
 			addrinfo *result = nullptr;
 			SOCKET managedSocket = INVALID_SOCKET;
 
 			mutable std::mutex managerBlockade;
+			std::mutex receiveBlockade;			// held while onReceive() runs, so it may use the manager
 			mutable std::condition_variable cleanupConditional;
 			std::list<std::unique_ptr<Connection>> connections;
 			bool listeningAsServer = false;
 
+			// Unreliable channel
+			static const FrameLength controlFrameFlag = 0x80000000;		// set in length of frames carrying the token
+			SOCKET datagramSocket = INVALID_SOCKET;
+			std::unordered_map<std::uint64_t, Connection*> datagramConnections;	// by token
+			std::vector<char> datagramBuffer;	// outgoing datagram, guarded by managerBlockade
+			std::mt19937_64 tokenGenerator{ std::random_device()() };
+
 			std::function<void(unsigned long)> onConnect = nullptr;
 			std::function<void(unsigned long)> onDisconnect = nullptr;
 			std::function<void(unsigned long, const char*, int)> onReceive = nullptr;
 			
+#ifdef _WIN32
 			std::thread connectionListenerThread;
+			std::thread datagramReceiverThread;
 			void connectionListenerTask();
 			void receiverTask(Connection *connection);
+			void senderTask(Connection *connection);
+			void abortConnection(Connection &connection);
+			void datagramReceiverTask();
+#else
+			int epollDescriptor = -1;
+			int wakeupDescriptor = -1;		// eventfd used to stop the reactor
+			bool reactorRunning = false;
+			std::thread reactorThread;
+
+			void startReactor();
+			void stopReactor();
+			void reactorTask();
+			void acceptConnections();
+			unsigned long registerConnection(SOCKET socket, const sockaddr_storage *serverAddress, socklen_t serverAddressLength);
+			bool receiveData(Connection &connection, std::vector<char> &scratch);
+			void receiveDatagrams();
+			bool flushOutput(Connection &connection);
+			void closeConnection(Connection *connection);
+#endif
+			void openDatagramSocket(const char *port);
+			void closeDatagramSocket();
+
+			bool dispatchMessages(Connection &connection, std::vector<char> &scratch);
+			Frame buildFrame(const void *data, std::size_t dataSize, FrameLength flags = 0);
+			bool queueFrame(Connection &connection, const Frame &frame);
+			void eraseConnection(Connection &connection);
+			bool sendFrame(Connection &connection, const Frame &frame);
+
+			void assignDatagramToken(Connection &connection);
+			void onControlFrame(Connection &connection, const char *data, std::size_t dataSize);
+			void onDatagram(const char *data, std::size_t dataSize, const sockaddr_storage &source, socklen_t sourceLength);
+			bool sendDatagram(Connection &connection, const void *data, std::size_t dataSize, std::uint32_t stream);
 
 		public:
 			~NetworkManager();
@@ -59,9 +161,12 @@ namespace Network
 
 			std::list<unsigned long> getConnections() const;
 			std::size_t getConnectionsCount() const;
+			bool getConnectionStats(unsigned long connectionId, ConnectionStats &stats) const;
 
-			void send(unsigned long connectionId, void *data, std::size_t dataSize);
-			void sendToAll(void *data, std::size_t dataSize);
+			void send(unsigned long connectionId, const void *data, std::size_t dataSize);
+			void sendToAll(const void *data, std::size_t dataSize);
+			void sendUnreliable(unsigned long connectionId, const void *data, std::size_t dataSize, std::uint32_t stream = 0);
+			void sendToAllUnreliable(const void *data, std::size_t dataSize, std::uint32_t stream = 0);
 	};
 
 
@@ -69,8 +174,28 @@ namespace Network
 	{
 		unsigned long identifier;
 		SOCKET socket;
+#ifdef _WIN32
 		std::thread receiverThread;
+		std::thread senderThread;
+		std::condition_variable sendConditional;	// signalled when frames are queued or the connection closes
+		bool closing = false;
+#endif
 		std::list<std::unique_ptr<Connection>>::iterator self;
+		RingBuffer receiveBuffer = RingBuffer(receiveBufferSize);
+		std::atomic<std::uint64_t> bytesSent{ 0 };
+		std::atomic<std::uint64_t> bytesReceived{ 0 };
+
+		// Frames waiting for the network thread, guarded by managerBlockade
+		std::deque<Frame> outgoingFrames;
+		std::size_t outgoingOffset = 0;		// bytes of the first frame already sent
+		std::size_t outgoingSize = 0;		// bytes of all queued frames
+
+		// Unreliable channel, guarded by managerBlockade
+		std::uint64_t datagramToken = 0;		// 0 until the host assigns one
+		sockaddr_storage datagramAddress;
+		socklen_t datagramAddressLength = 0;	// 0 until the peer address is known
+		std::unordered_map<std::uint32_t, std::uint32_t> sentDatagrams;		// last sequence sent on each stream
+		std::unordered_map<std::uint32_t, std::uint32_t> receivedDatagrams;	// newest sequence received on each stream
 	};
 }
 
@@ -0,0 +1,594 @@
+#include "NetworkManager.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+
+namespace Network
+{
+	namespace
+	{
+		std::string lastError()
+		{
+			return std::strerror(errno);
+		}
+
+
+		bool setNonBlocking(SOCKET socket)
+		{
+			int flags = fcntl(socket, F_GETFL, 0);
+			return flags != -1 && fcntl(socket, F_SETFL, flags | O_NONBLOCK) != -1;
+		}
+
+
+		// Small messages are sent at once instead of waiting for the ACK of the previous ones
+		void setNoDelay(SOCKET socket)
+		{
+			int flag = 1;
+			setsockopt(socket, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+		}
+	}
+
+
+	// Creates the epoll instance and starts the reactor thread if not running yet
+	void NetworkManager::startReactor()
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		if (reactorRunning == true)
+			return;
+
+		epollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+		if (epollDescriptor == -1)
+			throw std::runtime_error("epoll_create1 failed: " + lastError());
+
+		wakeupDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (wakeupDescriptor == -1)
+		{
+			close(epollDescriptor);
+			throw std::runtime_error("eventfd failed: " + lastError());
+		}
+
+		// The reactor is woken up through the eventfd tagged with the manager itself
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.ptr = this;
+		epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, wakeupDescriptor, &event);
+
+		reactorRunning = true;
+		reactorThread = std::thread(&NetworkManager::reactorTask, this);
+	}
+
+
+	void NetworkManager::stopReactor()
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		if (reactorRunning == false)
+			return;
+
+		reactorRunning = false;
+		std::uint64_t value = 1;
+		write(wakeupDescriptor, &value, sizeof(value));
+		managerLock.unlock();
+
+		reactorThread.join();
+		close(wakeupDescriptor);
+		close(epollDescriptor);
+		wakeupDescriptor = epollDescriptor = -1;
+	}
+
+
+	// Events are tagged with the listening socket (nullptr), the wakeup
+	// eventfd (this), the datagram socket (&datagramSocket) or the connection
+	// they belong to. Connections are only erased by this thread, after all
+	// events of a single epoll_wait() call are handled.
+	void NetworkManager::reactorTask()
+	{
+		std::vector<epoll_event> events(64);
+		std::vector<Connection*> closedConnections;
+		std::vector<char> scratch;		// holds messages wrapping around the receive buffer end
+
+		while (true)
+		{
+			int count = epoll_wait(epollDescriptor, events.data(), static_cast<int>(events.size()), -1);
+			if (count == -1)
+			{
+				if (errno == EINTR)
+					continue;
+				break;
+			}
+
+			bool stopRequested = false;
+			for (int i = 0; i < count; i++)
+			{
+				void *tag = events[i].data.ptr;
+				if (tag == this)
+				{
+					std::uint64_t value;
+					read(wakeupDescriptor, &value, sizeof(value));
+
+					std::unique_lock<std::mutex> managerLock(managerBlockade);
+					stopRequested = (reactorRunning == false);
+					continue;
+				}
+
+				if (tag == nullptr)
+				{
+					acceptConnections();
+					continue;
+				}
+
+				if (tag == &datagramSocket)
+				{
+					receiveDatagrams();
+					continue;
+				}
+
+				Connection *connection = static_cast<Connection*>(tag);
+				bool open = true;
+
+				if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+					open = receiveData(*connection, scratch);
+				if (open && (events[i].events & EPOLLOUT))
+					open = flushOutput(*connection);
+
+				if (open == false)
+					closedConnections.push_back(connection);
+			}
+
+			for (auto connection : closedConnections)
+				closeConnection(connection);
+			closedConnections.clear();
+
+			if (stopRequested)
+				break;
+		}
+	}
+
+
+	void NetworkManager::acceptConnections()
+	{
+		std::vector<unsigned long> accepted;
+
+		while (true)
+		{
+			std::unique_lock<std::mutex> managerLock(managerBlockade);
+			if (listeningAsServer == false)
+				break;
+
+			SOCKET connectionSocket = accept4(managedSocket, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+			managerLock.unlock();
+
+			if (connectionSocket == INVALID_SOCKET)
+			{
+				if (errno == EINTR || errno == ECONNABORTED)
+					continue;
+				break;
+			}
+
+			accepted.push_back(registerConnection(connectionSocket, nullptr, 0));
+		}
+
+		if (onConnect != nullptr)
+		{
+			for (auto identifier : accepted)
+				onConnect(identifier);
+		}
+	}
+
+
+	// Connections to the server know its datagram address, accepted
+	// connections (serverAddress == nullptr) get their token right away
+	unsigned long NetworkManager::registerConnection(SOCKET socket, const sockaddr_storage *serverAddress, socklen_t serverAddressLength)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		connections.push_back(std::make_unique<Connection>());
+		auto &newConnection = *connections.back();
+
+		setNoDelay(socket);
+		newConnection.socket = socket;
+		newConnection.identifier = IdSeed++;
+		newConnection.self = std::prev(connections.end());
+		if (serverAddress != nullptr)
+		{
+			newConnection.datagramAddress = *serverAddress;
+			newConnection.datagramAddressLength = serverAddressLength;
+		}
+
+		epoll_event event = {};
+		event.events = EPOLLIN | EPOLLRDHUP;
+		event.data.ptr = &newConnection;
+		epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, socket, &event);
+
+		if (serverAddress == nullptr)
+			assignDatagramToken(newConnection);
+
+		return newConnection.identifier;
+	}
+
+
+	// Reads everything the socket has. Returns false when the connection should be closed.
+	bool NetworkManager::receiveData(Connection &connection, std::vector<char> &scratch)
+	{
+		RingBuffer &buffer = connection.receiveBuffer;
+
+		while (true)
+		{
+			std::size_t regionSize = 0;
+			char *region = buffer.getWriteRegion(regionSize);
+
+			ssize_t received = recv(connection.socket, region, regionSize, 0);
+			if (received > 0)
+			{
+				buffer.commitWrite(received);
+				connection.bytesReceived += received;
+				if (dispatchMessages(connection, scratch) == false)
+					return false;
+			}
+			else if (received == 0)
+				return false;
+			else if (errno == EAGAIN || errno == EWOULDBLOCK)
+				return true;
+			else if (errno != EINTR)
+				return false;
+		}
+	}
+
+
+	void NetworkManager::receiveDatagrams()
+	{
+		char datagram[maxDatagramSize];
+
+		while (true)
+		{
+			sockaddr_storage source;
+			socklen_t sourceLength = sizeof(source);
+
+			ssize_t received = recvfrom(datagramSocket, datagram, sizeof(datagram), 0, reinterpret_cast<sockaddr*>(&source), &sourceLength);
+			if (received >= 0)
+				onDatagram(datagram, received, source, sourceLength);
+			else if (errno != EINTR && errno != ECONNREFUSED)
+				return;
+		}
+	}
+
+
+	// Writes the queued frames, gathering up to maxGatheredFrames of them
+	// into one sendmsg() call. Stops watching for writability once
+	// everything is sent.
+	bool NetworkManager::flushOutput(Connection &connection)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		auto &frames = connection.outgoingFrames;
+		iovec buffers[maxGatheredFrames];
+
+		while (frames.empty() == false)
+		{
+			std::size_t count = std::min(frames.size(), maxGatheredFrames);
+			for (std::size_t i = 0; i < count; i++)
+			{
+				std::size_t offset = i == 0 ? connection.outgoingOffset : 0;
+				buffers[i].iov_base = const_cast<char*>(frames[i]->data() + offset);
+				buffers[i].iov_len = frames[i]->size() - offset;
+			}
+
+			msghdr message = {};
+			message.msg_iov = buffers;
+			message.msg_iovlen = count;
+
+			ssize_t result = sendmsg(connection.socket, &message, MSG_NOSIGNAL);
+			if (result < 0)
+			{
+				if (errno == EAGAIN || errno == EWOULDBLOCK)
+					break;
+				if (errno == EINTR)
+					continue;
+				return false;
+			}
+			connection.bytesSent += result;
+
+			// Drop the frames sent completely, remember how much of the next one went out
+			std::size_t sent = static_cast<std::size_t>(result);
+			while (sent > 0)
+			{
+				std::size_t remaining = frames.front()->size() - connection.outgoingOffset;
+				if (sent < remaining)
+				{
+					connection.outgoingOffset += sent;
+					break;
+				}
+
+				sent -= remaining;
+				connection.outgoingSize -= frames.front()->size();
+				connection.outgoingOffset = 0;
+				frames.pop_front();
+			}
+		}
+
+		if (frames.empty())
+		{
+			epoll_event event = {};
+			event.events = EPOLLIN | EPOLLRDHUP;
+			event.data.ptr = &connection;
+			epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, connection.socket, &event);
+		}
+
+		return true;
+	}
+
+
+	void NetworkManager::closeConnection(Connection *connection)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		unsigned long identifier = connection->identifier;
+
+		epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, connection->socket, nullptr);
+		close(connection->socket);
+		eraseConnection(*connection);
+		managerLock.unlock();
+
+		if (onDisconnect != nullptr)
+			onDisconnect(identifier);
+
+		cleanupConditional.notify_all();
+	}
+
+
+	// Binds the socket of the unreliable channel, to any free port if port is nullptr
+	void NetworkManager::openDatagramSocket(const char *port)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		if (datagramSocket != INVALID_SOCKET)
+			return;
+
+		sockaddr_in address = {};
+		address.sin_family = AF_INET;
+		address.sin_addr.s_addr = htonl(INADDR_ANY);
+		address.sin_port = htons(port != nullptr ? static_cast<std::uint16_t>(std::stoi(port)) : 0);
+
+		datagramSocket = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_UDP);
+		if (datagramSocket == INVALID_SOCKET)
+			throw std::runtime_error("Error at socket(): " + lastError());
+
+		if (bind(datagramSocket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == SOCKET_ERROR)
+		{
+			std::string error = lastError();
+			close(datagramSocket);
+			datagramSocket = INVALID_SOCKET;
+			throw std::runtime_error("bind failed with error: " + error);
+		}
+
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.ptr = &datagramSocket;
+		epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, datagramSocket, &event);
+	}
+
+
+	void NetworkManager::closeDatagramSocket()
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		if (datagramSocket == INVALID_SOCKET)
+			return;
+
+		epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, datagramSocket, nullptr);
+		close(datagramSocket);
+		datagramSocket = INVALID_SOCKET;
+	}
+
+
+	NetworkManager::~NetworkManager()
+	{
+		stopListening();
+		distonnectAll();
+
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		while (connections.empty() == false)
+			cleanupConditional.wait(managerLock);
+		managerLock.unlock();
+
+		stopReactor();
+		closeDatagramSocket();
+	}
+
+
+	void NetworkManager::startListening(std::string port)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		if (listeningAsServer == true)
+			return;
+		managerLock.unlock();
+
+		startReactor();
+
+		addrinfo hints = {};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+		hints.ai_flags = AI_PASSIVE;
+
+		// Resolve the local address and port to be used by the server
+		int iResult = getaddrinfo(nullptr, port.c_str(), &hints, &result);
+		if (iResult != 0)
+			throw std::runtime_error("getaddrinfo failed: " + std::string(gai_strerror(iResult)));
+
+		// Create a non-blocking socket for accepting clients
+		managedSocket = socket(result->ai_family, result->ai_socktype | SOCK_NONBLOCK | SOCK_CLOEXEC, result->ai_protocol);
+		if (managedSocket == INVALID_SOCKET)
+		{
+			freeaddrinfo(result);
+			throw std::runtime_error("Error at socket(): " + lastError());
+		}
+
+		// Allow restarting the host right after it was closed
+		int reuse = 1;
+		setsockopt(managedSocket, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+		// Setup the TCP listening socket
+		if (bind(managedSocket, result->ai_addr, result->ai_addrlen) == SOCKET_ERROR)
+		{
+			std::string error = lastError();
+			freeaddrinfo(result);
+			close(managedSocket);
+			managedSocket = INVALID_SOCKET;
+			throw std::runtime_error("bind failed with error: " + error);
+		}
+
+		if (listen(managedSocket, SOMAXCONN) == SOCKET_ERROR)
+		{
+			std::string error = lastError();
+			freeaddrinfo(result);
+			close(managedSocket);
+			managedSocket = INVALID_SOCKET;
+			throw std::runtime_error("listen failed with error: " + error);
+		}
+
+		openDatagramSocket(port.c_str());
+
+		managerLock.lock();
+		listeningAsServer = true;
+
+		epoll_event event = {};
+		event.events = EPOLLIN;
+		event.data.ptr = nullptr;
+		epoll_ctl(epollDescriptor, EPOLL_CTL_ADD, managedSocket, &event);
+	}
+
+
+	void NetworkManager::stopListening()
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		if (listeningAsServer == false)
+			return;
+
+		epoll_ctl(epollDescriptor, EPOLL_CTL_DEL, managedSocket, nullptr);
+		close(managedSocket);
+		freeaddrinfo(result);
+		managedSocket = INVALID_SOCKET;
+
+		listeningAsServer = false;
+	}
+
+
+	void NetworkManager::connectAsClient(std::string server, std::string port)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		if (listeningAsServer == true)
+			return;
+		managerLock.unlock();
+
+		startReactor();
+
+		addrinfo *ptr = nullptr, hints = {};
+		hints.ai_family = AF_INET;
+		hints.ai_socktype = SOCK_STREAM;
+		hints.ai_protocol = IPPROTO_TCP;
+
+		// Resolve the server address and port
+		int iResult = getaddrinfo(server.c_str(), port.c_str(), &hints, &result);
+		if (iResult != 0)
+			throw std::runtime_error("getaddrinfo failed with error: " + std::string(gai_strerror(iResult)));
+
+		// Attempt to connect to an address until one succeeds
+		SOCKET clientSocket = INVALID_SOCKET;
+		sockaddr_storage serverAddress;
+		socklen_t serverAddressLength = 0;
+		for (ptr = result; ptr != nullptr; ptr = ptr->ai_next)
+		{
+			clientSocket = socket(ptr->ai_family, ptr->ai_socktype | SOCK_CLOEXEC, ptr->ai_protocol);
+			if (clientSocket == INVALID_SOCKET)
+			{
+				freeaddrinfo(result);
+				throw std::runtime_error("socket failed with error: " + lastError());
+			}
+
+			// Connect while still blocking, the reactor takes over afterwards
+			if (connect(clientSocket, ptr->ai_addr, ptr->ai_addrlen) == 0 && setNonBlocking(clientSocket))
+			{
+				// Datagrams go to the same address and port as the connection
+				serverAddressLength = ptr->ai_addrlen;
+				std::memcpy(&serverAddress, ptr->ai_addr, ptr->ai_addrlen);
+				break;
+			}
+
+			close(clientSocket);
+			clientSocket = INVALID_SOCKET;
+		}
+
+		freeaddrinfo(result);
+		if (clientSocket == INVALID_SOCKET)
+			throw std::runtime_error("failed to connect with server " + server + " on port " + port);
+
+		openDatagramSocket(nullptr);
+
+		unsigned long identifier = registerConnection(clientSocket, &serverAddress, serverAddressLength);
+		if (onConnect != nullptr)
+			onConnect(identifier);
+	}
+
+
+	// Connections are only shut down here, the reactor closes them once it notices
+	void NetworkManager::disconnect(unsigned long connectionId)
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+		for (auto &connection : connections)
+		{
+			if (connection->identifier == connectionId)
+			{
+				shutdown(connection->socket, SHUT_RDWR);
+				return;
+			}
+		}
+	}
+
+
+	void NetworkManager::distonnectAll()
+	{
+		std::unique_lock<std::mutex> managerLock(managerBlockade);
+
+		for (auto &connection : connections)
+			shutdown(connection->socket, SHUT_RDWR);
+
+		// Identifiers start over once the reactor closes all connections
+		if (connections.empty())
+			IdSeed = 0;
+		else
+			resetIdSeed = true;
+	}
+
+
+	// Queues the frame for the reactor, which starts watching the socket
+	// for writability when the queue stops being empty. Peers which don't
+	// keep up are shut down. Called with managerBlockade locked.
+	bool NetworkManager::sendFrame(Connection &connection, const Frame &frame)
+	{
+		bool wasEmpty = connection.outgoingFrames.empty();
+		if (queueFrame(connection, frame) == false)
+		{
+			shutdown(connection.socket, SHUT_RDWR);
+			return false;
+		}
+
+		if (wasEmpty)
+		{
+			epoll_event event = {};
+			event.events = EPOLLIN | EPOLLRDHUP | EPOLLOUT;
+			event.data.ptr = &connection;
+			epoll_ctl(epollDescriptor, EPOLL_CTL_MOD, connection.socket, &event);
+		}
+
+		return true;
+	}
+}
+
+
+#endif
@@ -22,43 +22,150 @@ void PlayerController::update()
 	auto ownerActor = getOwnerActor().lock();
 	auto controller = static_cast<GameController*>(gameController.lock().get());
 
-	// Check if the ship goes outside the map
-	sf::Vector2f pos = ownerActor->getLocalPosition();
-
-	if (pos.x > controller->getMapWidth() / 2)
-		ownerActor->setLocalPosition(-pos.x + 50.0f, pos.y);
-	else if (pos.x < -controller->getMapWidth() / 2)
-		ownerActor->setLocalPosition(-pos.x - 50.0f, pos.y);
-	else if (pos.y > controller->getMapHeight() / 2)
-		ownerActor->setLocalPosition(pos.x, -pos.y + 50.0f);
-	else if (pos.y < -controller->getMapHeight() / 2)
-		ownerActor->setLocalPosition(pos.x, -pos.y - 50.0f);
-
-	// Check if max speed exceeded
-	if (Tools::length(velocity) > maxVelocity)
-		velocity = velocity / Tools::length(velocity) * maxVelocity;
-
-	// Update position
-	ownerActor->setLocalPosition(ownerActor->getGlobalPosition() + velocity * static_cast<float>(Game::get().deltaTime));
+	// Update position, engines change the velocity through Accelerate coroutines
+	InputFrame frame = { controller->getInputSequence(), static_cast<float>(game.deltaTime), ownerActor->getLocalRotation(), 0 };
+	if (interpolated == false)
+	{
+		sf::Vector2f position = ownerActor->getLocalPosition();
+		simulateFrame(position, velocity, frame);
+		ownerActor->setLocalPosition(position);
+	}
 
 	if (controller->getPlayerId() == playerId)
 	{
-		// Update the camera to track the player
-		sf::View newView = game.window.getView();
-		newView.setCenter(ownerActor->getGlobalPosition());
-		game.window.setView(newView);
-
 		// Update facing angle
 		sf::Vector2f mousePos = game.window.mapPixelToCoords(sf::Mouse::getPosition(game.window), game.window.getView());
 		mousePos -= ownerActor->getGlobalPosition();
 
 		float angle = Tools::rad2deg(std::atan2(mousePos.y, mousePos.x));
 		ownerActor->setLocalRotation(angle);
-		controller->sendSetRotation(angle, ownerActor->getId());
+
+		// Remember the frame to replay it when a snapshot from the host arrives
+		if (controller->isHost() == false)
+		{
+			frame.rotation = angle;
+			frame.engines = engines;
+			recordedFrames.push_back(frame);
+			if (recordedFrames.size() > maxRecordedFrames)
+				recordedFrames.pop_front();
+		}
+
+		// Host replicates its rotation through state snapshots
+		if (controller->isHost() == false && angle != sentRotation)
+		{
+			controller->sendSetRotation(angle, ownerActor->getId());
+			sentRotation = angle;
+		}
 	}
 }
 
 
+// Tracks the player's ship with the camera at its interpolated position
+void PlayerController::onPreRender()
+{
+	auto controller = static_cast<GameController*>(gameController.lock().get());
+	if (controller->getPlayerId() != playerId)
+		return;
+
+	Game &game = Game::get();
+	sf::View newView = game.window.getView();
+	newView.setCenter(getOwnerActor().lock()->getGlobalPosition());
+	game.window.setView(newView);
+}
+
+
+// Moves a ship by @deltaTime: wraps it around the edges of the map centered
+// at (0, 0), limits the speed and applies acceleration of the @engines fired.
+// Shared with the load generator, whose bots predict their ships the same way.
+void PlayerController::simulate(sf::Vector2f &position, sf::Vector2f &velocity, float rotation, unsigned char engines, float deltaTime,
+	const Motion &motion, sf::Vector2f mapSize)
+{
+	// Check if the ship goes outside the map
+	if (position.x > mapSize.x / 2)
+		position.x = -position.x + 50.0f;
+	else if (position.x < -mapSize.x / 2)
+		position.x = -position.x - 50.0f;
+	else if (position.y > mapSize.y / 2)
+		position.y = -position.y + 50.0f;
+	else if (position.y < -mapSize.y / 2)
+		position.y = -position.y - 50.0f;
+
+	// Check if max speed exceeded
+	if (Tools::length(velocity) > motion.maxVelocity)
+		velocity = velocity / Tools::length(velocity) * motion.maxVelocity;
+
+	position += velocity * deltaTime;
+
+	sf::Vector2f acceleration;
+	if (engines & MAIN_ENGINE)
+		acceleration += sf::Vector2f(motion.mainEngineAcceleration, 0.0f);
+	if (engines & REVERSE_ENGINE)
+		acceleration += sf::Vector2f(-motion.sideEngineAcceleration, 0.0f);
+	if (engines & LEFT_ENGINE)
+		acceleration += sf::Vector2f(0.0f, -motion.sideEngineAcceleration);
+	if (engines & RIGHT_ENGINE)
+		acceleration += sf::Vector2f(0.0f, motion.sideEngineAcceleration);
+
+	velocity += Tools::rotate(acceleration, rotation) * deltaTime;
+}
+
+
+// Moves the ship by one frame
+void PlayerController::simulateFrame(sf::Vector2f &position, sf::Vector2f &velocity, const InputFrame &frame) const
+{
+	auto controller = static_cast<GameController*>(gameController.lock().get());
+	simulate(position, velocity, frame.rotation, frame.engines, frame.deltaTime, motion, sf::Vector2f(controller->getMapWidth(), controller->getMapHeight()));
+}
+
+
+// Applies the state received from the host. The host sent it inputAge seconds
+// after processing input processedInput, so recorded frames covering that time
+// are skipped and the rest is simulated again. Returns the distance the ship
+// was moved by, which is the prediction error.
+float PlayerController::reconcile(sf::Vector2f position, sf::Vector2f velocity, unsigned long processedInput, float inputAge)
+{
+	auto ownerActor = getOwnerActor().lock();
+
+	if (processedInput != reconciledInput)
+	{
+		reconciledInput = processedInput;
+		consumedTime = 0.0f;
+	}
+
+	// Frames before the processed input was sent are already simulated by the host
+	while (recordedFrames.empty() == false && recordedFrames.front().inputSequence < processedInput)
+		recordedFrames.pop_front();
+
+	// So are the ones within inputAge, unless later inputs were sent meanwhile
+	float skippedTime = inputAge - consumedTime;
+	while (recordedFrames.empty() == false && recordedFrames.front().inputSequence == processedInput && recordedFrames.front().deltaTime <= skippedTime)
+	{
+		skippedTime -= recordedFrames.front().deltaTime;
+		consumedTime += recordedFrames.front().deltaTime;
+		recordedFrames.pop_front();
+	}
+
+	bool partialFrame = recordedFrames.empty() == false && recordedFrames.front().inputSequence == processedInput && skippedTime > 0.0f;
+	for (auto &recorded : recordedFrames)
+	{
+		InputFrame frame = recorded;
+		if (partialFrame)
+		{
+			frame.deltaTime -= skippedTime;
+			partialFrame = false;
+		}
+
+		simulateFrame(position, velocity, frame);
+	}
+
+	float error = Tools::length(position - ownerActor->getLocalPosition());
+	ownerActor->setLocalPosition(position);
+	this->velocity = velocity;
+
+	return error;
+}
+
+
 void PlayerController::onKeyboardEvent(sf::Event event)
 {
 	auto controller = static_cast<GameController*>(gameController.lock().get());
@@ -91,31 +198,35 @@ void PlayerController::reactToKeyboard(sf::Event event)
 		switch (event.key.code)
 		{
 			case sf::Keyboard::W:
+				engines |= MAIN_ENGINE;
 				coroutineMaster.stopCoroutine("litMainEngine");
 				coroutineMaster.startCoroutine(SetTransparency(mainEngineJet, 255, 0.01f, 0.1f), "litMainEngine");
 				coroutineMaster.stopCoroutine("accelerateForward");
-				coroutineMaster.startCoroutine(Accelerate(getHandle(), sf::Vector2f(1.0f, 0.0f), mainEngineAcceleration), "accelerateForward");
+				coroutineMaster.startCoroutine(Accelerate(getHandle(), sf::Vector2f(1.0f, 0.0f), motion.mainEngineAcceleration), "accelerateForward");
 				break;
 
 			case sf::Keyboard::S:
+				engines |= REVERSE_ENGINE;
 				coroutineMaster.stopCoroutine("litReverseEngine");
 				coroutineMaster.startCoroutine(SetTransparency(reverseEngineJet, 255, 0.01f, 0.1f), "litReverseEngine");
 				coroutineMaster.stopCoroutine("accelerateBackward");
-				coroutineMaster.startCoroutine(Accelerate(getHandle(), sf::Vector2f(-1.0f, 0.0f), sideEngineAcceleration), "accelerateBackward");
+				coroutineMaster.startCoroutine(Accelerate(getHandle(), sf::Vector2f(-1.0f, 0.0f), motion.sideEngineAcceleration), "accelerateBackward");
 				break;
 
 			case sf::Keyboard::A:
+				engines |= LEFT_ENGINE;
 				coroutineMaster.stopCoroutine("litRightEngine");
 				coroutineMaster.startCoroutine(SetTransparency(rightEngineJet, 255, 0.01f, 0.1f), "litRightEngine");
 				coroutineMaster.stopCoroutine("accelerateLeft");
-				coroutineMaster.startCoroutine(Accelerate(getHandle(), sf::Vector2f(0.0f, -1.0f), sideEngineAcceleration), "accelerateLeft");
+				coroutineMaster.startCoroutine(Accelerate(getHandle(), sf::Vector2f(0.0f, -1.0f), motion.sideEngineAcceleration), "accelerateLeft");
 				break;
 
 			case sf::Keyboard::D:
+				engines |= RIGHT_ENGINE;
 				coroutineMaster.stopCoroutine("litLeftEngine");
 				coroutineMaster.startCoroutine(SetTransparency(leftEngineJet, 255, 0.01f, 0.1f), "litLeftEngine");
 				coroutineMaster.stopCoroutine("accelerateRight");
-				coroutineMaster.startCoroutine(Accelerate(getHandle(), sf::Vector2f(0.0f, 1.0f), sideEngineAcceleration), "accelerateRight");
+				coroutineMaster.startCoroutine(Accelerate(getHandle(), sf::Vector2f(0.0f, 1.0f), motion.sideEngineAcceleration), "accelerateRight");
 				break;
 
 			case sf::Keyboard::Space:
@@ -131,6 +242,9 @@ void PlayerController::reactToKeyboard(sf::Event event)
 					projectileController->velocity = velocity + Tools::rotate(sf::Vector2f(750.0f, 0.0f), ownerActor->getLocalRotation());
 				}
 				break;
+
+			default:
+				break;
 		}
 	}
 	else if (event.type == sf::Event::KeyReleased)
@@ -138,28 +252,35 @@ void PlayerController::reactToKeyboard(sf::Event event)
 		switch (event.key.code)
 		{
 			case sf::Keyboard::W:
+				engines &= ~MAIN_ENGINE;
 				coroutineMaster.stopCoroutine("litMainEngine");
 				coroutineMaster.startCoroutine(SetTransparency(mainEngineJet, 0, 0.01f, 0.1f), "litMainEngine");
 				coroutineMaster.stopCoroutine("accelerateForward");
 				break;
 
 			case sf::Keyboard::S:
+				engines &= ~REVERSE_ENGINE;
 				coroutineMaster.stopCoroutine("litReverseEngine");
 				coroutineMaster.startCoroutine(SetTransparency(reverseEngineJet, 0, 0.01f, 0.1f), "litReverseEngine");
 				coroutineMaster.stopCoroutine("accelerateBackward");
 				break;
 
 			case sf::Keyboard::A:
+				engines &= ~LEFT_ENGINE;
 				coroutineMaster.stopCoroutine("litRightEngine");
 				coroutineMaster.startCoroutine(SetTransparency(rightEngineJet, 0, 0.01f, 0.1f), "litRightEngine");
 				coroutineMaster.stopCoroutine("accelerateLeft");
 				break;
 
 			case sf::Keyboard::D:
+				engines &= ~RIGHT_ENGINE;
 				coroutineMaster.stopCoroutine("litLeftEngine");
 				coroutineMaster.startCoroutine(SetTransparency(leftEngineJet, 0, 0.01f, 0.1f), "litLeftEngine");
 				coroutineMaster.stopCoroutine("accelerateRight");
 				break;
+
+			default:
+				break;
 		}
 	}
 }
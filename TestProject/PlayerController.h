@@ -1,6 +1,7 @@
 #ifndef PLAYER_CONTROLLER_H_
 #define PLAYER_CONTROLLER_H_
 #include <SFML/Window/Mouse.hpp>
+#include <deque>
 #include "BehaviourScript.h"
 #include "Actor.h"
 #include "SetTransparency.h"
@@ -8,7 +9,7 @@
 #include "MessageHeader.h"
 
 
-class PlayerController : public BehaviourScript
+class PlayerController final : public BehaviourScript
 {
 	CLONEABLE_COMPONENT();
 
@@ -23,8 +24,31 @@ class PlayerController : public BehaviourScript
 	std::weak_ptr<Actor> leftEngineJet;
 	std::weak_ptr<Actor> rightEngineJet;
 
+	// Rotation last sent to the host
+	float sentRotation = 0.0f;
+
+	// Engines fired at the moment, see Engine
+	unsigned char engines = 0;
+
+	// Client side prediction - frames simulated locally which the host
+	// may not have simulated yet, replayed on top of its snapshots
+	struct InputFrame
+	{
+		unsigned long inputSequence;	// last input sent before the frame
+		float deltaTime;
+		float rotation;
+		unsigned char engines;
+	};
+	static const std::size_t maxRecordedFrames = 1024;
+	std::deque<InputFrame> recordedFrames;
+	unsigned long reconciledInput = 0;
+	float consumedTime = 0.0f;		// time of frames after reconciledInput already covered by the host
+
+	void simulateFrame(sf::Vector2f &position, sf::Vector2f &velocity, const InputFrame &frame) const;
+
 	void awake() override;
 	void update() override;
+	void onPreRender() override;
 	void onKeyboardEvent(sf::Event event) override;
 	void onCollision(std::weak_ptr<Actor> other) override;
 
@@ -32,19 +56,36 @@ class PlayerController : public BehaviourScript
 	class Accelerate;
 
 	public:
+		enum Engine : unsigned char
+		{
+			MAIN_ENGINE = 1 << 0,
+			REVERSE_ENGINE = 1 << 1,
+			LEFT_ENGINE = 1 << 2,
+			RIGHT_ENGINE = 1 << 3
+		};
+
 		unsigned long playerId;
+		bool interpolated = false;		// moved by InterpolationController instead
 
-		// Acceleration applied by engines to move the ship
-		float mainEngineAcceleration = 600.0f;
-		float sideEngineAcceleration = 375.0f;
+		// Acceleration applied by engines to move the ship and its speed limit
+		struct Motion
+		{
+			float mainEngineAcceleration = 600.0f;
+			float sideEngineAcceleration = 375.0f;
+			float maxVelocity = 750.0f;
+		};
+		Motion motion;
 
 		// Speed vector of the actor
 		int hitPoints;
-		float maxVelocity = 750.0f;
 		sf::Vector2f velocity = sf::Vector2f();
 
+		static void simulate(sf::Vector2f &position, sf::Vector2f &velocity, float rotation, unsigned char engines, float deltaTime,
+			const Motion &motion, sf::Vector2f mapSize);
+
 		void setNetworkManager(Network::NetworkManager *networkManager);
 		void reactToKeyboard(sf::Event event);
+		float reconcile(sf::Vector2f position, sf::Vector2f velocity, unsigned long processedInput, float inputAge);
 };
 
 
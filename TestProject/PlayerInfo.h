@@ -1,11 +1,22 @@
 #ifndef PLAYER_INFO_H_
 #define PLAYER_INFO_H_
+#include <chrono>
+#include "StateSnapshot.h"
 
 
 struct PlayerInfo
 {
 	unsigned long connectionId;
 	unsigned long playerId;
+	unsigned long ackedSnapshot = 0;	// newest snapshot confirmed by the player, baseline for deltas
+	SnapshotHistory sentSnapshots;		// snapshots as sent to the player, filtered by relevance
+	unsigned long processedInput = 0;	// newest input event of the player applied by the host
+	std::chrono::steady_clock::time_point processedInputTime;
+
+	PlayerInfo(unsigned long connectionId, unsigned long playerId)
+		: connectionId(connectionId)
+		, playerId(playerId)
+	{}
 };
 
 
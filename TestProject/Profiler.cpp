@@ -0,0 +1,328 @@
+#include "Profiler.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+
+
+const char *const Profiler::frameZone = "Frame";
+
+
+Profiler::Scope::Scope(const char *name)
+	: name(name)
+	, start(clock::now())
+{
+}
+
+
+Profiler::Scope::~Scope()
+{
+	Profiler::get().record(name, start, clock::now());
+}
+
+
+Profiler::~Profiler()
+{
+	close();
+}
+
+
+Profiler& Profiler::get()
+{
+	static Profiler profiler;
+	return profiler;
+}
+
+
+// Buffers are registered on the first scope a thread enters
+Profiler::ThreadBuffer& Profiler::getThreadBuffer()
+{
+	thread_local ThreadBuffer *threadBuffer = nullptr;
+	if (threadBuffer == nullptr)
+	{
+		std::lock_guard<std::mutex> buffersLock(buffersBlockade);
+		buffers.push_back(std::make_unique<ThreadBuffer>());
+		threadBuffer = buffers.back().get();
+		threadBuffer->threadIndex = static_cast<unsigned int>(buffers.size());
+	}
+
+	return *threadBuffer;
+}
+
+
+Profiler::Zone& Profiler::getZone(const char *name)
+{
+	for (auto &zone : zones)
+	{
+		if (zone.name == name || std::strcmp(zone.name, name) == 0)
+			return zone;
+	}
+
+	zones.push_back(Zone());
+	zones.back().name = name;
+	return zones.back();
+}
+
+
+void Profiler::record(const char *name, clock::time_point start, clock::time_point end)
+{
+	ThreadBuffer &buffer = getThreadBuffer();
+	std::lock_guard<std::mutex> bufferLock(buffer.blockade);
+	buffer.events.push_back({ name, start, end, buffer.threadIndex });
+}
+
+
+// Names have to be string literals, called by the main thread
+void Profiler::setCounter(const char *name, double value)
+{
+	for (auto &counter : counters)
+	{
+		if (counter.name == name || std::strcmp(counter.name, name) == 0)
+		{
+			counter.value = value;
+			counter.set = true;
+			return;
+		}
+	}
+
+	counters.push_back(Counter());
+	counters.back().name = name;
+	counters.back().value = value;
+	counters.back().set = true;
+}
+
+
+bool Profiler::openCsv(const std::string &path)
+{
+	csv.open(path, std::ios::out | std::ios::trunc);
+	if (csv.is_open() == false)
+		return false;
+
+	csv << "frame,zone,calls,total_ms\n";
+	return true;
+}
+
+
+bool Profiler::openTrace(const std::string &path)
+{
+	trace.open(path, std::ios::out | std::ios::trunc);
+	if (trace.is_open() == false)
+		return false;
+
+	trace << "{\"traceEvents\":[\n";
+	traceEmpty = true;
+	return true;
+}
+
+
+void Profiler::close()
+{
+	if (csv.is_open())
+		csv.close();
+
+	if (trace.is_open())
+	{
+		trace << "\n]}\n";
+		trace.close();
+	}
+}
+
+
+// Timestamps are in microseconds since the profiler was created
+void Profiler::writeTraceEvent(const char *name, unsigned int threadIndex, clock::time_point start, clock::time_point end)
+{
+	double timestamp = std::chrono::duration<double, std::micro>(start - startTime).count();
+	double duration = std::chrono::duration<double, std::micro>(end - start).count();
+
+	char line[256];
+	std::snprintf(line, sizeof(line), "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.1f,\"dur\":%.1f}",
+		traceEmpty ? "" : ",\n", name, threadIndex, timestamp, duration);
+	trace << line;
+	traceEmpty = false;
+}
+
+
+// Called by the main thread once per frame. Events recorded by other threads
+// since the last call are counted into this frame.
+void Profiler::endFrame()
+{
+	clock::time_point now = clock::now();
+	record(frameZone, frameStart, now);
+	frameStart = now;
+
+	collected.clear();
+	{
+		std::lock_guard<std::mutex> buffersLock(buffersBlockade);
+		for (auto &buffer : buffers)
+		{
+			std::lock_guard<std::mutex> bufferLock(buffer->blockade);
+			collected.insert(collected.end(), buffer->events.begin(), buffer->events.end());
+			buffer->events.clear();
+		}
+	}
+
+	for (auto &event : collected)
+	{
+		Zone &zone = getZone(event.name);
+		zone.frameTotal += std::chrono::duration<double, std::milli>(event.end - event.start).count();
+		zone.frameCalls++;
+
+		if (trace.is_open())
+			writeTraceEvent(event.name, event.threadIndex, event.start, event.end);
+	}
+
+	// Zones not entered in the frame take 0 ms of it
+	for (auto &zone : zones)
+	{
+		if (csv.is_open() && zone.frameCalls > 0)
+			csv << frame << ',' << zone.name << ',' << zone.frameCalls << ',' << zone.frameTotal << '\n';
+
+		if (zone.history.size() < historySize)
+			zone.history.push_back(zone.frameTotal);
+		else
+			zone.history[zone.next] = zone.frameTotal;
+		zone.next = (zone.next + 1) % historySize;
+
+		zone.frameTotal = 0.0;
+		zone.frameCalls = 0;
+	}
+
+	for (auto &counter : counters)
+	{
+		if (csv.is_open() && counter.set)
+			csv << frame << ',' << counter.name << ',' << counter.value << ",\n";
+		counter.set = false;
+	}
+
+	frame++;
+}
+
+
+// Percentiles of the per frame time of a zone in milliseconds
+Profiler::Percentiles Profiler::getPercentiles(const char *name) const
+{
+	Percentiles result;
+	for (auto &zone : zones)
+	{
+		if (zone.name != name && std::strcmp(zone.name, name) != 0)
+			continue;
+		if (zone.history.empty())
+			break;
+
+		std::vector<double> sorted = zone.history;
+		std::sort(sorted.begin(), sorted.end());
+		auto rank = [&](double fraction)
+		{
+			std::size_t index = static_cast<std::size_t>(std::ceil(fraction * sorted.size()));
+			return sorted[std::max<std::size_t>(index, 1) - 1];
+		};
+
+		result.p50 = rank(0.50);
+		result.p95 = rank(0.95);
+		result.p99 = rank(0.99);
+		result.max = sorted.back();
+		break;
+	}
+
+	return result;
+}
+
+
+// Draws a row per zone - p50 and p95 bars with a marker at the maximum -
+// and a graph of the last frame times. The line marks one 60 Hz frame.
+void Profiler::drawOverlay(sf::RenderTarget &target)
+{
+	if (fontRequested == false)
+	{
+		fontRequested = true;
+		fontLoaded = font.loadFromFile("Assets\\profiler.ttf") || font.loadFromFile("C:\\Windows\\Fonts\\consola.ttf");
+	}
+
+	const float margin = 10.0f;
+	const float rowHeight = 16.0f;
+	const float pixelsPerMs = 20.0f;
+	const float graphHeight = 100.0f;
+	const float graphPixelsPerMs = 3.0f;
+	const float frameBudget = 1000.0f / 60.0f;
+	const float labelWidth = fontLoaded ? 420.0f : 0.0f;
+	const float barsLeft = margin + labelWidth;
+
+	sf::View oldView = target.getView();
+	sf::Vector2u size = target.getSize();
+	target.setView(sf::View(sf::FloatRect(0.0f, 0.0f, static_cast<float>(size.x), static_cast<float>(size.y))));
+
+	float zonesHeight = zones.size() * rowHeight;
+	float countersHeight = fontLoaded ? counters.size() * rowHeight : 0.0f;
+	sf::RectangleShape background(sf::Vector2f(labelWidth + frameBudget * pixelsPerMs * 2.0f + 2.0f * margin, zonesHeight + graphHeight + countersHeight + 3.0f * margin));
+	background.setFillColor(sf::Color(0, 0, 0, 180));
+	target.draw(background);
+
+	for (std::size_t i = 0; i < zones.size(); i++)
+	{
+		Percentiles percentiles = getPercentiles(zones[i].name);
+		float y = margin + i * rowHeight;
+
+		sf::RectangleShape bar(sf::Vector2f(static_cast<float>(percentiles.p95) * pixelsPerMs, rowHeight - 4.0f));
+		bar.setPosition(barsLeft, y + 2.0f);
+		bar.setFillColor(sf::Color(40, 120, 40));
+		target.draw(bar);
+
+		bar.setSize(sf::Vector2f(static_cast<float>(percentiles.p50) * pixelsPerMs, rowHeight - 4.0f));
+		bar.setFillColor(sf::Color(80, 220, 80));
+		target.draw(bar);
+
+		bar.setSize(sf::Vector2f(2.0f, rowHeight - 4.0f));
+		bar.setPosition(barsLeft + static_cast<float>(percentiles.max) * pixelsPerMs, y + 2.0f);
+		bar.setFillColor(sf::Color(230, 60, 60));
+		target.draw(bar);
+
+		if (fontLoaded)
+		{
+			char label[128];
+			std::snprintf(label, sizeof(label), "%-30.30s %6.2f %6.2f %6.2f %6.2f", zones[i].name,
+				percentiles.p50, percentiles.p95, percentiles.p99, percentiles.max);
+
+			sf::Text text(label, font, 12);
+			text.setPosition(margin, y);
+			target.draw(text);
+		}
+	}
+
+	// Frame time graph, newest frame on the right
+	float graphBottom = 2.0f * margin + zonesHeight + graphHeight;
+	sf::VertexArray graph(sf::Lines);
+	for (auto &zone : zones)
+	{
+		if (zone.name != frameZone)
+			continue;
+
+		for (std::size_t i = 0; i < zone.history.size(); i++)
+		{
+			std::size_t index = (zone.next + i) % zone.history.size();
+			float height = std::min(static_cast<float>(zone.history[index]) * graphPixelsPerMs, graphHeight);
+			sf::Color color = zone.history[index] > frameBudget ? sf::Color(230, 60, 60) : sf::Color(80, 220, 80);
+
+			graph.append(sf::Vertex(sf::Vector2f(barsLeft + i, graphBottom), color));
+			graph.append(sf::Vertex(sf::Vector2f(barsLeft + i, graphBottom - height), color));
+		}
+	}
+
+	graph.append(sf::Vertex(sf::Vector2f(barsLeft, graphBottom - frameBudget * graphPixelsPerMs), sf::Color::White));
+	graph.append(sf::Vertex(sf::Vector2f(barsLeft + historySize, graphBottom - frameBudget * graphPixelsPerMs), sf::Color::White));
+	graph.append(sf::Vertex(sf::Vector2f(barsLeft + frameBudget * pixelsPerMs, margin), sf::Color::White));
+	graph.append(sf::Vertex(sf::Vector2f(barsLeft + frameBudget * pixelsPerMs, margin + zonesHeight), sf::Color::White));
+	target.draw(graph);
+
+	// Counters are listed under the graph with their last values
+	for (std::size_t i = 0; fontLoaded && i < counters.size(); i++)
+	{
+		char label[128];
+		std::snprintf(label, sizeof(label), "%-30.30s %10.0f", counters[i].name, counters[i].value);
+
+		sf::Text text(label, font, 12);
+		text.setPosition(margin, graphBottom + margin / 2.0f + i * rowHeight);
+		target.draw(text);
+	}
+
+	target.setView(oldView);
+}
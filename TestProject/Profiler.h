@@ -0,0 +1,145 @@
+#ifndef PROFILER_H_
+#define PROFILER_H_
+#include <SFML/Graphics.hpp>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+
+// Markers are compiled in debug builds and in builds defining ENABLE_PROFILER,
+// otherwise PROFILE_SCOPE and PROFILE_COUNTER expand to nothing
+#if defined(ENABLE_PROFILER) || defined(_DEBUG)
+#define PROFILER_ENABLED
+#endif
+
+#ifdef PROFILER_ENABLED
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#define PROFILE_SCOPE(name) Profiler::Scope PROFILE_CONCAT(profileScope, __LINE__)(name)
+#define PROFILE_COUNTER(name, value) Profiler::get().setCounter(name, value)
+#else
+#define PROFILE_SCOPE(name) ((void)0)
+#define PROFILE_COUNTER(name, value) ((void)0)
+#endif
+
+
+// Measures time spent in named scopes of the frame. Scopes may be entered on
+// any thread, each thread records into its own buffer which the main thread
+// collects in endFrame(). Time of every zone is summed per frame and the last
+// historySize frames give rolling percentiles shown in the overlay. Scopes
+// can be written to a CSV file (one row per zone and frame) and to a Chrome
+// trace (chrome://tracing, one event per scope).
+//
+// Counters are values set by the main thread once per frame, like the number
+// of draw calls. The overlay shows their current values, in the CSV file
+// they are rows with the value in the calls column and no time.
+class Profiler
+{
+	public:
+		using clock = std::chrono::steady_clock;
+
+		// Records the time between its construction and destruction, zone
+		// names have to be string literals
+		class Scope
+		{
+			private:
+				const char *name;
+				clock::time_point start;
+
+			public:
+				Scope(const char *name);
+				~Scope();
+				Scope(const Scope&) = delete;
+				Scope& operator=(const Scope&) = delete;
+		};
+
+		struct Percentiles
+		{
+			double p50 = 0.0;
+			double p95 = 0.0;
+			double p99 = 0.0;
+			double max = 0.0;
+		};
+
+	private:
+		struct Event
+		{
+			const char *name;
+			clock::time_point start;
+			clock::time_point end;
+			unsigned int threadIndex;
+		};
+
+		// Events recorded by a single thread since the last frame
+		struct ThreadBuffer
+		{
+			std::mutex blockade;
+			std::vector<Event> events;
+			unsigned int threadIndex;
+		};
+
+		// Per frame totals of a zone in milliseconds, the last historySize frames
+		struct Zone
+		{
+			const char *name;
+			std::vector<double> history;
+			std::size_t next = 0;
+			double frameTotal = 0.0;
+			unsigned int frameCalls = 0;
+		};
+
+		struct Counter
+		{
+			const char *name;
+			double value = 0.0;
+			bool set = false;
+		};
+
+		static const std::size_t historySize = 300;
+		static const char *const frameZone;
+
+		std::mutex buffersBlockade;
+		std::vector<std::unique_ptr<ThreadBuffer>> buffers;	// kept after their threads exit
+		std::vector<Event> collected;
+		std::vector<Zone> zones;
+		std::vector<Counter> counters;
+		unsigned long long frame = 0;
+		clock::time_point startTime = clock::now();
+		clock::time_point frameStart = startTime;
+
+		std::ofstream csv;
+		std::ofstream trace;
+		bool traceEmpty = true;
+
+		// Overlay labels need a font, bars are drawn without it
+		sf::Font font;
+		bool fontLoaded = false;
+		bool fontRequested = false;
+
+		Profiler() = default;
+		ThreadBuffer& getThreadBuffer();
+		Zone& getZone(const char *name);
+		void record(const char *name, clock::time_point start, clock::time_point end);
+		void writeTraceEvent(const char *name, unsigned int threadIndex, clock::time_point start, clock::time_point end);
+
+	public:
+		~Profiler();
+
+		bool overlayEnabled = false;
+
+		static Profiler& get();
+		bool openCsv(const std::string &path);
+		bool openTrace(const std::string &path);
+		void close();
+
+		void setCounter(const char *name, double value);
+		void endFrame();
+		Percentiles getPercentiles(const char *name) const;
+		void drawOverlay(sf::RenderTarget &target);
+};
+
+
+#endif
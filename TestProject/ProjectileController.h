@@ -8,7 +8,7 @@
 #include "MessageHeader.h"
 
 
-class ProjectileController : public BehaviourScript
+class ProjectileController final : public BehaviourScript
 {
 	CLONEABLE_COMPONENT();
 
@@ -23,6 +23,7 @@ class ProjectileController : public BehaviourScript
 
 	public:
 		unsigned long playerId;
+		unsigned long shot = 0;		// number of the projectile among the ones fired by the player
 		int damageDealt;
 		sf::Vector2f velocity = sf::Vector2f();
 
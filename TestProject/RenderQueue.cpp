@@ -0,0 +1,63 @@
+#include <algorithm>
+#include "RenderQueue.h"
+
+
+// First bucket whose depth is not lower than @depth
+std::vector<RenderQueue::Bucket>::iterator RenderQueue::lowerBound(int depth)
+{
+	return std::lower_bound(buckets.begin(), buckets.end(), depth, [](const Bucket &bucket, int depth) { return bucket.depth < depth; });
+}
+
+
+// Creates the bucket if there is none of the depth
+RenderQueue::Bucket& RenderQueue::getBucket(int depth)
+{
+	auto bucket = lowerBound(depth);
+	if (bucket == buckets.end() || bucket->depth != depth)
+		bucket = buckets.insert(bucket, Bucket{ depth, std::vector<const Actor*>(), SpatialGrid() });
+
+	return *bucket;
+}
+
+
+void RenderQueue::add(const Actor *actor, int depth)
+{
+	getBucket(depth).actors.push_back(actor);
+	size++;
+}
+
+
+// The bounds are not updated later, static actors must not move
+void RenderQueue::addStatic(const Actor *actor, int depth, const sf::FloatRect &bounds)
+{
+	getBucket(depth).staticActors.add(actor, bounds);
+	size++;
+}
+
+
+// Remaining actors of the bucket keep their order
+void RenderQueue::remove(const Actor *actor, int depth)
+{
+	auto bucket = lowerBound(depth);
+	if (bucket == buckets.end() || bucket->depth != depth)
+		return;
+
+	if (bucket->staticActors.remove(actor))
+	{
+		size--;
+		return;
+	}
+
+	auto position = std::find(bucket->actors.begin(), bucket->actors.end(), actor);
+	if (position == bucket->actors.end())
+		return;
+
+	bucket->actors.erase(position);
+	size--;
+}
+
+
+std::size_t RenderQueue::getSize() const
+{
+	return size;
+}
@@ -0,0 +1,87 @@
+#ifndef RENDER_QUEUE_H_
+#define RENDER_QUEUE_H_
+#include <SFML/Graphics/Rect.hpp>
+#include <vector>
+#include <cstddef>
+#include "SpatialGrid.h"
+
+
+class Actor;
+
+
+// Actors of a tree grouped in buckets of equal depth, the buckets sorted by
+// depth. Actors are added when they join the tree, removed when they leave
+// it and moved to another bucket when their depth changes, so drawing is
+// a single pass over the buckets and doesn't sort. Within a bucket actors
+// keep the order in which they were added.
+//
+// Static actors are kept in a spatial grid of their bucket instead, so only
+// those within the visible area are visited. They are drawn before the
+// other actors of the same depth.
+class RenderQueue
+{
+	private:
+		struct Bucket
+		{
+			int depth;
+			std::vector<const Actor*> actors;
+			SpatialGrid staticActors;
+		};
+
+		std::vector<Bucket> buckets;	// emptied buckets are kept for reuse
+		std::size_t size = 0;
+
+		std::vector<Bucket>::iterator lowerBound(int depth);
+		Bucket& getBucket(int depth);
+
+	public:
+		RenderQueue() = default;
+		RenderQueue(const RenderQueue&) = delete;
+		RenderQueue& operator=(const RenderQueue&) = delete;
+
+		void add(const Actor *actor, int depth);
+		void addStatic(const Actor *actor, int depth, const sf::FloatRect &bounds);
+		void remove(const Actor *actor, int depth);
+		std::size_t getSize() const;
+
+		// Calls @function(actor) for every actor, from the lowest depth
+		template <typename Function>
+		void forEach(Function function) const;
+
+		// Like forEach(), but skips static actors outside of @area. Other
+		// actors have to be culled by the caller.
+		template <typename Function>
+		void forEachVisible(const sf::FloatRect &area, Function function) const;
+};
+
+
+template <typename Function>
+void RenderQueue::forEach(Function function) const
+{
+	for (auto &bucket : buckets)
+	{
+		bucket.staticActors.forEach(function);
+		for (auto actor : bucket.actors)
+			function(*actor);
+	}
+}
+
+
+template <typename Function>
+void RenderQueue::forEachVisible(const sf::FloatRect &area, Function function) const
+{
+	for (auto &bucket : buckets)
+	{
+		if (bucket.staticActors.getSize() > 0)
+		{
+			for (auto actor : bucket.staticActors.query(area))
+				function(*actor);
+		}
+
+		for (auto actor : bucket.actors)
+			function(*actor);
+	}
+}
+
+
+#endif
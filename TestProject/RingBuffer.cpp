@@ -0,0 +1,74 @@
+#include "RingBuffer.h"
+#include <algorithm>
+#include <cstring>
+
+
+namespace Network
+{
+	RingBuffer::RingBuffer(std::size_t capacity)
+		: storage(capacity)
+	{}
+
+
+	std::size_t RingBuffer::getCapacity() const
+	{
+		return storage.size();
+	}
+
+
+	std::size_t RingBuffer::getReadableSize() const
+	{
+		return writePosition - readPosition;
+	}
+
+
+	// Number of bytes which can be read without wrapping around the storage end
+	std::size_t RingBuffer::getContiguousReadableSize() const
+	{
+		return std::min(getReadableSize(), storage.size() - readPosition % storage.size());
+	}
+
+
+	// Returns the largest free region which doesn't wrap around the storage end
+	char* RingBuffer::getWriteRegion(std::size_t &regionSize)
+	{
+		std::size_t offset = writePosition % storage.size();
+		std::size_t freeSize = storage.size() - getReadableSize();
+
+		regionSize = std::min(freeSize, storage.size() - offset);
+		return storage.data() + offset;
+	}
+
+
+	void RingBuffer::commitWrite(std::size_t size)
+	{
+		writePosition += size;
+	}
+
+
+	const char* RingBuffer::getReadRegion() const
+	{
+		return storage.data() + readPosition % storage.size();
+	}
+
+
+	// Copies @size readable bytes to @destination without consuming them
+	void RingBuffer::peek(char *destination, std::size_t size) const
+	{
+		std::size_t offset = readPosition % storage.size();
+		std::size_t firstPart = std::min(size, storage.size() - offset);
+
+		std::memcpy(destination, storage.data() + offset, firstPart);
+		std::memcpy(destination + firstPart, storage.data(), size - firstPart);
+	}
+
+
+	void RingBuffer::consume(std::size_t size)
+	{
+		readPosition += size;
+
+		// Rewind when empty, so that the next message starts at the storage beginning
+		if (readPosition == writePosition)
+			readPosition = writePosition = 0;
+	}
+}
@@ -0,0 +1,37 @@
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+#include <vector>
+#include <cstddef>
+
+
+namespace Network
+{
+	// Fixed size byte queue used as a socket receive buffer. Data is
+	// written straight into the free region returned by getWriteRegion()
+	// and read back in place through getReadRegion(). Only a read spanning
+	// the end of the storage has to be copied out with peek().
+	class RingBuffer
+	{
+		private:
+			std::vector<char> storage;
+			std::size_t readPosition = 0;	// both positions grow monotonically,
+			std::size_t writePosition = 0;	// the index into storage is position % capacity
+
+		public:
+			RingBuffer(std::size_t capacity);
+
+			std::size_t getCapacity() const;
+			std::size_t getReadableSize() const;
+			std::size_t getContiguousReadableSize() const;
+
+			char* getWriteRegion(std::size_t &regionSize);
+			void commitWrite(std::size_t size);
+
+			const char* getReadRegion() const;
+			void peek(char *destination, std::size_t size) const;
+			void consume(std::size_t size);
+	};
+}
+
+
+#endif
@@ -0,0 +1,129 @@
+#include <algorithm>
+#include <cmath>
+#include "SpatialGrid.h"
+
+
+SpatialGrid::SpatialGrid(float cellSize)
+	: cellSize(cellSize)
+{
+}
+
+
+std::uint64_t SpatialGrid::getCellKey(int x, int y)
+{
+	return (static_cast<std::uint64_t>(static_cast<std::uint32_t>(x)) << 32) | static_cast<std::uint32_t>(y);
+}
+
+
+// Inclusive range of cells overlapped by the area
+void SpatialGrid::getCellRange(const sf::FloatRect &area, int &left, int &top, int &right, int &bottom) const
+{
+	left = static_cast<int>(std::floor(area.left / cellSize));
+	top = static_cast<int>(std::floor(area.top / cellSize));
+	right = static_cast<int>(std::floor((area.left + area.width) / cellSize));
+	bottom = static_cast<int>(std::floor((area.top + area.height) / cellSize));
+}
+
+
+void SpatialGrid::add(const Actor *actor, const sf::FloatRect &bounds)
+{
+	if (items.count(actor) > 0)
+		remove(actor);
+
+	Item item{ nextOrder++, actor, bounds };
+	items[actor] = item;
+	orderedActors[item.order] = actor;
+
+	int left, top, right, bottom;
+	getCellRange(bounds, left, top, right, bottom);
+	for (int x = left; x <= right; x++)
+	{
+		for (int y = top; y <= bottom; y++)
+			cells[getCellKey(x, y)].push_back(item);
+	}
+}
+
+
+// Returns false if the actor isn't in the grid
+bool SpatialGrid::remove(const Actor *actor)
+{
+	auto item = items.find(actor);
+	if (item == items.end())
+		return false;
+
+	int left, top, right, bottom;
+	getCellRange(item->second.bounds, left, top, right, bottom);
+	for (int x = left; x <= right; x++)
+	{
+		for (int y = top; y <= bottom; y++)
+		{
+			auto cell = cells.find(getCellKey(x, y));
+			if (cell == cells.end())
+				continue;
+
+			auto &cellItems = cell->second;
+			cellItems.erase(std::remove_if(cellItems.begin(), cellItems.end(), [actor](const Item &i) { return i.actor == actor; }), cellItems.end());
+			if (cellItems.empty())
+				cells.erase(cell);
+		}
+	}
+
+	orderedActors.erase(item->second.order);
+	items.erase(item);
+	return true;
+}
+
+
+std::size_t SpatialGrid::getSize() const
+{
+	return items.size();
+}
+
+
+// Actors whose bounds intersect the area, each once and in the order they
+// were added. The returned list is valid until the next query.
+const std::vector<const Actor*>& SpatialGrid::query(const sf::FloatRect &area) const
+{
+	found.clear();
+	foundActors.clear();
+
+	auto collect = [&](const std::vector<Item> &cellItems)
+	{
+		for (auto &item : cellItems)
+		{
+			if (item.bounds.intersects(area))
+				found.emplace_back(item.order, item.actor);
+		}
+	};
+
+	// An area covering more cells than exist (like the minimap's) is
+	// faster to check against every cell
+	int left, top, right, bottom;
+	getCellRange(area, left, top, right, bottom);
+	double areaCells = (static_cast<double>(right) - left + 1.0) * (static_cast<double>(bottom) - top + 1.0);
+	if (areaCells > cells.size())
+	{
+		for (auto &cell : cells)
+			collect(cell.second);
+	}
+	else
+	{
+		for (int x = left; x <= right; x++)
+		{
+			for (int y = top; y <= bottom; y++)
+			{
+				auto cell = cells.find(getCellKey(x, y));
+				if (cell != cells.end())
+					collect(cell->second);
+			}
+		}
+	}
+
+	// Actors spanning several cells were found more than once
+	std::sort(found.begin(), found.end());
+	found.erase(std::unique(found.begin(), found.end()), found.end());
+	for (auto &i : found)
+		foundActors.push_back(i.second);
+
+	return foundActors;
+}
@@ -0,0 +1,62 @@
+#ifndef SPATIAL_GRID_H_
+#define SPATIAL_GRID_H_
+#include <SFML/Graphics/Rect.hpp>
+#include <cstdint>
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+
+class Actor;
+
+
+// Uniform grid indexing the bounds of actors which don't move, like the map
+// decorations. An actor is put into every cell its bounds overlap and cells
+// exist only while something is in them, so the grid is unbounded.
+class SpatialGrid
+{
+	private:
+		struct Item
+		{
+			unsigned long order;	// queries return actors in the order they were added
+			const Actor *actor;
+			sf::FloatRect bounds;
+		};
+
+		float cellSize;
+		std::unordered_map<std::uint64_t, std::vector<Item>> cells;
+		std::unordered_map<const Actor*, Item> items;
+		std::map<unsigned long, const Actor*> orderedActors;	// by order
+		unsigned long nextOrder = 0;
+
+		// Results of the last query, reused between queries
+		mutable std::vector<std::pair<unsigned long, const Actor*>> found;
+		mutable std::vector<const Actor*> foundActors;
+
+		static std::uint64_t getCellKey(int x, int y);
+		void getCellRange(const sf::FloatRect &area, int &left, int &top, int &right, int &bottom) const;
+
+	public:
+		SpatialGrid(float cellSize = 1024.0f);
+
+		void add(const Actor *actor, const sf::FloatRect &bounds);
+		bool remove(const Actor *actor);
+		std::size_t getSize() const;
+
+		const std::vector<const Actor*>& query(const sf::FloatRect &area) const;
+
+		// Calls @function(actor) for every actor, in the order they were added
+		template <typename Function>
+		void forEach(Function function) const;
+};
+
+
+template <typename Function>
+void SpatialGrid::forEach(Function function) const
+{
+	for (auto &actor : orderedActors)
+		function(*actor.second);
+}
+
+
+#endif
@@ -0,0 +1,103 @@
+#include "SpatialHashGrid.h"
+#include <cmath>
+
+
+long long SpatialHashGrid::cellKey(int x, int y)
+{
+	return static_cast<long long>((static_cast<unsigned long long>(static_cast<unsigned int>(x)) << 32) | static_cast<unsigned int>(y));
+}
+
+
+int SpatialHashGrid::cellCoord(float value) const
+{
+	return static_cast<int>(std::floor(value / cellSize));
+}
+
+
+SpatialHashGrid::SpatialHashGrid(float cellSize)
+	: cellSize(cellSize)
+{}
+
+
+// Changing the cell size empties the grid, the cell storage is kept
+void SpatialHashGrid::setCellSize(float cellSize)
+{
+	if (cellSize <= 0.0f || cellSize == this->cellSize)
+		return;
+
+	this->cellSize = cellSize;
+	clear();
+}
+
+
+float SpatialHashGrid::getCellSize() const
+{
+	return cellSize;
+}
+
+
+// Empties the grid but keeps the cell storage, so rebuilding
+// the grid every frame doesn't allocate once it is warmed up.
+void SpatialHashGrid::clear()
+{
+	for (auto &cell : occupiedCells)
+		cell.second->clear();
+
+	occupiedCells.clear();
+	entries.clear();
+}
+
+
+// Puts the object into every cell overlapped by its bounds
+void SpatialHashGrid::insert(int id, const sf::FloatRect &bounds)
+{
+	int index = static_cast<int>(entries.size());
+	entries.push_back({ id, bounds });
+
+	int minX = cellCoord(bounds.left);
+	int minY = cellCoord(bounds.top);
+	int maxX = cellCoord(bounds.left + bounds.width);
+	int maxY = cellCoord(bounds.top + bounds.height);
+
+	for (int x = minX; x <= maxX; x++)
+	{
+		for (int y = minY; y <= maxY; y++)
+		{
+			long long key = cellKey(x, y);
+			std::vector<int> &cell = cells[key];
+
+			if (cell.empty())
+				occupiedCells.push_back({ key, &cell });
+			cell.push_back(index);
+		}
+	}
+}
+
+
+// Appends each pair of objects with overlapping bounds exactly once. A pair
+// sharing several cells is reported only by the cell which contains the
+// top-left corner of the bounds intersection.
+void SpatialHashGrid::getCandidatePairs(std::vector<std::pair<int, int>> &pairs) const
+{
+	for (auto &cell : occupiedCells)
+	{
+		const std::vector<int> &indices = *cell.second;
+		for (std::size_t i = 0; i < indices.size(); i++)
+		{
+			const Entry &a = entries[indices[i]];
+			for (std::size_t j = i + 1; j < indices.size(); j++)
+			{
+				const Entry &b = entries[indices[j]];
+
+				sf::FloatRect intersection;
+				if (a.bounds.intersects(b.bounds, intersection) == false)
+					continue;
+
+				if (cellKey(cellCoord(intersection.left), cellCoord(intersection.top)) != cell.first)
+					continue;
+
+				pairs.push_back({ a.id, b.id });
+			}
+		}
+	}
+}
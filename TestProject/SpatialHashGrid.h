@@ -0,0 +1,42 @@
+#ifndef SPATIAL_HASH_GRID_H_
+#define SPATIAL_HASH_GRID_H_
+#include <SFML/Graphics.hpp>
+#include <unordered_map>
+#include <vector>
+#include <utility>
+
+
+// Uniform grid hashed by cell coordinates. Used as a broad phase
+// for collision detection - only objects whose bounds share a cell
+// are reported as candidate pairs. Objects are identified by integer
+// ids given by the user of the grid.
+class SpatialHashGrid
+{
+	private:
+		struct Entry
+		{
+			int id;
+			sf::FloatRect bounds;
+		};
+
+		float cellSize;
+		std::vector<Entry> entries;
+		std::unordered_map<long long, std::vector<int>> cells;
+		std::vector<std::pair<long long, std::vector<int>*>> occupiedCells;	// cells touched since the last clear()
+
+		static long long cellKey(int x, int y);
+		int cellCoord(float value) const;
+
+	public:
+		SpatialHashGrid(float cellSize = 100.0f);
+
+		void setCellSize(float cellSize);
+		float getCellSize() const;
+
+		void clear();
+		void insert(int id, const sf::FloatRect &bounds);
+		void getCandidatePairs(std::vector<std::pair<int, int>> &pairs) const;
+};
+
+
+#endif
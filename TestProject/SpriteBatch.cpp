@@ -0,0 +1,77 @@
+#include <cstdlib>
+#include "SpriteBatch.h"
+
+
+SpriteBatch::SpriteBatch(const TextureAtlas &atlas)
+	: atlas(atlas)
+{
+}
+
+
+// Sprites are drawn to the target until end() is called
+void SpriteBatch::begin(sf::RenderTarget &target)
+{
+	end();
+	this->target = &target;
+	drawCalls = 0;
+}
+
+
+// Adds the quad of the sprite the way sf::Sprite builds it, with texture
+// coordinates moved to the sprite's region of the atlas
+void SpriteBatch::draw(const sf::Sprite &sprite)
+{
+	const sf::Texture *spriteTexture = sprite.getTexture();
+	if (target == nullptr || spriteTexture == nullptr)
+		return;
+
+	sf::IntRect textureRect = sprite.getTextureRect();
+	sf::IntRect region;
+	if (atlas.find(*spriteTexture, region))
+	{
+		spriteTexture = &atlas.getTexture();
+		textureRect.left += region.left;
+		textureRect.top += region.top;
+	}
+
+	if (spriteTexture != texture)
+	{
+		end();
+		texture = spriteTexture;
+	}
+
+	float width = static_cast<float>(std::abs(textureRect.width));
+	float height = static_cast<float>(std::abs(textureRect.height));
+	float left = static_cast<float>(textureRect.left);
+	float right = left + textureRect.width;
+	float top = static_cast<float>(textureRect.top);
+	float bottom = top + textureRect.height;
+
+	const sf::Transform &transform = sprite.getTransform();
+	sf::Color color = sprite.getColor();
+	vertices.append(sf::Vertex(transform.transformPoint(0.0f, 0.0f), color, sf::Vector2f(left, top)));
+	vertices.append(sf::Vertex(transform.transformPoint(width, 0.0f), color, sf::Vector2f(right, top)));
+	vertices.append(sf::Vertex(transform.transformPoint(width, height), color, sf::Vector2f(right, bottom)));
+	vertices.append(sf::Vertex(transform.transformPoint(0.0f, height), color, sf::Vector2f(left, bottom)));
+}
+
+
+// Draws the collected quads
+void SpriteBatch::end()
+{
+	if (target != nullptr && vertices.getVertexCount() > 0)
+	{
+		target->draw(vertices, sf::RenderStates(texture));
+		drawCalls++;
+	}
+
+	vertices.clear();
+	texture = nullptr;
+}
+
+
+// Draw calls since the last begin()
+unsigned long SpriteBatch::getDrawCalls() const
+{
+	return drawCalls;
+}
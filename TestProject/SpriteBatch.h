@@ -0,0 +1,35 @@
+#ifndef SPRITE_BATCH_H_
+#define SPRITE_BATCH_H_
+#include <SFML/Graphics.hpp>
+#include "TextureAtlas.h"
+
+
+// Draws sprites as transformed quads collected in a vertex array. Sprites
+// whose textures are in the atlas share its texture, so consecutive ones
+// end up in a single draw call. The array is drawn when the texture
+// changes and at the end, which keeps the order in which sprites were
+// given. The vertex array is reused, drawing doesn't allocate once it has
+// grown.
+class SpriteBatch
+{
+	private:
+		const TextureAtlas &atlas;
+		sf::RenderTarget *target = nullptr;
+		sf::VertexArray vertices{ sf::Quads };
+		const sf::Texture *texture = nullptr;	// texture of the collected vertices
+		unsigned long drawCalls = 0;
+
+	public:
+		SpriteBatch(const TextureAtlas &atlas);
+		SpriteBatch(const SpriteBatch&) = delete;
+		SpriteBatch& operator=(const SpriteBatch&) = delete;
+
+		void begin(sf::RenderTarget &target);
+		void draw(const sf::Sprite &sprite);
+		void end();
+
+		unsigned long getDrawCalls() const;
+};
+
+
+#endif
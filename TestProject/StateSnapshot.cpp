@@ -0,0 +1,187 @@
+#include "StateSnapshot.h"
+#include <algorithm>
+
+
+namespace
+{
+	unsigned char changedFields(const ActorState &state, const ActorState &base, const StateQuantization &quantization)
+	{
+		auto differs = [](float a, float b, const QuantizedRange &range) { return range.quantize(a) != range.quantize(b); };
+
+		unsigned char mask = 0;
+
+		if (differs(state.position.x, base.position.x, quantization.positionX) || differs(state.position.y, base.position.y, quantization.positionY))
+			mask |= SnapshotHistory::POSITION;
+		// Rotations are raw atan2 angles in (-180, 180], compared as they are written
+		if (BitWriter::quantizeAngle(state.rotation, quantization.rotationBits) != BitWriter::quantizeAngle(base.rotation, quantization.rotationBits))
+			mask |= SnapshotHistory::ROTATION;
+		if (differs(state.velocity.x, base.velocity.x, quantization.velocity) || differs(state.velocity.y, base.velocity.y, quantization.velocity))
+			mask |= SnapshotHistory::VELOCITY;
+
+		return mask;
+	}
+
+
+	const ActorState* findState(const Snapshot *snapshot, unsigned long actorId)
+	{
+		return snapshot != nullptr ? snapshot->findState(actorId) : nullptr;
+	}
+}
+
+
+const ActorState* Snapshot::findState(unsigned long actorId) const
+{
+	auto state = std::lower_bound(states.begin(), states.end(), actorId,
+		[](const ActorState &state, unsigned long id) { return state.actorId < id; });
+
+	if (state == states.end() || state->actorId != actorId)
+		return nullptr;
+	return &*state;
+}
+
+
+SnapshotHistory::SnapshotHistory(std::size_t capacity)
+	: capacity(capacity)
+{}
+
+
+// Stores the snapshot, forgetting the oldest one when over capacity
+const Snapshot& SnapshotHistory::add(Snapshot snapshot)
+{
+	snapshots.push_back(std::move(snapshot));
+	if (snapshots.size() > capacity)
+		snapshots.pop_front();
+
+	return snapshots.back();
+}
+
+
+const Snapshot* SnapshotHistory::find(unsigned long sequence) const
+{
+	for (auto &snapshot : snapshots)
+	{
+		if (snapshot.sequence == sequence)
+			return &snapshot;
+	}
+
+	return nullptr;
+}
+
+
+void SnapshotHistory::clear()
+{
+	snapshots.clear();
+}
+
+
+// Writes @snapshot encoded against @baseline. Without
+// a baseline all actors are written with all of their fields.
+void SnapshotHistory::encodeDelta(const Snapshot &snapshot, const Snapshot *baseline, const StateQuantization &quantization, BitWriter &writer)
+{
+	writer.writeVarint(snapshot.sequence);
+	writer.writeVarint(baseline != nullptr ? snapshot.sequence - baseline->sequence : 0);
+
+	unsigned long previousId = 0;
+	for (auto &state : snapshot.states)
+	{
+		const ActorState *base = findState(baseline, state.actorId);
+		unsigned char mask = base != nullptr ? changedFields(state, *base, quantization) : static_cast<unsigned char>(ALL_FIELDS);
+		if (mask == 0)
+			continue;
+
+		writer.writeBool(true);
+		writer.writeVarint(state.actorId - previousId);
+		writer.writeBits(mask, 3);
+		previousId = state.actorId;
+
+		if (mask & POSITION)
+		{
+			writer.writeQuantized(state.position.x, quantization.positionX);
+			writer.writeQuantized(state.position.y, quantization.positionY);
+		}
+		if (mask & ROTATION)
+			writer.writeAngle(state.rotation, quantization.rotationBits);
+		if (mask & VELOCITY)
+		{
+			writer.writeQuantized(state.velocity.x, quantization.velocity);
+			writer.writeQuantized(state.velocity.y, quantization.velocity);
+		}
+	}
+
+	writer.writeBool(false);
+}
+
+
+bool SnapshotHistory::decodeSequences(BitReader &reader, unsigned long &sequence, unsigned long &baselineSequence)
+{
+	sequence = static_cast<unsigned long>(reader.readVarint());
+	unsigned long distance = static_cast<unsigned long>(reader.readVarint());
+	baselineSequence = distance != 0 ? sequence - distance : 0;
+
+	return reader.hasFailed() == false;
+}
+
+
+// Rebuilds the full @snapshot from a delta against @baseline, following
+// decodeSequences(). States of the actors present in the delta are also
+// put into @changedStates.
+bool SnapshotHistory::decodeDelta(BitReader &reader, const Snapshot *baseline, const StateQuantization &quantization, Snapshot &snapshot, std::vector<ActorState> &changedStates)
+{
+	snapshot.states.clear();
+	changedStates.clear();
+
+	unsigned long previousId = 0;
+	while (reader.readBool())
+	{
+		ActorState state = {};
+		state.actorId = previousId + static_cast<unsigned long>(reader.readVarint());
+		unsigned char mask = static_cast<unsigned char>(reader.readBits(3));
+		previousId = state.actorId;
+
+		const ActorState *base = findState(baseline, state.actorId);
+		if (base != nullptr)
+			state = *base;
+
+		if (mask & POSITION)
+		{
+			state.position.x = reader.readQuantized(quantization.positionX);
+			state.position.y = reader.readQuantized(quantization.positionY);
+		}
+		if (mask & ROTATION)
+			state.rotation = reader.readAngle(quantization.rotationBits);
+		if (mask & VELOCITY)
+		{
+			state.velocity.x = reader.readQuantized(quantization.velocity);
+			state.velocity.y = reader.readQuantized(quantization.velocity);
+		}
+
+		if (reader.hasFailed())
+			return false;
+		changedStates.push_back(state);
+	}
+
+	if (reader.hasFailed())
+		return false;
+
+	// Merge the changed states with the unchanged ones from the baseline
+	std::sort(changedStates.begin(), changedStates.end(), [](const ActorState &a, const ActorState &b) { return a.actorId < b.actorId; });
+	if (baseline != nullptr)
+	{
+		auto changed = changedStates.begin();
+		for (auto &base : baseline->states)
+		{
+			while (changed != changedStates.end() && changed->actorId < base.actorId)
+				snapshot.states.push_back(*changed++);
+
+			if (changed != changedStates.end() && changed->actorId == base.actorId)
+				snapshot.states.push_back(*changed++);
+			else
+				snapshot.states.push_back(base);
+		}
+		snapshot.states.insert(snapshot.states.end(), changed, changedStates.end());
+	}
+	else
+		snapshot.states = changedStates;
+
+	return true;
+}
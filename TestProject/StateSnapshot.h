@@ -0,0 +1,75 @@
+#ifndef STATE_SNAPSHOT_H_
+#define STATE_SNAPSHOT_H_
+#include <SFML/System/Vector2.hpp>
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "BitStream.h"
+
+
+// Replicated state of a single actor
+struct ActorState
+{
+	unsigned long actorId;
+	sf::Vector2f position;
+	float rotation;
+	sf::Vector2f velocity;
+};
+
+
+// States of all replicated actors at one tick, sorted by actor id
+struct Snapshot
+{
+	unsigned long sequence = 0;
+	std::vector<ActorState> states;
+
+	const ActorState* findState(unsigned long actorId) const;
+};
+
+
+// Precision of actor state fields on the wire
+struct StateQuantization
+{
+	QuantizedRange positionX;
+	QuantizedRange positionY;
+	QuantizedRange velocity;
+	int rotationBits;
+};
+
+
+// Recently sent or received snapshots. A snapshot is encoded as a delta
+// against an older one both sides have (the baseline): actors whose
+// quantized state didn't change are skipped, the others carry a mask
+// of changed fields followed by the quantized fields.
+//
+// Delta layout: varint sequence, varint distance to the baseline sequence
+// (0 if none), then for every actor a continuation bit, varint actor ID
+// distance from the previous actor, 3 bit field mask and changed fields.
+class SnapshotHistory
+{
+	private:
+		std::deque<Snapshot> snapshots;
+		std::size_t capacity;
+
+	public:
+		enum Field : unsigned char
+		{
+			POSITION = 1 << 0,
+			ROTATION = 1 << 1,
+			VELOCITY = 1 << 2,
+			ALL_FIELDS = POSITION | ROTATION | VELOCITY
+		};
+
+		SnapshotHistory(std::size_t capacity = 32);
+
+		const Snapshot& add(Snapshot snapshot);
+		const Snapshot* find(unsigned long sequence) const;
+		void clear();
+
+		static void encodeDelta(const Snapshot &snapshot, const Snapshot *baseline, const StateQuantization &quantization, BitWriter &writer);
+		static bool decodeSequences(BitReader &reader, unsigned long &sequence, unsigned long &baselineSequence);
+		static bool decodeDelta(BitReader &reader, const Snapshot *baseline, const StateQuantization &quantization, Snapshot &snapshot, std::vector<ActorState> &changedStates);
+};
+
+
+#endif
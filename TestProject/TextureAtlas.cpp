@@ -0,0 +1,117 @@
+#include <algorithm>
+#include "TextureAtlas.h"
+
+
+// Textures have to stay alive and unchanged while the atlas is used
+void TextureAtlas::add(const sf::Texture &source)
+{
+	if (std::find(sources.begin(), sources.end(), &source) == sources.end())
+		sources.push_back(&source);
+}
+
+
+// Places the textures (sorted by height) in shelves of the given width.
+// Returns false if some texture is wider than the atlas.
+bool TextureAtlas::layOut(const std::vector<const sf::Texture*> &packed, unsigned int width, unsigned int &height,
+	std::unordered_map<const sf::Texture*, sf::IntRect> &layout) const
+{
+	layout.clear();
+	unsigned int x = 0, shelfTop = 0, shelfHeight = 0;
+	for (auto source : packed)
+	{
+		sf::Vector2u size = source->getSize();
+		if (size.x > width)
+			return false;
+
+		if (x + size.x > width)
+		{
+			x = 0;
+			shelfTop += shelfHeight + padding;
+			shelfHeight = 0;
+		}
+
+		layout[source] = sf::IntRect(x, shelfTop, size.x, size.y);
+		x += size.x + padding;
+		shelfHeight = std::max(shelfHeight, size.y);
+	}
+
+	height = shelfTop + shelfHeight;
+	return true;
+}
+
+
+// Builds the atlas from the added textures, trying square-ish power of two
+// sizes up to @maxSize. Textures that don't fit stay standalone. Returns
+// false if the atlas texture couldn't be created.
+bool TextureAtlas::pack(unsigned int maxSize)
+{
+	regions.clear();
+	maxSize = std::min(maxSize, sf::Texture::getMaximumSize());
+
+	std::vector<const sf::Texture*> packed;
+	for (auto source : sources)
+	{
+		sf::Vector2u size = source->getSize();
+		if (size.x > 0 && size.y > 0 && size.x <= maxSize / 2 && size.y <= maxSize / 2)
+			packed.push_back(source);
+	}
+
+	std::stable_sort(packed.begin(), packed.end(), [](const sf::Texture *a, const sf::Texture *b) { return a->getSize().y > b->getSize().y; });
+
+	// The smallest width whose layout is not higher than wide. If even the
+	// widest is too high, the tallest textures are left out one by one.
+	std::unordered_map<const sf::Texture*, sf::IntRect> layout;
+	unsigned int width = std::min(256u, maxSize), height = 0;
+	while (true)
+	{
+		if (layOut(packed, width, height, layout) && height <= width)
+			break;
+
+		if (width >= maxSize)
+		{
+			while (packed.empty() == false && (layOut(packed, width, height, layout) == false || height > maxSize))
+				packed.erase(packed.begin());
+			break;
+		}
+
+		width *= 2;
+	}
+
+	if (packed.empty())
+		return true;
+
+	sf::Image image;
+	image.create(width, height, sf::Color::Transparent);
+	for (auto &i : layout)
+		image.copy(i.first->copyToImage(), i.second.left, i.second.top);
+
+	if (texture.loadFromImage(image) == false)
+		return false;
+
+	regions = layout;
+	return true;
+}
+
+
+// Returns false for textures which are not in the atlas
+bool TextureAtlas::find(const sf::Texture &source, sf::IntRect &region) const
+{
+	auto found = regions.find(&source);
+	if (found == regions.end())
+		return false;
+
+	region = found->second;
+	return true;
+}
+
+
+const sf::Texture& TextureAtlas::getTexture() const
+{
+	return texture;
+}
+
+
+std::size_t TextureAtlas::getPackedCount() const
+{
+	return regions.size();
+}
@@ -0,0 +1,39 @@
+#ifndef TEXTURE_ATLAS_H_
+#define TEXTURE_ATLAS_H_
+#include <SFML/Graphics.hpp>
+#include <unordered_map>
+#include <vector>
+
+
+// Combines loaded textures into a single texture, so that sprites using
+// any of them can be drawn in one draw call. Textures are packed at load
+// time into shelves ordered by height, with a transparent pixel between
+// them. Textures larger than half of the atlas side (like the big nebulae)
+// are left standalone, sprites using them are drawn from their own texture.
+class TextureAtlas
+{
+	private:
+		std::vector<const sf::Texture*> sources;
+		std::unordered_map<const sf::Texture*, sf::IntRect> regions;	// of the packed textures within the atlas
+		sf::Texture texture;
+
+		static const unsigned int padding = 1;
+
+		bool layOut(const std::vector<const sf::Texture*> &packed, unsigned int width, unsigned int &height,
+			std::unordered_map<const sf::Texture*, sf::IntRect> &layout) const;
+
+	public:
+		TextureAtlas() = default;
+		TextureAtlas(const TextureAtlas&) = delete;
+		TextureAtlas& operator=(const TextureAtlas&) = delete;
+
+		void add(const sf::Texture &source);
+		bool pack(unsigned int maxSize = 4096);
+
+		bool find(const sf::Texture &source, sf::IntRect &region) const;
+		const sf::Texture& getTexture() const;
+		std::size_t getPackedCount() const;
+};
+
+
+#endif
@@ -10,4 +10,17 @@ float Tools::rad2deg(float radians)
 float Tools::deg2rad(float degrees)
 {
 	return degrees*pi / 180.0f;
+}
+
+
+// Interpolates between two angles in degrees along the shorter arc
+float Tools::lerpAngle(float from, float to, float t)
+{
+	float difference = std::fmod(to - from, 360.0f);
+	if (difference > 180.0f)
+		difference -= 360.0f;
+	else if (difference < -180.0f)
+		difference += 360.0f;
+
+	return from + difference * t;
 }
\ No newline at end of file
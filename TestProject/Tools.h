@@ -1,7 +1,10 @@
 #ifndef TOOLS_H_
 #define TOOLS_H_
 #include <SFML/Graphics.hpp>
+#include <cmath>
+#include <iostream>
 #include "Coroutine.h"
+#include "CoroutineMaster.h"
 
 
 namespace Tools
@@ -9,6 +12,7 @@ namespace Tools
 	constexpr float pi = 3.141592653589793f;
 	float rad2deg(float radians);
 	float deg2rad(float degrees);
+	float lerpAngle(float from, float to, float t);
 
 	template <typename T>
 	T length(const sf::Vector2<T> &vector);
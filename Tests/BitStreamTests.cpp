@@ -0,0 +1,126 @@
+#include <cmath>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "Test.h"
+#include "BitStream.h"
+
+
+// Fields of any width, including full 32 bits, are read back in order
+TEST(bitStreamRoundTripsBits)
+{
+	std::vector<char> buffer;
+	BitWriter writer(buffer);
+	writer.writeBits(5, 3);
+	writer.writeBool(true);
+	writer.writeBits(0xABCDEF, 24);
+	writer.writeBits(0xDEADBEEF, 32);
+	writer.writeBool(false);
+	writer.writeBits(0x1FF, 8);		// bits above the width are dropped
+	writer.flush();
+	CHECK(buffer.size() == 9);
+
+	BitReader reader(buffer.data(), buffer.size());
+	CHECK(reader.readBits(3) == 5);
+	CHECK(reader.readBool() == true);
+	CHECK(reader.readBits(24) == 0xABCDEF);
+	CHECK(reader.readBits(32) == 0xDEADBEEF);
+	CHECK(reader.readBool() == false);
+	CHECK(reader.readBits(8) == 0xFF);
+	CHECK(reader.hasFailed() == false);
+}
+
+
+// Varints take one byte per 7 bits and keep their value at the group boundaries
+TEST(bitStreamRoundTripsVarints)
+{
+	const std::uint64_t values[] = { 0, 1, 127, 128, 16383, 16384, 0xFFFFFFFFull, 0xFFFFFFFFFFFFFFFFull };
+
+	for (std::uint64_t value : values)
+	{
+		std::vector<char> buffer;
+		BitWriter writer(buffer);
+		writer.writeBool(true);		// varints don't have to start at a byte boundary
+		writer.writeVarint(value);
+		writer.flush();
+
+		std::size_t groups = 1;
+		for (std::uint64_t rest = value >> 7; rest != 0; rest >>= 7)
+			groups++;
+		CHECK(buffer.size() == groups + 1);
+
+		BitReader reader(buffer.data(), buffer.size());
+		reader.readBool();
+		CHECK(reader.readVarint() == value);
+		CHECK(reader.hasFailed() == false);
+	}
+}
+
+
+// Quantized values land within half a step, values outside of the range are clamped
+TEST(bitStreamRoundTripsQuantizedValues)
+{
+	QuantizedRange range = { -100.0f, 100.0f, 12 };
+	const float step = 200.0f / ((1 << 12) - 1);
+	const float values[] = { -100.0f, -33.3f, 0.0f, 0.01f, 57.77f, 100.0f };
+
+	std::vector<char> buffer;
+	BitWriter writer(buffer);
+	for (float value : values)
+		writer.writeQuantized(value, range);
+	writer.writeQuantized(-1000.0f, range);
+	writer.writeQuantized(1000.0f, range);
+	writer.writeAngle(-90.0f, 8);
+	writer.writeAngle(720.0f + 45.0f, 8);
+	writer.flush();
+
+	BitReader reader(buffer.data(), buffer.size());
+	for (float value : values)
+		CHECK(std::fabs(reader.readQuantized(range) - value) <= step / 2.0f);
+	CHECK(reader.readQuantized(range) == -100.0f);
+	CHECK(reader.readQuantized(range) == 100.0f);
+	CHECK(reader.readAngle(8) == 270.0f);
+	CHECK(reader.readAngle(8) == 45.0f);
+	CHECK(reader.hasFailed() == false);
+}
+
+
+TEST(bitStreamRoundTripsStrings)
+{
+	std::vector<char> buffer;
+	BitWriter writer(buffer);
+	writer.writeBits(1, 2);
+	writer.writeString("gracz");
+	writer.writeString("");
+	writer.flush();
+
+	BitReader reader(buffer.data(), buffer.size());
+	reader.readBits(2);
+	CHECK(reader.readString() == "gracz");
+	CHECK(reader.readString().empty());
+	CHECK(reader.hasFailed() == false);
+}
+
+
+// Truncated data fails the reader instead of reading past the end
+TEST(bitStreamFailsOnTruncatedData)
+{
+	std::vector<char> buffer;
+	BitWriter writer(buffer);
+	writer.writeVarint(1000000);
+	writer.writeString("wiadomosc");
+	writer.flush();
+
+	BitReader varintReader(buffer.data(), 2);
+	CHECK(varintReader.readVarint() == 0);
+	CHECK(varintReader.hasFailed());
+
+	BitReader stringReader(buffer.data(), buffer.size() - 1);
+	CHECK(stringReader.readVarint() == 1000000);
+	CHECK(stringReader.readString().empty());
+	CHECK(stringReader.hasFailed());
+
+	// Failed readers keep returning zeros
+	CHECK(stringReader.readBits(8) == 0);
+	CHECK(stringReader.readBool() == false);
+}
@@ -0,0 +1,86 @@
+#include <random>
+#include <vector>
+#include "Test.h"
+#include "ColliderStore.h"
+
+
+namespace
+{
+	// The kernel without SIMD
+	int scalarBatchTest(float x, float y, float radius, const std::vector<float> &centersX, const std::vector<float> &centersY, const std::vector<float> &radii)
+	{
+		for (std::size_t i = 0; i < centersX.size(); i++)
+		{
+			float xDiff = centersX[i] - x;
+			float yDiff = centersY[i] - y;
+			float radiiSum = radii[i] + radius;
+			if (xDiff*xDiff + yDiff*yDiff <= radiiSum*radiiSum)
+				return static_cast<int>(i);
+		}
+		return -1;
+	}
+}
+
+
+// The SIMD loop and the scalar tail find the same circle as a plain loop,
+// for batches of every length around the 4 and 8 wide steps
+TEST(colliderStoreBatchTestMatchesScalarLoop)
+{
+	std::mt19937 random(2701);
+	std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+	std::uniform_real_distribution<float> radius(1.0f, 20.0f);
+
+	int mismatches = 0;
+	int overlaps = 0;
+	for (std::size_t count = 0; count <= 40; count++)
+	{
+		for (int round = 0; round < 50; round++)
+		{
+			std::vector<float> centersX(count), centersY(count), radii(count);
+			for (std::size_t i = 0; i < count; i++)
+			{
+				centersX[i] = position(random);
+				centersY[i] = position(random);
+				radii[i] = radius(random);
+			}
+
+			float x = position(random);
+			float y = position(random);
+			float r = radius(random);
+
+			int expected = scalarBatchTest(x, y, r, centersX, centersY, radii);
+			int result = ColliderStore::circleBatchTest(x, y, r, centersX.data(), centersY.data(), radii.data(), count);
+			if (result != expected)
+				mismatches++;
+			if (expected >= 0)
+				overlaps++;
+		}
+	}
+
+	CHECK(mismatches == 0);
+	CHECK(overlaps > 100);		// the batches exercise both outcomes
+}
+
+
+// Circles exactly touching count as overlapping, in every lane and in the tail
+TEST(colliderStoreBatchTestCountsTouchingCircles)
+{
+	for (std::size_t count = 1; count <= 40; count++)
+	{
+		for (std::size_t touching = 0; touching < count; touching++)
+		{
+			// Far apart circles with one 5 units from (0, 0), radii 2 + 3
+			std::vector<float> centersX(count, 1000.0f), centersY(count, 1000.0f), radii(count, 2.0f);
+			centersX[touching] = 3.0f;
+			centersY[touching] = 4.0f;
+
+			int result = ColliderStore::circleBatchTest(0.0f, 0.0f, 3.0f, centersX.data(), centersY.data(), radii.data(), count);
+			CHECK(result == static_cast<int>(touching));
+
+			// A hair further they don't
+			centersX[touching] = 3.001f;
+			result = ColliderStore::circleBatchTest(0.0f, 0.0f, 3.0f, centersX.data(), centersY.data(), radii.data(), count);
+			CHECK(result == -1);
+		}
+	}
+}
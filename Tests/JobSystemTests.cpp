@@ -0,0 +1,108 @@
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "Test.h"
+#include "JobSystem.h"
+
+
+namespace
+{
+	// Runs parallelFor over @count indices and checks that every
+	// index was visited exactly once, in chunks of at most @grainSize
+	bool coversEveryIndexOnce(JobSystem &jobSystem, std::size_t count, std::size_t grainSize)
+	{
+		std::unique_ptr<std::atomic<int>[]> visits(new std::atomic<int>[count + 1]);
+		for (std::size_t i = 0; i < count + 1; i++)
+			visits[i] = 0;
+		std::atomic<bool> chunksValid{ true };
+
+		jobSystem.parallelFor(count, grainSize, [&](std::size_t begin, std::size_t end)
+		{
+			if (begin >= end || end > count || (grainSize > 0 && end - begin > grainSize))
+				chunksValid = false;
+			for (std::size_t i = begin; i < end; i++)
+				visits[i]++;
+		});
+
+		for (std::size_t i = 0; i < count; i++)
+		{
+			if (visits[i] != 1)
+				return false;
+		}
+		return chunksValid && visits[count] == 0;
+	}
+}
+
+
+// Chunks cover the range without gaps or overlaps, also when the grain
+// size doesn't divide the count or is bigger than it
+TEST(jobSystemParallelForCoversEveryIndexOnce)
+{
+	JobSystem jobSystem(4);
+	for (std::size_t count : { 0, 1, 2, 7, 100, 1001, 4099 })
+	{
+		for (std::size_t grainSize : { 0, 1, 3, 7, 64, 333, 5000 })
+			CHECK(coversEveryIndexOnce(jobSystem, count, grainSize));
+	}
+}
+
+
+// A job may run a parallelFor of its own, the worker helps with it
+// instead of blocking the pool
+TEST(jobSystemRunsNestedParallelFor)
+{
+	JobSystem jobSystem(3);
+	const std::size_t outerCount = 16;
+	const std::size_t innerCount = 257;
+	std::vector<std::atomic<int>> visits(outerCount * innerCount);
+
+	jobSystem.parallelFor(outerCount, 1, [&](std::size_t begin, std::size_t end)
+	{
+		for (std::size_t outer = begin; outer < end; outer++)
+		{
+			jobSystem.parallelFor(innerCount, 5, [&](std::size_t innerBegin, std::size_t innerEnd)
+			{
+				for (std::size_t inner = innerBegin; inner < innerEnd; inner++)
+					visits[outer * innerCount + inner]++;
+			});
+		}
+	});
+
+	bool visitedOnce = true;
+	for (auto &visit : visits)
+		visitedOnce = visitedOnce && visit == 1;
+	CHECK(visitedOnce);
+}
+
+
+// Threads outside of the pool share a queue, each one waits only
+// for its own jobs and helps running them meanwhile
+TEST(jobSystemWaitsOnExternalThreads)
+{
+	JobSystem jobSystem(2);
+	const int threadsCount = 3;
+	const int jobsCount = 500;
+	std::vector<std::atomic<int>> finished(threadsCount);
+	std::vector<int> finishedAfterWait(threadsCount, -1);
+
+	std::vector<std::thread> threads;
+	for (int t = 0; t < threadsCount; t++)
+	{
+		threads.emplace_back([&, t]()
+		{
+			JobSystem::Counter counter;
+			for (int i = 0; i < jobsCount; i++)
+				jobSystem.submit([&finished, t]() { finished[t]++; }, counter);
+
+			jobSystem.wait(counter);
+			finishedAfterWait[t] = finished[t];
+		});
+	}
+
+	for (auto &thread : threads)
+		thread.join();
+
+	for (int t = 0; t < threadsCount; t++)
+		CHECK(finishedAfterWait[t] == jobsCount);
+}
@@ -0,0 +1,49 @@
+#include <cstdio>
+#include "Test.h"
+
+
+namespace
+{
+	bool currentFailed = false;
+}
+
+
+std::vector<Test::Case>& Test::getCases()
+{
+	static std::vector<Case> cases;
+	return cases;
+}
+
+
+void Test::fail(const char *file, int line, const char *condition)
+{
+	printf("  %s:%d: CHECK(%s)\n", file, line, condition);
+	currentFailed = true;
+}
+
+
+Test::Registrar::Registrar(const char *name, std::function<void()> function)
+{
+	getCases().push_back({ name, function });
+}
+
+
+int main()
+{
+	int failed = 0;
+	for (auto &test : Test::getCases())
+	{
+		currentFailed = false;
+		test.function();
+		if (currentFailed)
+		{
+			printf("FAIL %s\n", test.name);
+			failed++;
+		}
+		else
+			printf("ok   %s\n", test.name);
+	}
+
+	printf("%zu testow, nieudanych %d\n", Test::getCases().size(), failed);
+	return failed;
+}
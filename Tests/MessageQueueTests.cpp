@@ -0,0 +1,135 @@
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Test.h"
+#include "MessageQueue.h"
+
+
+namespace
+{
+	void push(MessageQueue &queue, unsigned long connectionId, const std::string &data)
+	{
+		queue.push(connectionId, data.data(), data.size());
+	}
+
+
+	std::vector<std::pair<unsigned long, std::string>> collect(const MessageQueue::Batch &batch)
+	{
+		std::vector<std::pair<unsigned long, std::string>> messages;
+		batch.forEach([&](unsigned long connectionId, const char *data, std::size_t dataSize)
+		{
+			messages.emplace_back(connectionId, std::string(data, dataSize));
+		});
+		return messages;
+	}
+}
+
+
+// A batch gives the messages in the order they were pushed
+TEST(messageQueueKeepsPushOrder)
+{
+	MessageQueue queue(16);
+	MessageQueue::Batch batch;
+
+	queue.takeAll(batch);
+	CHECK(collect(batch).empty());
+
+	push(queue, 1, "pierwsza");
+	push(queue, 2, "druga");
+	push(queue, 1, "");
+	push(queue, 3, "czwarta");
+	queue.takeAll(batch);
+
+	auto messages = collect(batch);
+	CHECK(messages.size() == 4);
+	CHECK(messages.size() == 4 && messages[0] == std::make_pair(1ul, std::string("pierwsza")) && messages[1] == std::make_pair(2ul, std::string("druga"))
+		&& messages[2] == std::make_pair(1ul, std::string()) && messages[3] == std::make_pair(3ul, std::string("czwarta")));
+
+	// Messages of the previous batch are recycled, only the new ones are taken
+	push(queue, 4, "piata");
+	queue.takeAll(batch);
+	messages = collect(batch);
+	CHECK(messages.size() == 1 && messages[0].second == "piata");
+
+	queue.takeAll(batch);
+	CHECK(collect(batch).empty());
+}
+
+
+// Pushing many more messages than the capacity reuses the nodes. Nodes
+// of a batch return to the queue on the next takeAll(), so the queue
+// has room for two batches.
+TEST(messageQueueRecyclesNodes)
+{
+	MessageQueue queue(8);
+	MessageQueue::Batch batch;
+
+	unsigned long expected = 0;
+	for (unsigned long round = 0; round < 100; round++)
+	{
+		for (unsigned long i = 0; i < 4; i++)
+			push(queue, round * 4 + i, std::string(static_cast<std::size_t>(round % 7) * 1000, 'x'));
+		queue.takeAll(batch);
+
+		batch.forEach([&](unsigned long connectionId, const char *, std::size_t dataSize)
+		{
+			CHECK(connectionId == expected);
+			CHECK(dataSize == (connectionId / 4 % 7) * 1000);
+			expected++;
+		});
+	}
+	CHECK(expected == 400);
+}
+
+
+// Messages of every producer thread arrive complete and in their order,
+// while the producers wait for free nodes of a small queue
+TEST(messageQueueKeepsOrderOfEachProducer)
+{
+	const unsigned long producerCount = 4;
+	const unsigned long messageCount = 20000;
+	MessageQueue queue(8);
+
+	std::vector<std::thread> producers;
+	for (unsigned long producer = 0; producer < producerCount; producer++)
+	{
+		producers.emplace_back([&queue, producer, messageCount]()
+		{
+			for (unsigned long i = 0; i < messageCount; i++)
+				queue.push(producer, reinterpret_cast<const char*>(&i), sizeof(i));
+		});
+	}
+
+	std::vector<unsigned long> nextMessage(producerCount, 0);
+	unsigned long received = 0;
+	bool ordered = true;
+	MessageQueue::Batch batch;
+	while (received < producerCount * messageCount)
+	{
+		queue.takeAll(batch);
+		batch.forEach([&](unsigned long connectionId, const char *data, std::size_t dataSize)
+		{
+			unsigned long value = 0;
+			if (connectionId >= producerCount || dataSize != sizeof(value))
+			{
+				ordered = false;
+				return;
+			}
+
+			std::memcpy(&value, data, sizeof(value));
+			ordered = ordered && value == nextMessage[connectionId];
+			nextMessage[connectionId] = value + 1;
+			received++;
+		});
+		std::this_thread::yield();
+	}
+
+	for (auto &producer : producers)
+		producer.join();
+
+	queue.takeAll(batch);
+	CHECK(collect(batch).empty());
+	CHECK(ordered);
+	CHECK(received == producerCount * messageCount);
+}
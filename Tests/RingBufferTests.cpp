@@ -0,0 +1,162 @@
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "Test.h"
+#include "RingBuffer.h"
+
+
+namespace
+{
+	using FrameLength = std::uint32_t;
+
+
+	// Writes @data through the write regions, the way recv() fills them
+	// on the socket, at most @chunkSize bytes at a time
+	bool write(Network::RingBuffer &buffer, const std::string &data, std::size_t chunkSize)
+	{
+		std::size_t written = 0;
+		while (written < data.size())
+		{
+			std::size_t regionSize = 0;
+			char *region = buffer.getWriteRegion(regionSize);
+			if (regionSize == 0)
+				return false;
+
+			std::size_t size = std::min({ regionSize, chunkSize, data.size() - written });
+			std::memcpy(region, data.data() + written, size);
+			buffer.commitWrite(size);
+			written += size;
+		}
+		return true;
+	}
+
+
+	std::string frame(const std::string &message)
+	{
+		FrameLength length = static_cast<FrameLength>(message.size());
+		return std::string(reinterpret_cast<const char*>(&length), sizeof(length)) + message;
+	}
+
+
+	// Takes the complete frames out of the buffer like NetworkManager::dispatchMessages.
+	// Returns the number of messages which had to be copied out, wrapping around.
+	std::size_t readFrames(Network::RingBuffer &buffer, std::vector<std::string> &messages)
+	{
+		std::vector<char> scratch;
+		std::size_t wrapped = 0;
+		while (buffer.getReadableSize() >= sizeof(FrameLength))
+		{
+			FrameLength length = 0;
+			buffer.peek(reinterpret_cast<char*>(&length), sizeof(FrameLength));
+			if (buffer.getReadableSize() < sizeof(FrameLength) + length)
+				break;
+			buffer.consume(sizeof(FrameLength));
+
+			const char *message = buffer.getReadRegion();
+			if (buffer.getContiguousReadableSize() < length)
+			{
+				scratch.resize(length);
+				buffer.peek(scratch.data(), length);
+				message = scratch.data();
+				wrapped++;
+			}
+
+			messages.emplace_back(message, length);
+			buffer.consume(length);
+		}
+		return wrapped;
+	}
+}
+
+
+// A frame arriving byte by byte is complete only after its last byte
+TEST(ringBufferWaitsForWholeFrame)
+{
+	Network::RingBuffer buffer(64);
+	std::string data = frame("abcdef");
+	std::vector<std::string> messages;
+
+	for (std::size_t i = 0; i < data.size(); i++)
+	{
+		CHECK(messages.empty());
+		CHECK(write(buffer, data.substr(i, 1), 1));
+		readFrames(buffer, messages);
+	}
+
+	CHECK(messages.size() == 1 && messages[0] == "abcdef");
+	CHECK(buffer.getReadableSize() == 0);
+}
+
+
+// Frames and their lengths split by the end of the storage are read back intact
+TEST(ringBufferReadsFramesAcrossStorageEnd)
+{
+	Network::RingBuffer buffer(16);
+	std::vector<std::string> sent;
+	std::string stream;
+	for (int i = 0; i < 40; i++)
+	{
+		sent.push_back(std::string(i % 9 + 1, static_cast<char>('a' + i % 26)));
+		stream += frame(sent.back());
+	}
+
+	// Chunks of 5 bytes rarely end with a frame, so the buffer doesn't
+	// rewind and the frames wrap around the storage end at different places
+	std::vector<std::string> received;
+	std::size_t wrapped = 0;
+	for (std::size_t written = 0; written < stream.size();)
+	{
+		std::size_t regionSize = 0;
+		char *region = buffer.getWriteRegion(regionSize);
+		std::size_t size = std::min({ regionSize, std::size_t(5), stream.size() - written });
+		CHECK(size > 0);
+		if (size == 0)
+			break;
+
+		std::memcpy(region, stream.data() + written, size);
+		buffer.commitWrite(size);
+		written += size;
+		wrapped += readFrames(buffer, received);
+	}
+
+	CHECK(received == sent);
+	CHECK(wrapped > 0);
+	CHECK(buffer.getReadableSize() == 0);
+}
+
+
+// The write region never covers unread data
+TEST(ringBufferLimitsWriteRegionToFreeSpace)
+{
+	Network::RingBuffer buffer(8);
+	std::size_t regionSize = 0;
+
+	CHECK(write(buffer, "12345678", 8));
+	buffer.getWriteRegion(regionSize);
+	CHECK(regionSize == 0);
+
+	buffer.consume(3);
+	buffer.getWriteRegion(regionSize);
+	CHECK(regionSize == 3);
+
+	char read[5] = {};
+	buffer.peek(read, 5);
+	CHECK(std::string(read, 5) == "45678");
+}
+
+
+// Consuming everything moves the next write to the storage beginning
+TEST(ringBufferRewindsWhenEmpty)
+{
+	Network::RingBuffer buffer(8);
+	CHECK(write(buffer, "123456", 6));
+	buffer.consume(6);
+
+	std::size_t regionSize = 0;
+	buffer.getWriteRegion(regionSize);
+	CHECK(regionSize == 8);
+	CHECK(write(buffer, "abcdefgh", 8));
+	CHECK(buffer.getContiguousReadableSize() == 8);
+}
@@ -0,0 +1,210 @@
+#include <cmath>
+#include <vector>
+#include "Test.h"
+#include "StateSnapshot.h"
+
+
+namespace
+{
+	StateQuantization createQuantization()
+	{
+		StateQuantization quantization;
+		quantization.positionX = { -1000.0f, 1000.0f, 18 };
+		quantization.positionY = { -1000.0f, 1000.0f, 18 };
+		quantization.velocity = { -2048.0f, 2048.0f, 16 };
+		quantization.rotationBits = 12;
+		return quantization;
+	}
+
+
+	ActorState createState(unsigned long actorId, float x, float y, float rotation)
+	{
+		ActorState state = {};
+		state.actorId = actorId;
+		state.position = sf::Vector2f(x, y);
+		state.rotation = rotation;
+		state.velocity = sf::Vector2f(x / 10.0f, -y / 10.0f);
+		return state;
+	}
+
+
+	// States match within the precision of the quantization
+	bool sameStates(const Snapshot &a, const Snapshot &b)
+	{
+		if (a.states.size() != b.states.size())
+			return false;
+
+		for (std::size_t i = 0; i < a.states.size(); i++)
+		{
+			const ActorState &x = a.states[i];
+			const ActorState &y = b.states[i];
+			if (x.actorId != y.actorId || std::fabs(x.position.x - y.position.x) > 0.01f || std::fabs(x.position.y - y.position.y) > 0.01f
+				|| std::fabs(x.rotation - y.rotation) > 0.1f || std::fabs(x.velocity.x - y.velocity.x) > 0.1f || std::fabs(x.velocity.y - y.velocity.y) > 0.1f)
+				return false;
+		}
+		return true;
+	}
+
+
+	// Encodes @snapshot against @baseline and decodes it on the other side
+	bool transfer(const Snapshot &snapshot, const Snapshot *sentBaseline, const Snapshot *receivedBaseline, Snapshot &received,
+		std::vector<ActorState> &changedStates, std::size_t &size)
+	{
+		StateQuantization quantization = createQuantization();
+		std::vector<char> buffer;
+		BitWriter writer(buffer);
+		SnapshotHistory::encodeDelta(snapshot, sentBaseline, quantization, writer);
+		writer.flush();
+		size = buffer.size();
+
+		BitReader reader(buffer.data(), buffer.size());
+		unsigned long sequence = 0;
+		unsigned long baselineSequence = 0;
+		if (SnapshotHistory::decodeSequences(reader, sequence, baselineSequence) == false)
+			return false;
+		if (sequence != snapshot.sequence || baselineSequence != (sentBaseline != nullptr ? sentBaseline->sequence : 0))
+			return false;
+
+		received.sequence = sequence;
+		return SnapshotHistory::decodeDelta(reader, receivedBaseline, createQuantization(), received, changedStates);
+	}
+}
+
+
+// Without a baseline every actor is sent with all fields
+TEST(snapshotHistoryRoundTripsWithoutBaseline)
+{
+	Snapshot snapshot;
+	snapshot.sequence = 7;
+	snapshot.states = { createState(3, 10.0f, 20.0f, 90.0f), createState(8, -500.0f, 250.5f, 359.0f), createState(120, 0.0f, 0.0f, 0.0f) };
+
+	Snapshot received;
+	std::vector<ActorState> changedStates;
+	std::size_t size = 0;
+	CHECK(transfer(snapshot, nullptr, nullptr, received, changedStates, size));
+	CHECK(sameStates(snapshot, received));
+	CHECK(changedStates.size() == 3);
+}
+
+
+// Unchanged actors are skipped, changed and new ones are merged with the baseline
+TEST(snapshotHistoryRoundTripsDeltaAgainstBaseline)
+{
+	Snapshot baseline;
+	baseline.sequence = 10;
+	baseline.states = { createState(1, 100.0f, 100.0f, 0.0f), createState(2, 200.0f, 200.0f, 45.0f), createState(5, 300.0f, 300.0f, 90.0f) };
+
+	Snapshot snapshot;
+	snapshot.sequence = 12;
+	snapshot.states = baseline.states;
+	snapshot.states[1].position.x += 5.0f;
+	snapshot.states.insert(snapshot.states.begin() + 2, createState(4, -50.0f, 60.0f, 180.0f));
+
+	Snapshot received;
+	std::vector<ActorState> changedStates;
+	std::size_t fullSize = 0, deltaSize = 0;
+	CHECK(transfer(snapshot, nullptr, nullptr, received, changedStates, fullSize));
+	CHECK(transfer(snapshot, &baseline, &baseline, received, changedStates, deltaSize));
+
+	CHECK(received.sequence == 12);
+	CHECK(sameStates(snapshot, received));
+	CHECK(changedStates.size() == 2);
+	CHECK(changedStates.size() == 2 && changedStates[0].actorId == 2 && changedStates[1].actorId == 4);
+	CHECK(deltaSize < fullSize);
+}
+
+
+// A snapshot equal to its baseline carries only the sequences
+TEST(snapshotHistorySkipsUnchangedSnapshot)
+{
+	Snapshot baseline;
+	baseline.sequence = 1;
+	baseline.states = { createState(1, 1.0f, 2.0f, 3.0f), createState(2, 4.0f, 5.0f, 6.0f) };
+
+	Snapshot snapshot = baseline;
+	snapshot.sequence = 2;
+
+	Snapshot received;
+	std::vector<ActorState> changedStates;
+	std::size_t size = 0;
+	CHECK(transfer(snapshot, &baseline, &baseline, received, changedStates, size));
+	CHECK(sameStates(snapshot, received));
+	CHECK(changedStates.empty());
+	CHECK(size == 3);
+}
+
+
+// Rotations are compared as sent, so negative angles and angles
+// on both sides of 0/360 are wrapped before looking for changes
+TEST(snapshotHistoryWrapsRotations)
+{
+	Snapshot baseline;
+	baseline.sequence = 1;
+	baseline.states = { createState(1, 0.0f, 0.0f, -10.0f), createState(2, 0.0f, 0.0f, 359.99f), createState(3, 0.0f, 0.0f, -90.0f),
+		createState(4, 0.0f, 0.0f, 0.01f) };
+
+	Snapshot snapshot = baseline;
+	snapshot.sequence = 2;
+	snapshot.states[0].rotation = -120.0f;
+	snapshot.states[1].rotation = 0.0f;
+	snapshot.states[2].rotation = 270.0f;
+	snapshot.states[3].rotation = -0.01f;
+
+	Snapshot received;
+	std::vector<ActorState> changedStates;
+	std::size_t size = 0;
+	CHECK(transfer(snapshot, &baseline, &baseline, received, changedStates, size));
+	CHECK(changedStates.size() == 1);
+	CHECK(changedStates.size() == 1 && changedStates[0].actorId == 1);
+	CHECK(received.states.size() == 4 && std::fabs(received.states[0].rotation - 240.0f) < 0.1f);
+
+	// A turn within the negative half against a positive baseline
+	baseline.states[0].rotation = 170.0f;
+	snapshot.states[0].rotation = -170.0f;
+	CHECK(transfer(snapshot, &baseline, &baseline, received, changedStates, size));
+	CHECK(changedStates.size() == 1 && std::fabs(changedStates[0].rotation - 190.0f) < 0.1f);
+}
+
+
+// The history keeps the newest snapshots up to its capacity
+TEST(snapshotHistoryForgetsOldestSnapshots)
+{
+	SnapshotHistory history(4);
+	for (unsigned long sequence = 1; sequence <= 6; sequence++)
+	{
+		Snapshot snapshot;
+		snapshot.sequence = sequence;
+		snapshot.states = { createState(sequence, 0.0f, 0.0f, 0.0f) };
+		history.add(snapshot);
+	}
+
+	CHECK(history.find(1) == nullptr);
+	CHECK(history.find(2) == nullptr);
+	CHECK(history.find(3) != nullptr);
+	CHECK(history.find(6) != nullptr && history.find(6)->states[0].actorId == 6);
+	CHECK(history.find(0) == nullptr);
+
+	history.clear();
+	CHECK(history.find(6) == nullptr);
+}
+
+
+// Damaged data is rejected
+TEST(snapshotHistoryRejectsTruncatedDelta)
+{
+	Snapshot snapshot;
+	snapshot.sequence = 3;
+	snapshot.states = { createState(1, 10.0f, 10.0f, 10.0f), createState(2, 20.0f, 20.0f, 20.0f) };
+
+	std::vector<char> buffer;
+	BitWriter writer(buffer);
+	SnapshotHistory::encodeDelta(snapshot, nullptr, createQuantization(), writer);
+	writer.flush();
+
+	BitReader reader(buffer.data(), buffer.size() - 4);
+	unsigned long sequence = 0, baselineSequence = 0;
+	Snapshot received;
+	std::vector<ActorState> changedStates;
+	CHECK(SnapshotHistory::decodeSequences(reader, sequence, baselineSequence));
+	CHECK(SnapshotHistory::decodeDelta(reader, nullptr, createQuantization(), received, changedStates) == false);
+}
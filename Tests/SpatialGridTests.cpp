@@ -0,0 +1,43 @@
+#include <algorithm>
+#include <vector>
+#include "Test.h"
+#include "SpatialGrid.h"
+
+
+namespace
+{
+	// The grid only compares the pointers, so actors can stand in for themselves
+	const Actor* actor(std::size_t index)
+	{
+		static char actors[16];
+		return reinterpret_cast<const Actor*>(&actors[index]);
+	}
+}
+
+
+// Visiting all actors and querying an area covering them give the same
+// order, the order in which the actors were added
+TEST(spatialGridVisitsActorsInOrderOfAdding)
+{
+	SpatialGrid grid(100.0f);
+	std::vector<const Actor*> added;
+	for (std::size_t i = 0; i < 12; i++)
+	{
+		float offset = static_cast<float>((i * 7) % 12) * 90.0f;
+		grid.add(actor(i), sf::FloatRect(offset, -offset, 150.0f, 150.0f));
+		added.push_back(actor(i));
+	}
+
+	// Added again, so moved to the end
+	grid.add(actor(3), sf::FloatRect(0.0f, 0.0f, 10.0f, 10.0f));
+	added.erase(added.begin() + 3);
+	added.push_back(actor(3));
+
+	grid.remove(actor(5));
+	added.erase(std::find(added.begin(), added.end(), actor(5)));
+
+	std::vector<const Actor*> visited;
+	grid.forEach([&](const Actor &a) { visited.push_back(&a); });
+	CHECK(visited == added);
+	CHECK(grid.query(sf::FloatRect(-2000.0f, -2000.0f, 4000.0f, 4000.0f)) == added);
+}
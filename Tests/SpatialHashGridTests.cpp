@@ -0,0 +1,67 @@
+#include <algorithm>
+#include "Test.h"
+#include "SpatialHashGrid.h"
+
+
+// Two objects spanning the same four cells are reported once
+TEST(spatialHashGridReportsPairOnce)
+{
+	SpatialHashGrid grid(100.0f);
+	grid.insert(1, sf::FloatRect(50.0f, 50.0f, 100.0f, 100.0f));
+	grid.insert(2, sf::FloatRect(60.0f, 60.0f, 100.0f, 100.0f));
+
+	std::vector<std::pair<int, int>> pairs;
+	grid.getCandidatePairs(pairs);
+	CHECK(pairs.size() == 1);
+	CHECK(pairs.size() == 1 && pairs[0] == std::make_pair(1, 2));
+}
+
+
+// Objects sharing a cell without overlapping aren't candidates
+TEST(spatialHashGridSkipsSeparateBounds)
+{
+	SpatialHashGrid grid(100.0f);
+	grid.insert(1, sf::FloatRect(0.0f, 0.0f, 10.0f, 10.0f));
+	grid.insert(2, sf::FloatRect(50.0f, 50.0f, 10.0f, 10.0f));
+	grid.insert(3, sf::FloatRect(-500.0f, -500.0f, 10.0f, 10.0f));
+
+	std::vector<std::pair<int, int>> pairs;
+	grid.getCandidatePairs(pairs);
+	CHECK(pairs.empty());
+}
+
+
+// Every overlapping pair of a cluster spread over many cells appears exactly once
+TEST(spatialHashGridDeduplicatesClusters)
+{
+	SpatialHashGrid grid(10.0f);
+	for (int i = 0; i < 5; i++)
+		grid.insert(i, sf::FloatRect(i * 3.0f - 20.0f, i * 3.0f - 20.0f, 40.0f, 40.0f));
+
+	std::vector<std::pair<int, int>> pairs;
+	grid.getCandidatePairs(pairs);
+	for (auto &pair : pairs)
+	{
+		if (pair.first > pair.second)
+			std::swap(pair.first, pair.second);
+	}
+	std::sort(pairs.begin(), pairs.end());
+
+	CHECK(pairs.size() == 10);
+	CHECK(std::unique(pairs.begin(), pairs.end()) == pairs.end());
+}
+
+
+// clear() keeps the cells, but none of the old objects
+TEST(spatialHashGridClear)
+{
+	SpatialHashGrid grid(100.0f);
+	grid.insert(1, sf::FloatRect(0.0f, 0.0f, 10.0f, 10.0f));
+	grid.insert(2, sf::FloatRect(5.0f, 5.0f, 10.0f, 10.0f));
+	grid.clear();
+	grid.insert(3, sf::FloatRect(0.0f, 0.0f, 10.0f, 10.0f));
+
+	std::vector<std::pair<int, int>> pairs;
+	grid.getCandidatePairs(pairs);
+	CHECK(pairs.empty());
+}
@@ -0,0 +1,102 @@
+#include <cstdio>
+#include "Test.h"
+#include "SpriteBatch.h"
+
+
+namespace
+{
+	// Semi-transparent patterns, so that the drawing order shows in the blended pixels
+	void createTexture(sf::Texture &texture, unsigned int width, unsigned int height, sf::Uint8 seed)
+	{
+		sf::Image image;
+		image.create(width, height);
+		for (unsigned int x = 0; x < width; x++)
+		{
+			for (unsigned int y = 0; y < height; y++)
+				image.setPixel(x, y, sf::Color(seed, static_cast<sf::Uint8>(x * 16), static_cast<sf::Uint8>(y * 16), static_cast<sf::Uint8>(128 + (x * 7 + y * 3) % 128)));
+		}
+		texture.loadFromImage(image);
+	}
+
+
+	sf::Sprite createSprite(const sf::Texture &texture, float x, float y)
+	{
+		sf::Sprite sprite(texture);
+		sprite.setPosition(x, y);
+		return sprite;
+	}
+}
+
+
+// Sprites drawn through the batch (from the atlas and a standalone texture)
+// produce the same pixels as drawn one by one. Positions, scales and
+// rotations keep texel edges on pixel edges, so sampling can't differ.
+TEST(spriteBatchMatchesPerSpriteDrawing)
+{
+	sf::RenderTexture perSprite, batched;
+	if (perSprite.create(64, 64) == false || batched.create(64, 64) == false)
+	{
+		printf("  pominiety, brak kontekstu OpenGL\n");
+		return;
+	}
+
+	sf::Texture small, wide, standalone;
+	createTexture(small, 8, 8, 50);
+	createTexture(wide, 16, 4, 150);
+	createTexture(standalone, 24, 24, 250);
+
+	TextureAtlas atlas;
+	atlas.add(small);
+	atlas.add(wide);
+	atlas.add(standalone);
+	CHECK(atlas.pack(32));
+	CHECK(atlas.getPackedCount() == 2);
+
+	std::vector<sf::Sprite> sprites;
+	sprites.push_back(createSprite(small, 2.0f, 2.0f));
+	sprites.push_back(createSprite(wide, 6.0f, 3.0f));
+	sprites.back().setScale(2.0f, 2.0f);
+	sprites.push_back(createSprite(small, 30.0f, 30.0f));
+	sprites.back().setOrigin(4.0f, 4.0f);
+	sprites.back().setRotation(90.0f);
+	sprites.back().setColor(sf::Color(255, 128, 255, 200));
+	sprites.push_back(createSprite(standalone, 20.0f, 20.0f));
+	sprites.push_back(createSprite(wide, 5.0f, 40.0f));
+	sprites.back().setTextureRect(sf::IntRect(4, 0, 8, 4));
+	sprites.back().setScale(3.0f, 2.0f);
+	sprites.push_back(createSprite(small, 40.0f, 5.0f));
+	sprites.back().setTextureRect(sf::IntRect(8, 0, -8, 8));
+
+	const sf::Color background(10, 20, 30);
+	perSprite.clear(background);
+	for (auto &sprite : sprites)
+		perSprite.draw(sprite);
+	perSprite.display();
+
+	batched.clear(background);
+	SpriteBatch batch(atlas);
+	batch.begin(batched);
+	for (auto &sprite : sprites)
+		batch.draw(sprite);
+	batch.end();
+	batched.display();
+
+	// The standalone texture splits the atlas sprites into two draw calls
+	CHECK(batch.getDrawCalls() == 3);
+
+	sf::Image expected = perSprite.getTexture().copyToImage();
+	sf::Image actual = batched.getTexture().copyToImage();
+	unsigned int differentPixels = 0, drawnPixels = 0;
+	for (unsigned int x = 0; x < 64; x++)
+	{
+		for (unsigned int y = 0; y < 64; y++)
+		{
+			if (actual.getPixel(x, y) != expected.getPixel(x, y))
+				differentPixels++;
+			if (expected.getPixel(x, y) != background)
+				drawnPixels++;
+		}
+	}
+	CHECK(differentPixels == 0);
+	CHECK(drawnPixels > 500);
+}
@@ -0,0 +1,38 @@
+#ifndef TEST_H_
+#define TEST_H_
+#include <functional>
+#include <vector>
+
+
+// Minimal test runner. TEST(name) defines a test function which is
+// registered before main() runs, CHECK(condition) reports a failed
+// condition and lets the test go on. main() runs all tests and returns
+// the number of the failed ones.
+namespace Test
+{
+	struct Case
+	{
+		const char *name;
+		std::function<void()> function;
+	};
+
+	std::vector<Case>& getCases();
+	void fail(const char *file, int line, const char *condition);
+
+	struct Registrar
+	{
+		Registrar(const char *name, std::function<void()> function);
+	};
+}
+
+
+#define TEST(name) \
+	static void name(); \
+	static Test::Registrar name##Registrar(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) Test::fail(__FILE__, __LINE__, #condition); } while (false)
+
+
+#endif
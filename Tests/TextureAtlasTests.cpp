@@ -0,0 +1,123 @@
+#include "Test.h"
+#include "TextureAtlas.h"
+
+
+namespace
+{
+	// Every pixel differs from its neighbours and from the other textures
+	void createTexture(sf::Texture &texture, unsigned int width, unsigned int height, sf::Uint8 seed)
+	{
+		sf::Image image;
+		image.create(width, height);
+		for (unsigned int x = 0; x < width; x++)
+		{
+			for (unsigned int y = 0; y < height; y++)
+				image.setPixel(x, y, sf::Color(seed, static_cast<sf::Uint8>(x * 4), static_cast<sf::Uint8>(y * 4), static_cast<sf::Uint8>(255 - (x + y) % 64)));
+		}
+		texture.loadFromImage(image);
+	}
+
+
+	// Rectangles are separated by at least one pixel
+	bool separated(const sf::IntRect &a, const sf::IntRect &b)
+	{
+		return a.left + a.width < b.left || b.left + b.width < a.left || a.top + a.height < b.top || b.top + b.height < a.top;
+	}
+}
+
+
+// Regions have the sizes of the textures, don't touch each other and hold their pixels
+TEST(textureAtlasPacksWithoutOverlap)
+{
+	const sf::Vector2u sizes[] = { { 16, 16 }, { 30, 8 }, { 8, 30 }, { 64, 20 }, { 5, 5 }, { 40, 40 } };
+	sf::Texture textures[6];
+	TextureAtlas atlas;
+	for (int i = 0; i < 6; i++)
+	{
+		createTexture(textures[i], sizes[i].x, sizes[i].y, static_cast<sf::Uint8>(i * 40));
+		atlas.add(textures[i]);
+	}
+
+	CHECK(atlas.pack());
+	CHECK(atlas.getPackedCount() == 6);
+
+	sf::Vector2u atlasSize = atlas.getTexture().getSize();
+	sf::Image atlasImage = atlas.getTexture().copyToImage();
+	sf::IntRect regions[6];
+	for (int i = 0; i < 6; i++)
+	{
+		CHECK(atlas.find(textures[i], regions[i]));
+		CHECK(regions[i].width == static_cast<int>(sizes[i].x) && regions[i].height == static_cast<int>(sizes[i].y));
+		CHECK(regions[i].left >= 0 && regions[i].left + regions[i].width <= static_cast<int>(atlasSize.x));
+		CHECK(regions[i].top >= 0 && regions[i].top + regions[i].height <= static_cast<int>(atlasSize.y));
+
+		sf::Image source = textures[i].copyToImage();
+		bool samePixels = true;
+		for (unsigned int x = 0; x < sizes[i].x; x++)
+		{
+			for (unsigned int y = 0; y < sizes[i].y; y++)
+				samePixels = samePixels && atlasImage.getPixel(regions[i].left + x, regions[i].top + y) == source.getPixel(x, y);
+		}
+		CHECK(samePixels);
+	}
+
+	for (int i = 0; i < 6; i++)
+	{
+		for (int j = i + 1; j < 6; j++)
+			CHECK(separated(regions[i], regions[j]));
+	}
+}
+
+
+// Textures larger than half of the atlas side are drawn from their own texture
+TEST(textureAtlasLeavesLargeTexturesStandalone)
+{
+	sf::Texture large, small;
+	createTexture(large, 40, 10, 1);
+	createTexture(small, 10, 10, 2);
+
+	TextureAtlas atlas;
+	atlas.add(large);
+	atlas.add(small);
+	CHECK(atlas.pack(64));
+
+	sf::IntRect region;
+	CHECK(atlas.find(large, region) == false);
+	CHECK(atlas.find(small, region));
+	CHECK(atlas.getPackedCount() == 1);
+}
+
+
+// A texture added twice is packed once, an empty one isn't packed
+TEST(textureAtlasSkipsDuplicatesAndEmptyTextures)
+{
+	sf::Texture texture, empty;
+	createTexture(texture, 8, 8, 3);
+
+	TextureAtlas atlas;
+	atlas.add(texture);
+	atlas.add(texture);
+	atlas.add(empty);
+	CHECK(atlas.pack());
+	CHECK(atlas.getPackedCount() == 1);
+
+	sf::IntRect region;
+	CHECK(atlas.find(empty, region) == false);
+}
+
+
+// With padding only one of four 16x16 textures fits into 32x32, the rest stay standalone
+TEST(textureAtlasLeavesOutWhatDoesntFit)
+{
+	sf::Texture textures[4];
+	TextureAtlas atlas;
+	for (int i = 0; i < 4; i++)
+	{
+		createTexture(textures[i], 16, 16, static_cast<sf::Uint8>(i));
+		atlas.add(textures[i]);
+	}
+
+	CHECK(atlas.pack(32));
+	CHECK(atlas.getPackedCount() == 1);
+	CHECK(atlas.getTexture().getSize().x <= 32 && atlas.getTexture().getSize().y <= 32);
+}